@@ -9,17 +9,165 @@
 #include <cstring>
 #include <cctype>
 #include <vector>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <cstdio>       // For rename()
+#include <string_view>
+#include <sys/mman.h>   // For mmap()
+#include <sys/stat.h>
+#include <dirent.h>     // For opendir()
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h> // For setrlimit()
+#include <csignal>
+#include <fcntl.h>
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <charconv>     // For from_chars()
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <termios.h>    // For terminal control on macOS
 #include <unistd.h>     // For STDIN_FILENO
-#include <cstdlib>      // For system()
+#include <cstdlib>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>      // For offsetof()
+#include <ctime>
 
 using namespace std;
 
-#define MAX_STUDENTS 100
 #define MAX_DAYS 31
 
+// Operation timing and the stats export (see Stats)
+#ifndef SAMS_STATS
+#define SAMS_STATS 1
+#endif
+
+// Attendance for a month is packed into one bit per day (bit 0 = day 1)
+typedef uint32_t DayMask;
+static_assert(MAX_DAYS <= 32, "DayMask must hold one bit per day");
+
+// Mask selecting days 1..totalDays
+inline DayMask dayMaskFor(int totalDays) {
+    if (totalDays <= 0) return 0;
+    if (totalDays >= 32) return ~DayMask(0);
+    return (DayMask(1) << totalDays) - 1;
+}
+
+inline int countPresentDays(DayMask mask) {
+    return __builtin_popcount(mask);
+}
+
+// Percentage of days 1..totalDays marked present
+inline double attendancePercentage(DayMask mask, int totalDays) {
+    if (totalDays <= 0) return 0;
+    
+    int presentDays = countPresentDays(mask & dayMaskFor(totalDays));
+    return (static_cast<double>(presentDays) / totalDays) * 100.0;
+}
+
+// Output buffer for the interactive screens. cout is redirected here so a
+// whole screen (clear codes, colors and rows) is composed in memory and
+// reaches the terminal in one write() when input is read or the screen is
+// paused. The buffer grows instead of flushing part-way through a screen.
+class ScreenBuffer : public streambuf {
+private:
+    vector<char> buffer;
+    
+    void grow(size_t extra) {
+        size_t used = pptr() - pbase();
+        buffer.resize(max(buffer.size() * 2, used + extra));
+        setp(buffer.data(), buffer.data() + buffer.size());
+        pbump(static_cast<int>(used));
+    }
+    
+protected:
+    int overflow(int ch) override {
+        if (ch == EOF) return 0;
+        grow(1);
+        *pptr() = static_cast<char>(ch);
+        pbump(1);
+        return ch;
+    }
+    
+    streamsize xsputn(const char* text, streamsize count) override {
+        if (epptr() - pptr() < count) grow(count);
+        memcpy(pptr(), text, count);
+        pbump(static_cast<int>(count));
+        return count;
+    }
+    
+    int sync() override {
+        const char* data = pbase();
+        size_t remaining = pptr() - pbase();
+        while (remaining > 0) {
+            ssize_t written = write(STDOUT_FILENO, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            data += written;
+            remaining -= written;
+        }
+        setp(buffer.data(), buffer.data() + buffer.size());
+        return remaining == 0 ? 0 : -1;
+    }
+    
+public:
+    explicit ScreenBuffer(size_t capacity = 256 * 1024) : buffer(capacity) {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+    
+    // printf-style formatting straight into the buffer
+    void format(const char* pattern, ...) {
+        va_list args, retry;
+        va_start(args, pattern);
+        va_copy(retry, args);
+        size_t space = epptr() - pptr();
+        int needed = vsnprintf(pptr(), space, pattern, args);
+        if (needed >= 0 && static_cast<size_t>(needed) >= space) {
+            grow(needed + 1);
+            vsnprintf(pptr(), epptr() - pptr(), pattern, retry);
+        }
+        if (needed > 0) pbump(needed);
+        va_end(retry);
+        va_end(args);
+    }
+};
+
+ScreenBuffer screen;
+
+inline bool isLeapYear(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+inline int daysInMonthOf(int month, int year) {
+    switch (month) {
+        case 2:
+            return isLeapYear(year) ? 29 : 28;
+        case 4:
+        case 6:
+        case 9:
+        case 11:
+            return 30;
+        default:
+            return 31;
+    }
+}
+
 // Console enhancement functions for macOS
 void setConsoleColor(int color) {
+    // Only emit a code when the color actually changes
+    static int currentColor = -1;
+    if (color == currentColor) return;
+    currentColor = color;
+    
     // ANSI color codes for terminal
     switch(color) {
         case 7:  cout << "\033[0m"; break;    // Reset/White
@@ -31,8 +179,9 @@ void setConsoleColor(int color) {
     }
 }
 
+// Home the cursor and clear the screen and scrollback, as clear(1) does
 void clearScreen() {
-    system("clear");
+    cout << "\033[H\033[2J\033[3J";
 }
 
 void gotoxy(int x, int y) {
@@ -43,6 +192,7 @@ void gotoxy(int x, int y) {
 int getch() {
     struct termios oldt, newt;
     int ch;
+    cout.flush(); // Show the composed screen before waiting
     tcgetattr(STDIN_FILENO, &oldt);
     newt = oldt;
     newt.c_lflag &= ~(ICANON | ECHO);
@@ -76,851 +226,8341 @@ void pauseScreen() {
     getch();
 }
 
-class Student {
-private:
-    int rollNumber;
-    string name;
-    bool attendance[MAX_DAYS] = {false};
-    string remarks;
+// Remarks are persisted as one-byte codes
+enum RemarkCode : uint8_t {
+    REMARK_NONE = 0,
+    REMARK_POOR,
+    REMARK_AVERAGE,
+    REMARK_GOOD,
+    REMARK_EXCELLENT,
+    REMARK_CODE_COUNT
+};
+
+const char* remarkText(uint8_t code) {
+    static const char* const texts[REMARK_CODE_COUNT] = {
+        "", "Poor", "Average", "Good", "Excellent"
+    };
+    return code < REMARK_CODE_COUNT ? texts[code] : "";
+}
+
+uint8_t remarkCode(string_view text) {
+    for (uint8_t code = 0; code < REMARK_CODE_COUNT; code++) {
+        if (text == remarkText(code)) return code;
+    }
+    return REMARK_NONE;
+}
+
+// CRC-32C (Castagnoli), used to detect torn or corrupted data files
+uint32_t crc32c(uint32_t crc, const void* data, size_t length) {
+    // Built once; sections are loaded and checkpoints written on several
+    // threads, and a function-local static is initialized thread-safely
+    struct Table {
+        uint32_t entries[8][256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1u)));
+                entries[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; i++) {
+                for (int t = 1; t < 8; t++) {
+                    entries[t][i] = (entries[t - 1][i] >> 8) ^ entries[0][entries[t - 1][i] & 0xFF];
+                }
+            }
+        }
+    };
+    static const Table slices;
+    const auto& table = slices.entries;
     
-public:
-    Student() : rollNumber(0), name(""), remarks("") {}
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    // Slicing-by-8: fold eight bytes per step
+    while (length >= 8) {
+        uint32_t lo = crc ^ (uint32_t(p[0]) | uint32_t(p[1]) << 8 |
+                             uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24);
+        crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^
+              table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+              table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]] ^ table[0][p[7]];
+        p += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+// Data files are little-endian; this is a no-op on little-endian hosts
+template <typename T>
+T littleEndian(T value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    unsigned char* b = reinterpret_cast<unsigned char*>(&value);
+    std::reverse(b, b + sizeof(T));
+#endif
+    return value;
+}
+
+template <typename T>
+void littleEndianColumn(T* values, size_t count) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < count; i++) values[i] = littleEndian(values[i]);
+#else
+    (void)values;
+    (void)count;
+#endif
+}
+
+// students.dat layout (version 2):
+//   RosterFileHeader, then the payload columns, each starting on an
+//   8-byte boundary:
+//     int32  rollNumbers[studentCount]
+//     uint32 nameOffsets[studentCount + 1]   offsets into the name table
+//     char   names[nameBytes]                names, not NUL-terminated
+//     uint8  remarks[studentCount]           RemarkCode
+//     uint32 attendance[studentCount]        DayMask of the selected month
+//     uint32 historyOffsets[studentCount + 1] offsets into the history table
+//     uint8  history[historyBytes]           other months (see MonthHistory)
+// payloadChecksum is the CRC-32C of the payload; headerChecksum covers the
+// header with headerChecksum itself set to zero.
+//
+// Version 1 files have a 40-byte header without currentYear and
+// historyBytes and no history columns; they are still read. Saves now
+// write version 3 (see PAGED_ROSTER_VERSION); --bench still writes its
+// synthetic rosters as version 2, which can be mapped.
+const char ROSTER_MAGIC[4] = {'S', 'A', 'M', 'S'};
+const uint16_t ROSTER_VERSION = 2;
+
+struct RosterFileHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t studentCount;
+    int32_t currentMonth;
+    int32_t daysInMonth;
+    uint32_t nameBytes;
+    uint64_t payloadBytes;
+    int32_t currentYear;        // 0 in files converted from version 1
+    uint32_t historyBytes;
+    uint32_t payloadChecksum;
+    uint32_t headerChecksum;
+};
+static_assert(sizeof(RosterFileHeader) == 48, "RosterFileHeader must not contain padding");
+
+struct RosterFileHeaderV1 {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t studentCount;
+    int32_t currentMonth;
+    int32_t daysInMonth;
+    uint32_t nameBytes;
+    uint64_t payloadBytes;
+    uint32_t payloadChecksum;
+    uint32_t headerChecksum;
+};
+static_assert(sizeof(RosterFileHeaderV1) == 40, "RosterFileHeaderV1 must not contain padding");
+
+// Payload offsets of each column for a roster of a given shape
+struct RosterLayout {
+    uint64_t rollNumbers;
+    uint64_t nameOffsets;
+    uint64_t names;
+    uint64_t remarks;
+    uint64_t attendance;
+    uint64_t historyOffsets;    // both 0 when there is no history
+    uint64_t history;
+    uint64_t payloadBytes;
     
-    // Getters
-    int getRollNumber() const { return rollNumber; }
-    string getName() const { return name; }
-    bool getAttendance(int day) const { return attendance[day]; }
-    string getRemarks() const { return remarks; }
+    static uint64_t align8(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
     
-    // Setters
-    void setRollNumber(int roll) { rollNumber = roll; }
-    void setName(const string& studentName) { name = studentName; }
-    void setAttendance(int day, bool present) { 
-        if (day >= 0 && day < MAX_DAYS) {
-            attendance[day] = present;
+    RosterLayout(uint64_t studentCount, uint64_t nameBytes, uint64_t historyBytes, bool withHistory) {
+        rollNumbers = 0;
+        nameOffsets = align8(rollNumbers + studentCount * sizeof(int32_t));
+        names = align8(nameOffsets + (studentCount + 1) * sizeof(uint32_t));
+        remarks = align8(names + nameBytes);
+        attendance = align8(remarks + studentCount);
+        payloadBytes = align8(attendance + studentCount * sizeof(DayMask));
+        historyOffsets = history = 0;
+        if (withHistory) {
+            historyOffsets = payloadBytes;
+            history = align8(historyOffsets + (studentCount + 1) * sizeof(uint32_t));
+            payloadBytes = align8(history + historyBytes);
         }
     }
-    void setRemarks(const string& studentRemarks) { remarks = studentRemarks; }
     
-    // Calculate attendance percentage for the month
-    double getAttendancePercentage(int totalDays) const {
-        if (totalDays <= 0) return 0;
-        
-        int presentDays = 0;
-        for (int i = 0; i < totalDays; i++) {
-            if (attendance[i]) presentDays++;
-        }
-        
-        return (static_cast<double>(presentDays) / totalDays) * 100.0;
-    }
+    explicit RosterLayout(const RosterFileHeader& header)
+        : RosterLayout(littleEndian(header.studentCount), littleEndian(header.nameBytes),
+                       littleEndian(header.historyBytes), littleEndian(header.version) >= 2) {}
 };
 
-class AttendanceSystem {
-private:
-    Student students[MAX_STUDENTS];
-    int studentCount;
-    int currentMonth;
-    int daysInMonth;
+uint32_t rosterHeaderChecksum(RosterFileHeader header) {
+    header.headerChecksum = 0;
+    return crc32c(0, &header, sizeof(header));
+}
+
+// Identifies a snapshot by its checksums; 0 means "no snapshot yet"
+inline uint64_t snapshotFingerprint(const RosterFileHeader& header) {
+    return (uint64_t(littleEndian(header.headerChecksum)) << 32) |
+           littleEndian(header.payloadChecksum);
+}
+
+// Read the header at the start of a students.dat file of any supported
+// version into header (a version 1 header is widened, keeping its
+// version and size) and check everything that can be checked without the
+// payload. On failure, error describes the problem.
+bool readRosterHeader(const void* data, size_t available, RosterFileHeader& header, string& error) {
+    if (available < sizeof(RosterFileHeaderV1) ||
+        memcmp(data, ROSTER_MAGIC, sizeof(header.magic)) != 0) {
+        error = "Saved data is not in a recognized format.";
+        return false;
+    }
     
-    bool isValidName(const string& name) {
-        for (char c : name) {
-            if (!isalpha(c) && c != ' ') {
-                return false;
-            }
+    RosterFileHeaderV1 old;
+    memcpy(&old, data, sizeof(old));
+    uint16_t version = littleEndian(old.version);
+    uint16_t headerSize = littleEndian(old.headerSize);
+    if (version == 1 && headerSize == sizeof(RosterFileHeaderV1)) {
+        uint32_t checksum = old.headerChecksum;
+        old.headerChecksum = 0;
+        if (littleEndian(checksum) != crc32c(0, &old, sizeof(old))) {
+            error = "Saved data is corrupt (header checksum mismatch).";
+            return false;
         }
-        return !name.empty();
+        memcpy(&header, &old, offsetof(RosterFileHeaderV1, payloadChecksum));
+        header.currentYear = 0;
+        header.historyBytes = 0;
+        header.payloadChecksum = old.payloadChecksum;
+        header.headerChecksum = checksum;
+    } else if (version == ROSTER_VERSION && headerSize == sizeof(RosterFileHeader) &&
+               available >= sizeof(RosterFileHeader)) {
+        memcpy(&header, data, sizeof(header));
+        if (littleEndian(header.headerChecksum) != rosterHeaderChecksum(header)) {
+            error = "Saved data is corrupt (header checksum mismatch).";
+            return false;
+        }
+    } else {
+        error = "Saved data uses an unsupported format version.";
+        return false;
     }
     
-public:
-    void clearInputBuffer() {
-        cin.clear();
-        cin.ignore(10000, '\n');
+    int32_t month = littleEndian(header.currentMonth);
+    int32_t days = littleEndian(header.daysInMonth);
+    if (month < 1 || month > 12 || days < 1 || days > MAX_DAYS) {
+        error = "Saved data is corrupt (bad month).";
+        return false;
+    }
+    
+    RosterLayout layout(header);
+    if (littleEndian(header.payloadBytes) != layout.payloadBytes) {
+        error = "Saved data is corrupt (bad payload size).";
+        return false;
     }
+    return true;
+}
+
+// Where a string lives in a TextArena
+struct TextRef {
+    uint32_t offset;    // block << 16 | position in the block
+    uint32_t length;
+};
 
-    AttendanceSystem() : studentCount(0), currentMonth(5), daysInMonth(31) {}
+// students.dat layout (version 3, paged), written by checkpoints:
+//   The file is a sequence of PAGED_PAGE_BYTES pages. Page 0 holds two
+//   copies of a PagedRosterHeader, at offsets 0 and PAGED_HEADER_BYTES;
+//   the valid one with the higher generation is current. The others are:
+//   - slot pages, each with the fixed fields of PAGED_PAGE_SLOTS slots
+//     as columns: int32 rollNumbers, uint32 attendance, TextRef names,
+//     TextRef histories, uint8 remarks (RemarkCode), uint8 live
+//   - text pages, the blocks of the TextArena the TextRefs point into;
+//     a block longer than a page takes consecutive pages
+//   - table pages, a PagedEntry per slot page and per text block, listed
+//     with their checksums in the header (slot tables first)
+//   A checkpoint writes the slot pages and text blocks that changed, and
+//   the table pages that list them, to pages the current header does not
+//   use, then overwrites the older header copy. A crash at any point
+//   leaves a valid header whose pages are all intact.
+//   A mapped file's slot and text pages are used in place. Checkpoints
+//   write only slot pages that were copied out of the mapping and text
+//   blocks after the mapped ones, so a page the mapping still serves is
+//   never freed and reused.
+const uint16_t PAGED_ROSTER_VERSION = 3;
+const size_t PAGED_PAGE_BYTES = 65536;
+const size_t PAGED_HEADER_BYTES = 4096;
+const int PAGED_PAGE_SLOTS = 2048;
+const int PAGED_TABLE_REFS = 504;
+const size_t PAGED_SLOT_PAGE_BYTES = PAGED_PAGE_SLOTS * 26;
+
+// Where each column starts in a slot page
+const size_t SLOT_ROLL_NUMBERS = 0;
+const size_t SLOT_ATTENDANCE = PAGED_PAGE_SLOTS * 4;
+const size_t SLOT_NAMES = PAGED_PAGE_SLOTS * 8;
+const size_t SLOT_HISTORIES = PAGED_PAGE_SLOTS * 16;
+const size_t SLOT_REMARKS = PAGED_PAGE_SLOTS * 24;
+const size_t SLOT_LIVE = PAGED_PAGE_SLOTS * 25;
+
+struct PagedTableRef {
+    uint32_t page;
+    uint32_t checksum;      // CRC-32C of the whole table page
+};
+
+struct PagedRosterHeader {
+    char magic[4];          // ROSTER_MAGIC
+    uint16_t version;
+    uint16_t headerSize;    // PAGED_HEADER_BYTES
+    uint64_t generation;    // 1 for the first checkpoint of a file
+    uint64_t textBytes;     // text still referenced by live slots
+    int32_t currentMonth;
+    int32_t daysInMonth;
+    int32_t currentYear;
+    uint32_t slotCount;     // slots in use or free; the slot pages cover them
+    uint32_t slotPages;
+    uint32_t textBlocks;
+    uint32_t textPosition;  // next free byte of the last text block
+    uint32_t slotTablePages;
+    uint32_t textTablePages;
+    PagedTableRef tables[PAGED_TABLE_REFS];
+    uint32_t headerChecksum;
+};
+static_assert(sizeof(PagedRosterHeader) == PAGED_HEADER_BYTES, "PagedRosterHeader must fill its slot");
+
+struct PagedEntry {
+    uint32_t page;          // first file page
+    uint32_t pages;
+    uint32_t bytes;         // bytes used from the start of the first page
+    uint32_t checksum;      // CRC-32C of those bytes
+};
+static_assert(sizeof(PagedEntry) == 16, "PagedEntry must not contain padding");
+
+const size_t PAGED_TABLE_ENTRIES = PAGED_PAGE_BYTES / sizeof(PagedEntry);
+
+// Identifies a checkpoint of a paged file, like snapshotFingerprint
+inline uint64_t pagedFingerprint(const PagedRosterHeader& header) {
+    return (littleEndian(header.generation) << 32) ^ littleEndian(header.headerChecksum);
+}
+
+// Attendance of one student for every month except the selected one,
+// stored as a short byte string of entries in month order:
+//   uint16 month key (months since January 1970), uint8 tag, payload
+// The top two bits of the tag give the kind of entry and the low six a
+// count n:
+//   HISTORY_FULL          n + 1 consecutive months present every day
+//   HISTORY_MASK          one month; payload is its uint32 DayMask
+//   HISTORY_ABSENT_DAYS   one month present except on n days (1 byte each)
+//   HISTORY_PRESENT_DAYS  one month present only on n days (1 byte each)
+// Months with no marks are not stored, so a year of full attendance is 3
+// bytes and fits in the string without a heap allocation. A month is
+// found by walking entry headers; no other month is decoded.
+enum HistoryKind : uint8_t {
+    HISTORY_FULL,
+    HISTORY_MASK,
+    HISTORY_ABSENT_DAYS,
+    HISTORY_PRESENT_DAYS
+};
+
+class MonthHistory {
+private:
+    static const int MAX_RUN = 64;
+    static const int MAX_LISTED_DAYS = 3;   // beyond this a mask is smaller
     
-    // Enhanced display with colors and better formatting
-    void displayStudents() {
-        clearScreen();
-        if (studentCount == 0) {
-            setConsoleColor(12); // Red
-            cout << "\n  X No students registered.\n";
-            setConsoleColor(7);
-            pauseScreen();
-            return;
-        }
-        
-        setConsoleColor(11); // Light cyan
-        cout << "\n+==================================================================+\n";
-        cout << "|                          STUDENT LIST                           |\n";
-        cout << "+==================================================================+\n";
-        setConsoleColor(7);
-        
-        cout << "| Roll No |      Name      | Attendance % |    Remarks    |\n";
-        cout << "+---------+----------------+--------------+---------------+\n";
-        
-        for (int i = 0; i < studentCount; i++) {
-            double attendancePercentage = students[i].getAttendancePercentage(daysInMonth);
-            
-            // Color code based on attendance percentage
-            if (attendancePercentage >= 85) setConsoleColor(10); // Green
-            else if (attendancePercentage >= 75) setConsoleColor(14); // Yellow
-            else setConsoleColor(12); // Red
-            
-            printf("| %7d | %-14s |    %6.2f%%    | %-13s |\n", 
-                   students[i].getRollNumber(), 
-                   students[i].getName().substr(0, 14).c_str(),
-                   attendancePercentage,
-                   students[i].getRemarks().substr(0, 13).c_str());
+    static void appendEntry(string& history, int key, uint8_t kind, int count) {
+        history += static_cast<char>(key & 0xFF);
+        history += static_cast<char>(key >> 8);
+        history += static_cast<char>((kind << 6) | count);
+    }
+    
+    static void appendDays(string& history, DayMask days) {
+        for (DayMask bits = days; bits != 0; bits &= bits - 1) {
+            history += static_cast<char>(__builtin_ctz(bits));
         }
-        
-        setConsoleColor(7);
-        cout << "+=================================================================+\n";
-        pauseScreen();
     }
     
-    // Get valid roll number input (unique)
-    int getRollNumber() {
-        string input;
-        int rollNumber;
-        
-        while (true) {
-            cout << "Enter student roll number: ";
-            getline(cin, input);
+public:
+    static int monthKey(int year, int month) { return (year - 1970) * 12 + (month - 1); }
+    static int yearOf(int key) { return 1970 + key / 12; }
+    static int monthOf(int key) { return key % 12 + 1; }
+    static DayMask fullMonth(int key) { return dayMaskFor(daysInMonthOf(monthOf(key), yearOf(key))); }
+    
+    // Call visit(key, mask) for every stored month in order until it
+    // returns false. Stops quietly at a malformed entry.
+    template <typename Visitor>
+    static void forEach(string_view history, Visitor visit) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(history.data());
+        size_t size = history.size();
+        size_t pos = 0;
+        while (pos + 3 <= size) {
+            int key = bytes[pos] | (bytes[pos + 1] << 8);
+            int kind = bytes[pos + 2] >> 6;
+            int count = bytes[pos + 2] & 63;
+            pos += 3;
             
-            try {
-                rollNumber = stoi(input);
-                
-                if (rollNumber <= 0) {
-                    cout << "Invalid roll number. Please enter a positive number.\n";
-                    continue;
-                }
-                
-                // Check for duplicate roll number
-                bool duplicate = false;
-                for (int i = 0; i < studentCount; i++) {
-                    if (students[i].getRollNumber() == rollNumber) {
-                        duplicate = true;
-                        break;
-                    }
+            if (kind == HISTORY_FULL) {
+                for (int i = 0; i <= count; i++) {
+                    if (!visit(key + i, fullMonth(key + i))) return;
                 }
-                
-                if (!duplicate) {
-                    return rollNumber; // Return valid, non-duplicate roll number
-                } else {
-                    cout << "Roll number already exists. Please try again.\n";
+                continue;
+            }
+            
+            DayMask mask;
+            if (kind == HISTORY_MASK) {
+                if (pos + 4 > size) return;
+                mask = DayMask(bytes[pos]) | (DayMask(bytes[pos + 1]) << 8) |
+                       (DayMask(bytes[pos + 2]) << 16) | (DayMask(bytes[pos + 3]) << 24);
+                pos += 4;
+            } else {
+                if (pos + count > size) return;
+                mask = kind == HISTORY_ABSENT_DAYS ? fullMonth(key) : 0;
+                for (int i = 0; i < count; i++) {
+                    DayMask day = DayMask(1) << (bytes[pos + i] & 31);
+                    mask = kind == HISTORY_ABSENT_DAYS ? mask & ~day : mask | day;
                 }
-            } catch (exception&) {
-                cout << "Invalid roll number. Please enter numbers only.\n";
+                pos += count;
             }
+            if (!visit(key, mask)) return;
         }
     }
     
-    // Add a new student
-    void addStudent() {
-        clearScreen();
-        setConsoleColor(11);
-        cout << "\n+======================================+\n";
-        cout << "|            ADD NEW STUDENT           |\n";
-        cout << "+======================================+\n";
-        setConsoleColor(7);
-        
-        if (studentCount < MAX_STUDENTS) {
-            int rollNumber = getRollNumber();
-            string name;
+    // Attendance stored for one month; 0 if none
+    static DayMask lookup(string_view history, int key) {
+        DayMask found = 0;
+        forEach(history, [&](int month, DayMask mask) {
+            if (month == key) found = mask;
+            return month < key;
+        });
+        return found;
+    }
+    
+    // Encode months, given in increasing key order
+    static string encode(const vector<pair<int, DayMask>>& months) {
+        string history;
+        int runStart = -1, runLength = 0;
+        for (const pair<int, DayMask>& month : months) {
+            int key = month.first;
+            DayMask mask = month.second;
+            if (mask == 0) continue;
             
-            while (true) {
-                cout << "\nEnter student name: ";
-                getline(cin, name);
-                
-                if (isValidName(name)) {
-                    break;
+            DayMask full = fullMonth(key);
+            if (mask == full) {
+                if (runStart >= 0 && runStart + runLength == key && runLength < MAX_RUN) {
+                    runLength++;
+                    history[history.size() - 1] = static_cast<char>((HISTORY_FULL << 6) | (runLength - 1));
                 } else {
-                    setConsoleColor(12);
-                    cout << "X Invalid name. Please enter letters only.\n";
-                    setConsoleColor(7);
+                    appendEntry(history, key, HISTORY_FULL, 0);
+                    runStart = key;
+                    runLength = 1;
                 }
+                continue;
             }
             
-            students[studentCount].setRollNumber(rollNumber);
-            students[studentCount].setName(name);
-            students[studentCount].setRemarks("");
-            
-            setConsoleColor(10);
-            cout << "\n* Student added successfully!\n";
-            setConsoleColor(7);
-            studentCount++;
-        } else {
-            setConsoleColor(12);
-            cout << "\nX Maximum number of students reached.\n";
-            setConsoleColor(7);
+            runStart = -1;
+            DayMask absent = full & ~mask;
+            if ((mask & ~full) == 0 && countPresentDays(absent) <= MAX_LISTED_DAYS) {
+                appendEntry(history, key, HISTORY_ABSENT_DAYS, countPresentDays(absent));
+                appendDays(history, absent);
+            } else if (countPresentDays(mask) <= MAX_LISTED_DAYS) {
+                appendEntry(history, key, HISTORY_PRESENT_DAYS, countPresentDays(mask));
+                appendDays(history, mask);
+            } else {
+                appendEntry(history, key, HISTORY_MASK, 0);
+                for (int shift = 0; shift < 32; shift += 8) {
+                    history += static_cast<char>((mask >> shift) & 0xFF);
+                }
+            }
         }
-        pauseScreen();
+        return history;
     }
     
-    // Mark attendance for a student on a specific day
-    void markAttendance() {
-        if (studentCount == 0) {
-            cout << "No students to mark attendance for.\n";
-            return;
-        }
-        
-        int rollNumber;
-        cout << "Enter student roll number: ";
-        cin >> rollNumber;
-        clearInputBuffer();
-        
-        int day;
-        cout << "Enter day (1-" << daysInMonth << "): ";
-        cin >> day;
-        clearInputBuffer();
-        
-        if (day < 1 || day > daysInMonth) {
-            cout << "Invalid day. Please enter a day between 1 and " << daysInMonth << ".\n";
-            return;
-        }
-        
-        int status;
-        cout << "Mark student as (1: Present, 0: Absent): ";
-        cin >> status;
-        clearInputBuffer();
-        
-        if (status != 0 && status != 1) {
-            cout << "Invalid input. Please enter 0 for absent or 1 for present.\n";
-            return;
-        }
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getRollNumber() == rollNumber) {
-                students[i].setAttendance(day - 1, status == 1);
-                cout << "Attendance marked successfully for " << students[i].getName() 
-                         << " on day " << day << " as " 
-                         << (status == 1 ? "Present" : "Absent") << ".\n";
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            cout << "Student with roll number " << rollNumber << " not found.\n";
-        }
+    // Present days stored for months firstKey..lastKey, keeping only the
+    // days in firstDays of the first month and lastDays of the last one
+    static int presentBetween(string_view history, int firstKey, DayMask firstDays,
+                              int lastKey, DayMask lastDays) {
+        int present = 0;
+        forEach(history, [&](int key, DayMask mask) {
+            if (key > lastKey) return false;
+            if (key < firstKey) return true;
+            if (key == firstKey) mask &= firstDays;
+            if (key == lastKey) mask &= lastDays;
+            present += countPresentDays(mask);
+            return true;
+        });
+        return present;
     }
     
-    // View attendance for a specific student
-    void viewStudentAttendance() {
-        if (studentCount == 0) {
-            cout << "No students registered.\n";
-            return;
-        }
-        
-        int rollNumber;
-        cout << "Enter student roll number: ";
-        cin >> rollNumber;
-        clearInputBuffer();
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getRollNumber() == rollNumber) {
-                cout << "\nAttendance record for " << students[i].getName() << ":\n";
-                cout << "----------------------------\n";
-                cout << "Day | Status\n";
-                cout << "----------------------------\n";
-                
-                for (int day = 0; day < daysInMonth; day++) {
-                    cout << day + 1 << " | " 
-                            << (students[i].getAttendance(day) ? "Present" : "Absent") << "\n";
-                }
-                
-                double attendancePercentage = students[i].getAttendancePercentage(daysInMonth);
-                cout << "----------------------------\n";
-                cout << "Attendance Percentage: " << attendancePercentage << "%\n";
-                found = true;
-                break;
+    // Store mask as month storeKey and remove month takeKey, returning what
+    // it held. This is how the selected month is switched.
+    static DayMask exchange(string& history, int storeKey, DayMask mask, int takeKey) {
+        vector<pair<int, DayMask>> months;
+        DayMask taken = 0;
+        bool stored = false;
+        forEach(history, [&](int key, DayMask monthMask) {
+            if (!stored && storeKey < key) {
+                months.push_back({storeKey, mask});
+                stored = true;
             }
+            if (key == takeKey) taken = monthMask;
+            else if (key != storeKey) months.push_back({key, monthMask});
+            return true;
+        });
+        if (!stored) months.push_back({storeKey, mask});
+        history = encode(months);
+        return taken;
+    }
+};
+
+// An inclusive range of calendar days, possibly spanning months and years.
+// Each month's share is a DayMask, so counting a student's present days in
+// it is one popcount per month whatever the length of the range.
+struct DateRange {
+    int firstKey, lastKey;      // MonthHistory keys
+    DayMask firstDays;          // days of the first month in the range
+    DayMask lastDays;           // days of the last month in the range
+    int totalDays;
+    
+    // Days day..31 of a month, or 1..day
+    static DayMask daysFrom(int day) { return ~dayMaskFor(day - 1); }
+    static DayMask daysUpTo(int day) { return dayMaskFor(day); }
+    
+    // Parse "YYYY-MM-DD"; false if it is not a real date
+    static bool parseDate(const string& text, int& year, int& month, int& day) {
+        char dash1, dash2;
+        char extra;
+        if (sscanf(text.c_str(), "%d%c%d%c%d%c", &year, &dash1, &month, &dash2, &day, &extra) != 5 ||
+            dash1 != '-' || dash2 != '-') {
+            return false;
         }
+        return year >= 1970 && year <= 2999 && month >= 1 && month <= 12 &&
+               day >= 1 && day <= daysInMonthOf(month, year);
+    }
+    
+    // Range from one date to another; false if from is after to
+    bool set(int fromYear, int fromMonth, int fromDay, int toYear, int toMonth, int toDay) {
+        firstKey = MonthHistory::monthKey(fromYear, fromMonth);
+        lastKey = MonthHistory::monthKey(toYear, toMonth);
+        if (firstKey > lastKey || (firstKey == lastKey && fromDay > toDay)) return false;
+        firstDays = daysFrom(fromDay) & MonthHistory::fullMonth(firstKey);
+        lastDays = daysUpTo(toDay);
+        if (firstKey == lastKey) firstDays = lastDays = firstDays & lastDays;
         
-        if (!found) {
-            cout << "Student with roll number " << rollNumber << " not found.\n";
+        totalDays = countPresentDays(firstDays);
+        for (int key = firstKey + 1; key < lastKey; key++) {
+            totalDays += countPresentDays(MonthHistory::fullMonth(key));
         }
+        if (lastKey != firstKey) totalDays += countPresentDays(lastDays);
+        return true;
     }
     
-    // View attendance by day
-    void viewDayAttendance() {
-        if (studentCount == 0) {
-            cout << "No students registered.\n";
+    // Days of month key that fall in the range
+    DayMask daysIn(int key) const {
+        if (key < firstKey || key > lastKey) return 0;
+        if (key == firstKey) return firstDays;
+        if (key == lastKey) return lastDays;
+        return MonthHistory::fullMonth(key);
+    }
+};
+
+// Read-only view of one student, backed either by the columns of a
+// StudentStore or directly by a memory-mapped data file. Valid until the
+// roster is next edited.
+class StudentView {
+private:
+    int rollNumber;
+    string_view name;
+    uint8_t remarks;        // RemarkCode
+    DayMask attendance;
+    string_view history;
+    
+public:
+    StudentView(int roll, string_view studentName, uint8_t remarkCode, DayMask mask,
+                string_view months)
+        : rollNumber(roll), name(studentName), remarks(remarkCode), attendance(mask),
+          history(months) {}
+    
+    int getRollNumber() const { return rollNumber; }
+    string_view getName() const { return name; }
+    string_view getRemarks() const { return remarkText(remarks); }
+    uint8_t getRemarkCode() const { return remarks; }
+    DayMask getAttendanceMask() const { return attendance; }
+    string_view getHistory() const { return history; }
+    bool getAttendance(int day) const {
+        if (day < 0 || day >= MAX_DAYS) return false;
+        return (attendance >> day) & 1u;
+    }
+    double getAttendancePercentage(int totalDays) const {
+        return attendancePercentage(attendance, totalDays);
+    }
+};
+
+// A roster gathered into the columns of a students.dat file, in file order
+struct RosterColumns {
+    vector<int32_t> rollNumbers;
+    vector<uint32_t> nameOffsets;
+    string names;
+    vector<uint8_t> remarks;
+    vector<DayMask> attendance;
+    vector<uint32_t> historyOffsets;
+    string history;
+    
+    RosterColumns() : nameOffsets(1, 0), historyOffsets(1, 0) {}
+    
+    void reserve(size_t count) {
+        rollNumbers.reserve(count);
+        nameOffsets.reserve(count + 1);
+        remarks.reserve(count);
+        attendance.reserve(count);
+        historyOffsets.reserve(count + 1);
+    }
+    
+    void add(const StudentView& student) {
+        rollNumbers.push_back(student.getRollNumber());
+        names += student.getName();
+        nameOffsets.push_back(names.size());
+        remarks.push_back(student.getRemarkCode());
+        attendance.push_back(student.getAttendanceMask());
+        history += student.getHistory();
+        historyOffsets.push_back(history.size());
+    }
+    
+    uint32_t size() const { return static_cast<uint32_t>(rollNumbers.size()); }
+    
+    // Lay the columns out as a version 2 payload and fill in its header.
+    // The numeric columns are converted to little-endian in place.
+    void encode(int month, int days, int year, RosterFileHeader& header, vector<char>& payload) {
+        RosterLayout layout(size(), names.size(), history.size(), true);
+        payload.assign(layout.payloadBytes, 0);
+        littleEndianColumn(rollNumbers.data(), rollNumbers.size());
+        littleEndianColumn(nameOffsets.data(), nameOffsets.size());
+        littleEndianColumn(attendance.data(), attendance.size());
+        littleEndianColumn(historyOffsets.data(), historyOffsets.size());
+        memcpy(&payload[layout.rollNumbers], rollNumbers.data(), rollNumbers.size() * sizeof(int32_t));
+        memcpy(&payload[layout.nameOffsets], nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+        memcpy(&payload[layout.names], names.data(), names.size());
+        memcpy(&payload[layout.remarks], remarks.data(), remarks.size());
+        memcpy(&payload[layout.attendance], attendance.data(), attendance.size() * sizeof(DayMask));
+        memcpy(&payload[layout.historyOffsets], historyOffsets.data(),
+               historyOffsets.size() * sizeof(uint32_t));
+        memcpy(&payload[layout.history], history.data(), history.size());
+        
+        memcpy(header.magic, ROSTER_MAGIC, sizeof(header.magic));
+        header.version = littleEndian(ROSTER_VERSION);
+        header.headerSize = littleEndian<uint16_t>(sizeof(RosterFileHeader));
+        header.studentCount = littleEndian(size());
+        header.currentMonth = littleEndian<int32_t>(month);
+        header.daysInMonth = littleEndian<int32_t>(days);
+        header.nameBytes = littleEndian<uint32_t>(names.size());
+        header.payloadBytes = littleEndian(layout.payloadBytes);
+        header.currentYear = littleEndian<int32_t>(year);
+        header.historyBytes = littleEndian<uint32_t>(history.size());
+        header.payloadChecksum = littleEndian(crc32c(0, payload.data(), payload.size()));
+        header.headerChecksum = littleEndian(rosterHeaderChecksum(header));
+    }
+};
+
+// Read-only memory mapping of a students.dat file. Columns are used in
+// place, so opening costs a header check regardless of roster size. The
+// payload checksum is not verified here, since that would touch every page;
+// names are bounds-checked on access instead.
+// A paged (version 3) file is mapped through the page tables of its
+// current checkpoint: slot fields are read from the slot pages, and the
+// text blocks are handed to the owner's TextArena, since the TextRefs in
+// the slot pages point into it. Page checksums are left to the owner too,
+// to check when it first copies a page (slotPageIntact()).
+class MappedRoster {
+private:
+    void* base;
+    size_t length;
+    RosterFileHeader header;
+    const int32_t* rollNumbers;
+    const uint32_t* nameOffsets;
+    const char* names;
+    const uint8_t* remarks;
+    const DayMask* attendance;
+    const uint32_t* historyOffsets;     // null for version 1 files
+    const char* history;
+    
+    bool paged;
+    int slots;
+    vector<const char*> slotPages;
+    vector<uint32_t> slotChecksums;
+    vector<string_view> textBlocks;
+    vector<uint32_t> textChecksums;
+    
+    MappedRoster(const MappedRoster&) = delete;
+    MappedRoster& operator=(const MappedRoster&) = delete;
+    
+    bool mapFile(const string& path, size_t minimum, string& error) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        error = "Mapped loading needs a little-endian host.";
+        return false;
+#endif
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "No saved data found or error opening file.";
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(minimum)) {
+            ::close(fd);
+            error = "Saved data is not in a recognized format.";
+            return false;
+        }
+        
+        length = info.st_size;
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            error = "Error mapping the data file.";
+            return false;
+        }
+        return true;
+    }
+    
+    // Field of slot i from the column that starts at offset in its page
+    template <typename T>
+    const T& slotField(int i, size_t offset) const {
+        return reinterpret_cast<const T*>(slotPages[i / PAGED_PAGE_SLOTS] + offset)[i % PAGED_PAGE_SLOTS];
+    }
+    
+public:
+    MappedRoster() : base(nullptr), length(0), header(), rollNumbers(nullptr),
+                     nameOffsets(nullptr), names(nullptr), remarks(nullptr), attendance(nullptr),
+                     historyOffsets(nullptr), history(nullptr), paged(false), slots(0) {}
+    
+    ~MappedRoster() {
+        if (base) munmap(base, length);
+    }
+    
+    bool open(const string& path, string& error) {
+        if (!mapFile(path, sizeof(RosterFileHeaderV1), error)) return false;
+        if (!readRosterHeader(base, length, header, error)) return false;
+        RosterLayout layout(header);
+        if (length < header.headerSize + layout.payloadBytes) {
+            error = "Saved data is truncated.";
+            return false;
+        }
+        
+        const char* payload = static_cast<const char*>(base) + header.headerSize;
+        rollNumbers = reinterpret_cast<const int32_t*>(payload + layout.rollNumbers);
+        nameOffsets = reinterpret_cast<const uint32_t*>(payload + layout.nameOffsets);
+        names = payload + layout.names;
+        remarks = reinterpret_cast<const uint8_t*>(payload + layout.remarks);
+        attendance = reinterpret_cast<const DayMask*>(payload + layout.attendance);
+        if (header.version >= 2) {
+            historyOffsets = reinterpret_cast<const uint32_t*>(payload + layout.historyOffsets);
+            history = payload + layout.history;
+        }
+        return true;
+    }
+    
+    // Map the slotCount slots and the text blocks that a paged file's
+    // page tables list (see RosterPageFile)
+    bool openPaged(const string& path, const vector<PagedEntry>& slotEntries,
+                   const vector<PagedEntry>& textEntries, int slotCount, string& error) {
+        // An empty roster is just the two header copies, less than a page
+        if (!mapFile(path, 2 * PAGED_HEADER_BYTES, error)) return false;
+        auto inFile = [&](const PagedEntry& e) {
+            return uint64_t(e.page) * PAGED_PAGE_BYTES + e.bytes <= length;
+        };
+        for (const PagedEntry& e : slotEntries) {
+            if (!inFile(e)) {
+                error = "Saved data is truncated.";
+                return false;
+            }
+            slotPages.push_back(static_cast<const char*>(base) + size_t(e.page) * PAGED_PAGE_BYTES);
+            slotChecksums.push_back(e.checksum);
+        }
+        for (const PagedEntry& e : textEntries) {
+            if (!inFile(e)) {
+                error = "Saved data is truncated.";
+                return false;
+            }
+            textBlocks.emplace_back(static_cast<const char*>(base) + size_t(e.page) * PAGED_PAGE_BYTES, e.bytes);
+            textChecksums.push_back(e.checksum);
+        }
+        paged = true;
+        slots = slotCount;
+        return true;
+    }
+    
+    int count() const { return paged ? slots : int(header.studentCount); }
+    int month() const { return header.currentMonth; }
+    int year() const { return header.currentYear; }     // 0 if not recorded
+    int daysInMonth() const { return header.daysInMonth; }
+    uint64_t fingerprint() const { return snapshotFingerprint(header); }
+    
+    int rollNumber(int i) const {
+        return paged ? slotField<int32_t>(i, SLOT_ROLL_NUMBERS) : rollNumbers[i];
+    }
+    DayMask attendanceMask(int i) const {
+        return (paged ? slotField<DayMask>(i, SLOT_ATTENDANCE) : attendance[i]) & dayMaskFor(MAX_DAYS);
+    }
+    uint8_t remarkCode(int i) const {
+        uint8_t code = paged ? slotField<uint8_t>(i, SLOT_REMARKS) : remarks[i];
+        return code < REMARK_CODE_COUNT ? code : uint8_t(REMARK_NONE);
+    }
+    string_view name(int i) const {
+        uint32_t begin = min(nameOffsets[i], header.nameBytes);
+        uint32_t end = min(nameOffsets[i + 1], header.nameBytes);
+        return begin < end ? string_view(names + begin, end - begin) : string_view();
+    }
+    
+    string_view months(int i) const {
+        if (!historyOffsets) return string_view();
+        uint32_t begin = min(historyOffsets[i], header.historyBytes);
+        uint32_t end = min(historyOffsets[i + 1], header.historyBytes);
+        return begin < end ? string_view(history + begin, end - begin) : string_view();
+    }
+    
+    StudentView view(int i) const {
+        return StudentView(rollNumber(i), name(i), remarkCode(i), attendanceMask(i), months(i));
+    }
+    
+    // Paged files only
+    bool isPaged() const { return paged; }
+    bool isLive(int i) const { return slotField<uint8_t>(i, SLOT_LIVE) == 1; }
+    TextRef nameRef(int i) const { return slotField<TextRef>(i, SLOT_NAMES); }
+    TextRef historyRef(int i) const { return slotField<TextRef>(i, SLOT_HISTORIES); }
+    size_t textBlockCount() const { return textBlocks.size(); }
+    string_view textBlock(size_t block) const { return textBlocks[block]; }
+    bool slotPageIntact(int page) const {
+        return crc32c(0, slotPages[page], PAGED_SLOT_PAGE_BYTES) == slotChecksums[page];
+    }
+    bool textBlockIntact(size_t block) const {
+        return crc32c(0, textBlocks[block].data(), textBlocks[block].size()) == textChecksums[block];
+    }
+};
+
+// A column split into pages of 4096 entries that copies of the column
+// share: copying it copies one pointer per page, and the first write to a
+// page that is still shared gives the writer a private copy of that page.
+// A background save freezes the roster this way without copying it.
+// Reference counts must only change on one thread at a time; other threads
+// may read a copy as long as its owner keeps it alive.
+template <typename T>
+class PagedColumn {
+private:
+    static constexpr size_t PAGE_SHIFT = 12;
+    static constexpr size_t PAGE_SIZE = size_t(1) << PAGE_SHIFT;
+    
+    vector<shared_ptr<T[]>> pages;
+    size_t count;       // entries past count in the last page are T()
+    
+    T* ownPage(size_t page) {
+        shared_ptr<T[]>& p = pages[page];
+        if (p.use_count() > 1) {
+            shared_ptr<T[]> copy(new T[PAGE_SIZE]);
+            std::copy(p.get(), p.get() + PAGE_SIZE, copy.get());
+            p = move(copy);
+        }
+        return p.get();
+    }
+    
+public:
+    PagedColumn() : count(0) {}
+    
+    size_t size() const { return count; }
+    
+    const T& operator[](size_t i) const { return pages[i >> PAGE_SHIFT].get()[i & (PAGE_SIZE - 1)]; }
+    
+    // Writable entry i, unsharing its page first
+    T& edit(size_t i) { return ownPage(i >> PAGE_SHIFT)[i & (PAGE_SIZE - 1)]; }
+    
+    // Entry i in its page as it is, shared or not, for atomic updates
+    // that every copy sharing the page is meant to see
+    T& inPlace(size_t i) { return pages[i >> PAGE_SHIFT].get()[i & (PAGE_SIZE - 1)]; }
+    
+    void resize(size_t n) {
+        if (n < count) {
+            size_t keep = (n + PAGE_SIZE - 1) >> PAGE_SHIFT;
+            pages.resize(keep);
+            if (n & (PAGE_SIZE - 1)) {
+                T* last = ownPage(keep - 1);
+                std::fill(last + (n & (PAGE_SIZE - 1)), last + PAGE_SIZE, T());
+            }
+        }
+        while (pages.size() << PAGE_SHIFT < n) pages.emplace_back(new T[PAGE_SIZE]());
+        count = n;
+    }
+    
+    void push_back(const T& value) {
+        resize(count + 1);
+        edit(count - 1) = value;
+    }
+    
+    void assign(size_t n, const T& value) {
+        clear();
+        resize(n);
+        for (size_t page = 0; page < pages.size(); page++) {
+            std::fill(pages[page].get(), pages[page].get() + min(PAGE_SIZE, n - (page << PAGE_SHIFT)), value);
+        }
+    }
+    
+    void clear() {
+        pages.clear();
+        count = 0;
+    }
+    
+    void swap(PagedColumn& other) {
+        pages.swap(other.pages);
+        std::swap(count, other.count);
+    }
+};
+
+// Open-addressing hash map from roll number to student slot.
+// Linear probing with backward-shift deletion, so no tombstones build up.
+// The table is a PagedColumn, so a copy for readers on other threads
+// (see RosterVersion) shares it and later edits copy only their pages.
+class RollIndex {
+private:
+    struct Entry {
+        int rollNumber;
+        int slot;   // -1 marks an empty entry
+    };
+    
+    PagedColumn<Entry> table;
+    size_t mask;
+    size_t used;
+    
+    size_t bucketFor(int rollNumber) const {
+        // Fibonacci hashing spreads consecutive roll numbers across the table
+        uint64_t h = static_cast<uint32_t>(rollNumber) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h >> 32) & mask;
+    }
+    
+public:
+    RollIndex() : mask(15), used(0) { table.assign(16, Entry{0, -1}); }
+    
+    // Returns the slot for rollNumber, or -1 if it is not indexed
+    int find(int rollNumber) const {
+        for (size_t i = bucketFor(rollNumber); ; i = (i + 1) & mask) {
+            const Entry& e = table[i];
+            if (e.slot < 0) return -1;
+            if (e.rollNumber == rollNumber) return e.slot;
+        }
+    }
+    
+    bool contains(int rollNumber) const { return find(rollNumber) >= 0; }
+    
+    // Hint that rollNumber will be looked up soon
+    void prefetch(int rollNumber) const {
+        __builtin_prefetch(&table[bucketFor(rollNumber)]);
+    }
+    
+    // Insert or overwrite the slot for rollNumber
+    void insert(int rollNumber, int slot) {
+        if ((used + 1) * 4 > table.size() * 3) reserve(table.size());
+        for (size_t i = bucketFor(rollNumber); ; i = (i + 1) & mask) {
+            const Entry& e = table[i];
+            if (e.slot < 0) {
+                table.edit(i) = Entry{rollNumber, slot};
+                used++;
+                return;
+            }
+            if (e.rollNumber == rollNumber) {
+                table.edit(i).slot = slot;
+                return;
+            }
+        }
+    }
+    
+    void erase(int rollNumber) {
+        size_t i = bucketFor(rollNumber);
+        while (true) {
+            if (table[i].slot < 0) return;
+            if (table[i].rollNumber == rollNumber) break;
+            i = (i + 1) & mask;
+        }
+        
+        // Shift later entries of the probe run back into the hole
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask; table[j].slot >= 0; j = (j + 1) & mask) {
+            size_t home = bucketFor(table[j].rollNumber);
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                table.edit(hole) = table[j];
+                hole = j;
+            }
+        }
+        table.edit(hole).slot = -1;
+        used--;
+    }
+    
+    // Size the table for at least count entries without further growth
+    void reserve(size_t count) {
+        size_t capacity = table.size();
+        while (count * 4 > capacity * 3) capacity *= 2;
+        if (capacity == table.size()) return;
+        PagedColumn<Entry> old;
+        old.swap(table);
+        table.assign(capacity, Entry{0, -1});
+        mask = capacity - 1;
+        used = 0;
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].slot >= 0) insert(old[i].rollNumber, old[i].slot);
+        }
+    }
+    
+    void clear() {
+        table.assign(16, Entry{0, -1});
+        mask = 15;
+        used = 0;
+    }
+};
+
+// Append-only storage for names and month histories. Text is copied into
+// 64 KB blocks that never move, so a string_view into the arena stays
+// valid until the arena is cleared or replaced. A string longer than a
+// quarter block gets a block of its own. Replacing a string leaves the
+// old copy behind; the owner repacks the arena when too much is garbage.
+// Copies share the blocks: appends only write past every existing string,
+// so a copy stays a valid point-in-time view while the original grows.
+// Leading blocks may be borrowed from a mapped data file; those are never
+// written, and the tail is copied before an append would write into it.
+class TextArena {
+private:
+    static const uint32_t BLOCK_SHIFT = 16;
+    static const uint32_t BLOCK_SIZE = 1u << BLOCK_SHIFT;
+    
+    vector<shared_ptr<char[]>> blocks;
+    vector<uint32_t> used;  // bytes written to each block
+    uint32_t position;      // next free byte of the last block
+    size_t bytes;           // text appended so far, live or not
+    size_t changedFrom;     // first block changed since markClean()
+    size_t borrowed;        // leading blocks that belong to a mapping
+    
+public:
+    TextArena() : position(BLOCK_SIZE), bytes(0), changedFrom(0), borrowed(0) {}
+    
+    TextRef append(string_view text) {
+        if (text.empty()) return TextRef{0, 0};
+        uint32_t length = static_cast<uint32_t>(text.size());
+        if (length > BLOCK_SIZE / 4) {
+            blocks.emplace_back(new char[length]);
+            used.push_back(0);
+            position = BLOCK_SIZE;
+        } else if (position + length > BLOCK_SIZE) {
+            blocks.emplace_back(new char[BLOCK_SIZE]);
+            used.push_back(0);
+            position = 0;
+        } else if (tailBorrowed()) {
+            ownTail();
+        }
+        uint32_t start = length > BLOCK_SIZE / 4 ? 0 : position;
+        memcpy(blocks.back().get() + start, text.data(), length);
+        if (length <= BLOCK_SIZE / 4) position += length;
+        used.back() = start + length;
+        bytes += length;
+        changedFrom = min(changedFrom, blocks.size() - 1);
+        return TextRef{static_cast<uint32_t>(blocks.size() - 1) << BLOCK_SHIFT | start, length};
+    }
+    
+    string_view text(TextRef ref) const {
+        if (ref.length == 0) return string_view();
+        return string_view(blocks[ref.offset >> BLOCK_SHIFT].get() + (ref.offset & (BLOCK_SIZE - 1)),
+                           ref.length);
+    }
+    
+    // Whether ref lies within the text written so far
+    bool contains(TextRef ref) const {
+        if (ref.length == 0) return true;
+        size_t block = ref.offset >> BLOCK_SHIFT;
+        return block < blocks.size() && uint64_t(ref.offset & (BLOCK_SIZE - 1)) + ref.length <= used[block];
+    }
+    
+    size_t size() const { return bytes; }
+    
+    // The blocks as written, for checkpoints; every block before
+    // changedSince() is as it was at the last markClean()
+    size_t blockCount() const { return blocks.size(); }
+    string_view block(size_t i) const { return string_view(blocks[i].get(), used[i]); }
+    uint32_t tailPosition() const { return position; }
+    size_t changedSince() const { return changedFrom; }
+    void markClean() { changedFrom = blocks.size(); }
+    void markChanged(size_t from) { changedFrom = min(changedFrom, from); }
+    
+    // Add a block of a mapped file as it is; data must outlive the arena
+    // and its copies, which the owner of the pointer sees to
+    void borrowBlock(shared_ptr<char[]> data, uint32_t size) {
+        blocks.push_back(move(data));
+        used.push_back(size);
+        bytes += size;
+        borrowed = blocks.size();
+    }
+    
+    // Whether the next short append would write into a borrowed block
+    bool tailBorrowed() const { return position < BLOCK_SIZE && blocks.size() <= borrowed; }
+    
+    // Give the tail block a private copy, which appends may then write
+    void ownTail() {
+        if (blocks.empty() || blocks.size() > borrowed) return;
+        shared_ptr<char[]> copy(new char[max<size_t>(used.back(), BLOCK_SIZE)]);
+        memcpy(copy.get(), blocks.back().get(), used.back());
+        blocks.back() = move(copy);
+        borrowed = blocks.size() - 1;
+    }
+    
+    // Rebuild the arena from blocks read back from a checkpoint; position
+    // is the tailPosition() it was written with
+    void appendBlock(string_view data) {
+        blocks.emplace_back(new char[max<size_t>(data.size(), BLOCK_SIZE)]);
+        memcpy(blocks.back().get(), data.data(), data.size());
+        used.push_back(static_cast<uint32_t>(data.size()));
+        bytes += data.size();
+    }
+    bool setTailPosition(uint32_t tail) {
+        if (tail != BLOCK_SIZE && (blocks.empty() || tail != used.back())) return false;
+        position = tail;
+        return true;
+    }
+    
+    void clear() {
+        blocks.clear();
+        used.clear();
+        position = BLOCK_SIZE;
+        bytes = 0;
+        changedFrom = 0;
+        borrowed = 0;
+    }
+    
+    void swap(TextArena& other) {
+        blocks.swap(other.blocks);
+        used.swap(other.used);
+        std::swap(position, other.position);
+        std::swap(bytes, other.bytes);
+        std::swap(changedFrom, other.changedFrom);
+        std::swap(borrowed, other.borrowed);
+    }
+};
+
+// Growable student storage addressed by slot handles, kept as columns:
+// each field has its own paged array indexed by slot, so a scan reads only
+// the fields it needs. Remarks are one-byte RemarkCodes, and names and
+// month histories live in a TextArena, leaving about 26 bytes per student
+// plus the text itself. A slot number stays valid as a handle until it is
+// removed; removed slots go on a free list and are reused by later adds.
+// The store can also sit on top of a mapped data file: those slots are read
+// straight from the mapping and copied into the columns on their first edit.
+// A mapped paged file is copied a slot page at a time, and its text blocks
+// become the arena's first blocks, so only the fixed fields are copied.
+class StudentStore {
+private:
+    PagedColumn<int32_t> rollNumbers;
+    PagedColumn<uint8_t> remarks;       // RemarkCode
+    PagedColumn<DayMask> attendance;
+    PagedColumn<TextRef> names;
+    PagedColumn<TextRef> histories;     // other months, see MonthHistory
+    PagedColumn<uint8_t> live;
+    vector<int> freeSlots;
+    int liveCount;
+    TextArena text;
+    size_t textBytes;                   // arena bytes still referenced
+    
+    shared_ptr<const MappedRoster> mapped;
+    int mappedCount;
+    PagedColumn<uint64_t> materialized; // one bit per mapped slot
+    bool mappedPages;                   // mapped is a paged file
+    bool damaged;                       // a page copied from it failed its checksum
+    
+    vector<uint64_t> changedPages;      // one bit per slot page of a checkpoint
+    bool allChanged;                    // every page, since the last markClean()
+    
+    // Note a change for the next checkpoint. Only slot pages copied out of
+    // a mapping are written, so the mapping never loses a page it serves.
+    void touch(int slot) {
+        size_t page = slot / PAGED_PAGE_SLOTS;
+        if (mappedPages) materializePage(static_cast<int>(page));
+        if (page / 64 >= changedPages.size()) changedPages.resize(page / 64 + 1, 0);
+        changedPages[page / 64] |= uint64_t(1) << (page % 64);
+    }
+    
+    bool inMapping(int slot) const {
+        return slot < mappedCount && !((materialized[slot >> 6] >> (slot & 63)) & 1);
+    }
+    
+    void markMaterialized(int slot) {
+        if (slot < mappedCount) materialized.edit(slot >> 6) |= uint64_t(1) << (slot & 63);
+    }
+    
+    // Columns cover the slots in use; mapped slots are added on first edit
+    void coverSlot(int slot) {
+        size_t count = slot + 1;
+        if (count > rollNumbers.size()) {
+            rollNumbers.resize(count);
+            remarks.resize(count);
+            attendance.resize(count);
+            names.resize(count);
+            histories.resize(count);
+        }
+    }
+    
+    // Copy a mapped student into the columns before its first edit
+    void materialize(int slot) {
+        if (!inMapping(slot)) return;
+        if (mappedPages) {
+            materializePage(slot / PAGED_PAGE_SLOTS);
+            return;
+        }
+        coverSlot(slot);
+        rollNumbers.edit(slot) = mapped->rollNumber(slot);
+        remarks.edit(slot) = mapped->remarkCode(slot);
+        attendance.edit(slot) = mapped->attendanceMask(slot);
+        names.edit(slot) = text.append(mapped->name(slot));
+        histories.edit(slot) = text.append(mapped->months(slot));
+        textBytes += names[slot].length + histories[slot].length;
+        markMaterialized(slot);
+    }
+    
+    // Marks may land while other threads read (see markInPlace())
+    DayMask attendanceAt(int slot) const { return __atomic_load_n(&attendance[slot], __ATOMIC_RELAXED); }
+    
+    // A reference read from a mapped slot page; one outside the arena
+    // reads as empty, as names of other mapped files are bounds-checked
+    TextRef mappedRef(TextRef ref) const { return text.contains(ref) ? ref : TextRef{0, 0}; }
+    
+    // Copy the mapped slots of a slot page into the columns, checking the
+    // page's checksum on the way. Pages are copied whole, so a page whose
+    // first slot is still mapped has not been copied yet.
+    void materializePage(int page) {
+        int first = page * PAGED_PAGE_SLOTS;
+        if (!inMapping(first)) return;
+        if (!mapped->slotPageIntact(page)) damaged = true;
+        int end = min(mappedCount, first + PAGED_PAGE_SLOTS);
+        coverSlot(end - 1);
+        for (int slot = first; slot < end; slot++) {
+            rollNumbers.edit(slot) = mapped->rollNumber(slot);
+            remarks.edit(slot) = mapped->remarkCode(slot);
+            attendance.edit(slot) = mapped->attendanceMask(slot);
+            names.edit(slot) = live[slot] ? mappedRef(mapped->nameRef(slot)) : TextRef{0, 0};
+            histories.edit(slot) = live[slot] ? mappedRef(mapped->historyRef(slot)) : TextRef{0, 0};
+            markMaterialized(slot);
+        }
+    }
+    
+    // Copy a tail block borrowed from the mapping before text is appended
+    // to it, checking it like a slot page
+    void ownTextTail() {
+        if (!text.tailBorrowed()) return;
+        if (mapped && mappedPages && !mapped->textBlockIntact(text.blockCount() - 1)) damaged = true;
+        text.ownTail();
+    }
+    
+    void replaceText(TextRef& ref, string_view value) {
+        ownTextTail();
+        textBytes -= ref.length;
+        ref = text.append(value);
+        textBytes += ref.length;
+        // Repack once garbage outweighs live text, so the cost is
+        // amortized over the replacements that made it
+        size_t garbage = text.size() - textBytes;
+        if (garbage > max<size_t>(textBytes, 1 << 20)) repackText();
+    }
+    
+    // Copy the live text into a fresh arena, dropping replaced strings.
+    // Invalidates string_views into the old one.
+    void repackText() {
+        allChanged = true;
+        if (mappedPages) detach();
+        TextArena packed;
+        for (int i = 0; i < slotLimit(); i++) {
+            if (!live[i] || inMapping(i)) continue;
+            names.edit(i) = packed.append(text.text(names[i]));
+            histories.edit(i) = packed.append(text.text(histories[i]));
+        }
+        text.swap(packed);
+    }
+    
+public:
+    StudentStore() : liveCount(0), textBytes(0), mappedCount(0), mappedPages(false), damaged(false),
+                     allChanged(true) {}
+    
+    // Read access; never copies a mapped student
+    StudentView view(int slot) const {
+        if (inMapping(slot)) {
+            if (!mappedPages) return mapped->view(slot);
+            return StudentView(mapped->rollNumber(slot), name(slot), mapped->remarkCode(slot),
+                               mapped->attendanceMask(slot), history(slot));
+        }
+        return StudentView(rollNumbers[slot], text.text(names[slot]), remarks[slot],
+                           attendanceAt(slot), text.text(histories[slot]));
+    }
+    
+    // Single fields, for scans that need no more
+    int rollNumber(int slot) const {
+        return inMapping(slot) ? mapped->rollNumber(slot) : rollNumbers[slot];
+    }
+    DayMask attendanceMask(int slot) const {
+        return inMapping(slot) ? mapped->attendanceMask(slot) : attendanceAt(slot);
+    }
+    string_view name(int slot) const {
+        if (!inMapping(slot)) return text.text(names[slot]);
+        return mappedPages ? text.text(mappedRef(mapped->nameRef(slot))) : mapped->name(slot);
+    }
+    string_view history(int slot) const {
+        if (!inMapping(slot)) return text.text(histories[slot]);
+        return mappedPages ? text.text(mappedRef(mapped->historyRef(slot))) : mapped->months(slot);
+    }
+    
+    // Write access; a mapped student is copied into the columns first
+    void setRollNumber(int slot, int rollNumber) {
+        materialize(slot);
+        touch(slot);
+        rollNumbers.edit(slot) = rollNumber;
+    }
+    void setName(int slot, string_view name) {
+        materialize(slot);
+        touch(slot);
+        replaceText(names.edit(slot), name);
+    }
+    void setRemarks(int slot, uint8_t code) {
+        materialize(slot);
+        touch(slot);
+        remarks.edit(slot) = code < REMARK_CODE_COUNT ? code : uint8_t(REMARK_NONE);
+    }
+    void setAttendanceMask(int slot, DayMask mask) {
+        materialize(slot);
+        touch(slot);
+        attendance.edit(slot) = mask & dayMaskFor(MAX_DAYS);
+    }
+    void setAttendance(int slot, int day, bool present) {
+        if (day < 0 || day >= MAX_DAYS) return;
+        materialize(slot);
+        touch(slot);
+        if (present) attendance.edit(slot) |= DayMask(1) << day;
+        else attendance.edit(slot) &= ~(DayMask(1) << day);
+    }
+    void setHistory(int slot, string_view months) {
+        materialize(slot);
+        touch(slot);
+        replaceText(histories.edit(slot), months);
+    }
+    
+    // Whether markInPlace() may be used on slot: the student is out of the
+    // mapping and its slot page is already due for the next checkpoint,
+    // so a mark changes nothing but the attendance word
+    bool markableInPlace(int slot) const {
+        if (inMapping(slot)) return false;
+        size_t page = slot / PAGED_PAGE_SLOTS;
+        return allChanged || (page / 64 < changedPages.size() && ((changedPages[page / 64] >> (page % 64)) & 1));
+    }
+    
+    // Set or clear a 0-based day of slot's attendance with one atomic
+    // read-modify-write, so marks on other students need no lock; returns
+    // the mask from before. The page is changed in place rather than
+    // copied: a published read view sharing it sees the mark at once. A
+    // background save sharing it may write the mark early, which is
+    // harmless as the journal replays it after the save anyway.
+    DayMask markInPlace(int slot, int day, bool present) {
+        DayMask* word = &attendance.inPlace(slot);
+        DayMask bit = DayMask(1) << day;
+        return present ? __atomic_fetch_or(word, bit, __ATOMIC_RELAXED)
+                       : __atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED);
+    }
+    
+    // Number of students stored
+    int size() const { return liveCount; }
+    
+    // Slots are numbered 0..slotLimit()-1; some may be free
+    int slotLimit() const { return static_cast<int>(live.size()); }
+    
+    bool isLive(int slot) const {
+        return slot >= 0 && slot < slotLimit() && live[slot];
+    }
+    
+    bool isMapped() const { return mapped != nullptr; }
+    bool mapsPages() const { return mappedPages; }
+    
+    // Whether a page copied from a mapped paged file since the last call
+    // failed its checksum
+    bool takeDamaged() {
+        bool found = damaged;
+        damaged = false;
+        return found;
+    }
+    
+    // A point-in-time copy for reading on another thread. Columns, text
+    // and mapping are shared with this store rather than copied, so this
+    // costs a few pointers per 4096 students; edits made here afterwards
+    // copy the pages they touch. The copy must be destroyed on the thread
+    // that edits this store.
+    StudentStore frozenCopy() const {
+        StudentStore copy;
+        copy.rollNumbers = rollNumbers;
+        copy.remarks = remarks;
+        copy.attendance = attendance;
+        copy.names = names;
+        copy.histories = histories;
+        copy.live = live;
+        copy.liveCount = liveCount;
+        copy.text = text;
+        copy.textBytes = textBytes;
+        copy.mapped = mapped;
+        copy.mappedCount = mappedCount;
+        copy.materialized = materialized;
+        copy.mappedPages = mappedPages;
+        return copy;
+    }
+    
+    // Hint that slot's attendance will be edited soon
+    void prefetch(int slot) const {
+        if (slot < static_cast<int>(attendance.size())) __builtin_prefetch(&attendance[slot], 1);
+    }
+    
+    // Allocate a blank student and return its slot
+    int add() {
+        int slot;
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = slotLimit();
+            live.push_back(0);
+        }
+        touch(slot);
+        coverSlot(slot);
+        rollNumbers.edit(slot) = 0;
+        remarks.edit(slot) = REMARK_NONE;
+        attendance.edit(slot) = 0;
+        names.edit(slot) = histories.edit(slot) = TextRef{0, 0};
+        markMaterialized(slot);
+        live.edit(slot) = 1;
+        liveCount++;
+        return slot;
+    }
+    
+    void remove(int slot) {
+        if (!isLive(slot)) return;
+        touch(slot);
+        if (!inMapping(slot)) {
+            textBytes -= names[slot].length + histories[slot].length;
+            names.edit(slot) = histories.edit(slot) = TextRef{0, 0};
+        }
+        live.edit(slot) = 0;
+        freeSlots.push_back(slot);
+        liveCount--;
+    }
+    
+    // Serve every student of roster from the mapping, replacing the contents
+    void attach(unique_ptr<MappedRoster> roster) {
+        clear();
+        mappedCount = roster->count();
+        live.assign(mappedCount, 1);
+        liveCount = mappedCount;
+        materialized.assign((mappedCount + 63) / 64, 0);
+        mapped = shared_ptr<const MappedRoster>(move(roster));
+        allChanged = true;
+    }
+    
+    // Serve a checkpoint of a paged file from its mapping, replacing the
+    // contents; the store then matches the checkpoint, so nothing counts
+    // as changed. Reads the live flags and nothing else. referencedText is
+    // the checkpoint's count of text still in use. False if the mapping's
+    // text does not fit together.
+    bool attachPages(unique_ptr<MappedRoster> roster, uint32_t textPosition, uint64_t referencedText) {
+        clear();
+        shared_ptr<const MappedRoster> owner(move(roster));
+        for (size_t block = 0; block < owner->textBlockCount(); block++) {
+            string_view data = owner->textBlock(block);
+            text.borrowBlock(shared_ptr<char[]>(owner, const_cast<char*>(data.data())),
+                             static_cast<uint32_t>(data.size()));
+        }
+        if (!text.setTailPosition(textPosition)) {
+            clear();
+            return false;
+        }
+        mappedCount = owner->count();
+        live.resize(mappedCount);
+        for (int slot = mappedCount - 1; slot >= 0; slot--) {
+            if (!owner->isLive(slot)) {
+                freeSlots.push_back(slot);
+                continue;
+            }
+            live.edit(slot) = 1;
+            liveCount++;
+        }
+        textBytes = referencedText;
+        materialized.assign((mappedCount + 63) / 64, 0);
+        mapped = move(owner);
+        mappedPages = true;
+        markClean();
+        return true;
+    }
+    
+    // Copy every remaining mapped student into memory and drop the mapping.
+    // Text borrowed from a paged file stays where it is.
+    void detach() {
+        if (!mapped) return;
+        if (mappedPages) {
+            for (int page = 0; page * PAGED_PAGE_SLOTS < mappedCount; page++) materializePage(page);
+            ownTextTail();
+        } else {
+            for (int i = 0; i < mappedCount; i++) {
+                if (live[i]) materialize(i);
+            }
+            allChanged = true;
+        }
+        mapped.reset();
+        mappedCount = 0;
+        materialized.clear();
+        mappedPages = false;
+    }
+    
+    // Move live students to the front so slots 0..size()-1 are all in use.
+    // Invalidates handles; callers must rebuild anything keyed by slot.
+    void compact() {
+        vector<int> order;
+        order.reserve(liveCount);
+        for (int i = 0; i < slotLimit(); i++) {
+            if (live[i]) order.push_back(i);
+        }
+        reorder(order);
+    }
+    
+    // Rearrange the roster so slot k holds the student that was in
+    // order[k]; order must list every live slot once. Each column is
+    // gathered in turn and the text is repacked in the new order, so
+    // neighbouring slots have neighbouring names. Mapped students are
+    // copied straight into their new place and the mapping is dropped.
+    // Invalidates handles like compact().
+    void reorder(const vector<int>& order) {
+        size_t count = order.size();
+        PagedColumn<int32_t> sortedRolls;
+        PagedColumn<uint8_t> sortedRemarks;
+        PagedColumn<DayMask> sortedAttendance;
+        PagedColumn<TextRef> sortedNames, sortedHistories;
+        sortedRolls.resize(count);
+        sortedRemarks.resize(count);
+        sortedAttendance.resize(count);
+        sortedNames.resize(count);
+        sortedHistories.resize(count);
+        TextArena packed;
+        for (size_t k = 0; k < count; k++) {
+            StudentView student = view(order[k]);
+            sortedRolls.edit(k) = student.getRollNumber();
+            sortedRemarks.edit(k) = student.getRemarkCode();
+            sortedAttendance.edit(k) = student.getAttendanceMask();
+            sortedNames.edit(k) = packed.append(student.getName());
+            sortedHistories.edit(k) = packed.append(student.getHistory());
+        }
+        rollNumbers.swap(sortedRolls);
+        remarks.swap(sortedRemarks);
+        attendance.swap(sortedAttendance);
+        names.swap(sortedNames);
+        histories.swap(sortedHistories);
+        text.swap(packed);
+        textBytes = text.size();
+        live.assign(count, 1);
+        freeSlots.clear();
+        mapped.reset();
+        mappedCount = 0;
+        materialized.clear();
+        mappedPages = false;
+        allChanged = true;
+    }
+    
+    void clear() {
+        rollNumbers.clear();
+        remarks.clear();
+        attendance.clear();
+        names.clear();
+        histories.clear();
+        live.clear();
+        freeSlots.clear();
+        liveCount = 0;
+        text.clear();
+        textBytes = 0;
+        mapped.reset();
+        mappedCount = 0;
+        materialized.clear();
+        mappedPages = false;
+        damaged = false;
+        allChanged = true;
+    }
+    
+    // ---- Checkpoints (see RosterPageFile) ----
+    // Slot pages cover PAGED_PAGE_SLOTS slots each. A checkpoint writes
+    // the slot pages touched since markClean() and the text blocks from
+    // changedTextFrom() on; names and histories keep their TextRefs, so
+    // the file's text blocks are the arena's blocks.
+    
+    int slotPageCount() const { return (slotLimit() + PAGED_PAGE_SLOTS - 1) / PAGED_PAGE_SLOTS; }
+    const TextArena& textArena() const { return text; }
+    uint64_t referencedText() const { return textBytes; }
+    bool everythingChanged() const { return allChanged; }
+    size_t changedTextFrom() const { return allChanged ? 0 : text.changedSince(); }
+    
+    vector<int> changedSlotPages() const {
+        vector<int> pages;
+        for (int page = 0; page < slotPageCount(); page++) {
+            if (allChanged || (size_t(page / 64) < changedPages.size() &&
+                               ((changedPages[page / 64] >> (page % 64)) & 1))) {
+                pages.push_back(page);
+            }
+        }
+        return pages;
+    }
+    
+    // Start the next checkpoint's changes from here
+    void markClean() {
+        changedPages.clear();
+        allChanged = false;
+        text.markClean();
+    }
+    
+    // Give back what a failed checkpoint took from markClean()
+    void markChanged(const vector<int>& pages, size_t textFrom, bool all) {
+        for (int page : pages) touch(page * PAGED_PAGE_SLOTS);
+        text.markChanged(textFrom);
+        allChanged = allChanged || all;
+    }
+    
+    // Fixed fields of the slots of a slot page, laid out as in the file.
+    // Slots still in a paged mapping are read from it; any other mapping
+    // must be detached first.
+    void encodeSlotPage(int page, char* out) const {
+        memset(out, 0, PAGED_SLOT_PAGE_BYTES);
+        int32_t* rolls = reinterpret_cast<int32_t*>(out + SLOT_ROLL_NUMBERS);
+        DayMask* masks = reinterpret_cast<DayMask*>(out + SLOT_ATTENDANCE);
+        TextRef* nameRefs = reinterpret_cast<TextRef*>(out + SLOT_NAMES);
+        TextRef* historyRefs = reinterpret_cast<TextRef*>(out + SLOT_HISTORIES);
+        uint8_t* remarkCodes = reinterpret_cast<uint8_t*>(out + SLOT_REMARKS);
+        uint8_t* liveFlags = reinterpret_cast<uint8_t*>(out + SLOT_LIVE);
+        int first = page * PAGED_PAGE_SLOTS;
+        int end = min(slotLimit(), first + PAGED_PAGE_SLOTS);
+        for (int slot = first; slot < end; slot++) {
+            int i = slot - first;
+            liveFlags[i] = live[slot];
+            TextRef name{0, 0}, history{0, 0};
+            if (inMapping(slot)) {
+                rolls[i] = littleEndian(mapped->rollNumber(slot));
+                masks[i] = littleEndian(mapped->attendanceMask(slot));
+                remarkCodes[i] = mapped->remarkCode(slot);
+                if (live[slot]) {
+                    name = mappedRef(mapped->nameRef(slot));
+                    history = mappedRef(mapped->historyRef(slot));
+                }
+            } else if (slot < static_cast<int>(rollNumbers.size())) {
+                rolls[i] = littleEndian(rollNumbers[slot]);
+                masks[i] = littleEndian(attendanceAt(slot));
+                remarkCodes[i] = remarks[slot];
+                name = names[slot];
+                history = histories[slot];
+            }
+            nameRefs[i] = TextRef{littleEndian(name.offset), littleEndian(name.length)};
+            historyRefs[i] = TextRef{littleEndian(history.offset), littleEndian(history.length)};
+        }
+    }
+    
+    // Rebuilding from a checkpoint: clear(), appendTextBlock() for each
+    // block, then beginSlots(), decodeSlotPage() for each slot page and
+    // endSlots(). The decode steps return false on data that does not fit
+    // together.
+    void appendTextBlock(string_view block) { text.appendBlock(block); }
+    bool setTextTail(uint32_t position) { return text.setTailPosition(position); }
+    
+    void beginSlots(int slotCount) {
+        rollNumbers.resize(slotCount);
+        remarks.resize(slotCount);
+        attendance.resize(slotCount);
+        names.resize(slotCount);
+        histories.resize(slotCount);
+        live.resize(slotCount);
+    }
+    
+    bool decodeSlotPage(int page, const char* in) {
+        int first = page * PAGED_PAGE_SLOTS;
+        int end = min(slotLimit(), first + PAGED_PAGE_SLOTS);
+        for (int slot = first; slot < end; slot++) {
+            int i = slot - first;
+            int32_t roll;
+            DayMask mask;
+            TextRef name, history;
+            memcpy(&roll, in + SLOT_ROLL_NUMBERS + i * 4, 4);
+            memcpy(&mask, in + SLOT_ATTENDANCE + i * 4, 4);
+            memcpy(&name, in + SLOT_NAMES + i * 8, 8);
+            memcpy(&history, in + SLOT_HISTORIES + i * 8, 8);
+            name = TextRef{littleEndian(name.offset), littleEndian(name.length)};
+            history = TextRef{littleEndian(history.offset), littleEndian(history.length)};
+            uint8_t code = static_cast<uint8_t>(in[SLOT_REMARKS + i]);
+            uint8_t isLive = static_cast<uint8_t>(in[SLOT_LIVE + i]);
+            if (isLive > 1 || !text.contains(name) || !text.contains(history)) return false;
+            rollNumbers.edit(slot) = littleEndian(roll);
+            attendance.edit(slot) = littleEndian(mask) & dayMaskFor(MAX_DAYS);
+            names.edit(slot) = isLive ? name : TextRef{0, 0};
+            histories.edit(slot) = isLive ? history : TextRef{0, 0};
+            remarks.edit(slot) = code < REMARK_CODE_COUNT ? code : uint8_t(REMARK_NONE);
+            live.edit(slot) = isLive;
+        }
+        return true;
+    }
+    
+    void endSlots() {
+        for (int slot = slotLimit() - 1; slot >= 0; slot--) {
+            if (!live[slot]) {
+                freeSlots.push_back(slot);
+                continue;
+            }
+            liveCount++;
+            textBytes += names[slot].length + histories[slot].length;
+        }
+        markClean();
+    }
+};
+
+// Running attendance counters for the whole roster, updated with every
+// change so the class average and day statistics never need a scan.
+// Per-day counts cover all MAX_DAYS days; the total only counts days
+// 1..days of the current month.
+// Changes to the totals made by marks kept apart from them, so that marks
+// under different stripes need not share counters (see RosterLock)
+struct MarkTally {
+    int64_t presentDays;
+    int64_t presentOnDay[MAX_DAYS];
+};
+
+class AttendanceTotals {
+private:
+    int studentCount;
+    int days;
+    int64_t presentDays;
+    int presentOnDay[MAX_DAYS];
+    
+public:
+    AttendanceTotals() { reset(MAX_DAYS); }
+    
+    void reset(int daysInMonth) {
+        studentCount = 0;
+        days = daysInMonth;
+        presentDays = 0;
+        memset(presentOnDay, 0, sizeof(presentOnDay));
+    }
+    
+    void add(DayMask mask) {
+        studentCount++;
+        for (DayMask bits = mask; bits != 0; bits &= bits - 1) {
+            presentOnDay[__builtin_ctz(bits)]++;
+        }
+        presentDays += countPresentDays(mask & dayMaskFor(days));
+    }
+    
+    void remove(DayMask mask) {
+        studentCount--;
+        for (DayMask bits = mask; bits != 0; bits &= bits - 1) {
+            presentOnDay[__builtin_ctz(bits)]--;
+        }
+        presentDays -= countPresentDays(mask & dayMaskFor(days));
+    }
+    
+    // One student's days changed from before to after
+    void change(DayMask before, DayMask after) {
+        for (DayMask bits = before & ~after; bits != 0; bits &= bits - 1) {
+            presentOnDay[__builtin_ctz(bits)]--;
+        }
+        for (DayMask bits = after & ~before; bits != 0; bits &= bits - 1) {
+            presentOnDay[__builtin_ctz(bits)]++;
+        }
+        DayMask month = dayMaskFor(days);
+        presentDays += countPresentDays(after & month) - countPresentDays(before & month);
+    }
+    
+    // Add the marks counted in tally, or take them back out (sign -1)
+    void addTally(const MarkTally& tally, int sign) {
+        presentDays += sign * tally.presentDays;
+        for (int day = 0; day < MAX_DAYS; day++) {
+            presentOnDay[day] += static_cast<int>(sign * tally.presentOnDay[day]);
+        }
+    }
+    
+    int students() const { return studentCount; }
+    
+    // Students present on a 0-based day
+    int presentOn(int day) const { return presentOnDay[day]; }
+    
+    // Mean of every student's attendance percentage
+    double averagePercentage() const {
+        if (studentCount == 0 || days <= 0) return 0;
+        return 100.0 * presentDays / (static_cast<double>(studentCount) * days);
+    }
+};
+
+// Students grouped by their number of present days this month. A month
+// has at most MAX_DAYS + 1 distinct percentages, so threshold and range
+// queries only visit the buckets that match and count in O(MAX_DAYS).
+// Each slot remembers its bucket and position, so moving a student to
+// another bucket is O(1).
+class PresentDayBuckets {
+private:
+    vector<int> buckets[MAX_DAYS + 1];
+    vector<int> position;       // per slot; -1 if not in a bucket
+    vector<uint8_t> bucketOf;   // per slot
+    bool built;
+    
+public:
+    PresentDayBuckets() : built(false) {}
+    
+    bool ready() const { return built; }
+    
+    // Forget the contents; the owner refills it when next needed
+    void invalidate() {
+        for (vector<int>& bucket : buckets) bucket.clear();
+        position.clear();
+        bucketOf.clear();
+        built = false;
+    }
+    
+    // Start an empty index for slots 0..slotLimit-1
+    void reset(int slotLimit) {
+        invalidate();
+        position.assign(slotLimit, -1);
+        bucketOf.assign(slotLimit, 0);
+        built = true;
+    }
+    
+    void insert(int slot, int presentDays) {
+        if (slot >= static_cast<int>(position.size())) {
+            position.resize(slot + 1, -1);
+            bucketOf.resize(slot + 1, 0);
+        }
+        vector<int>& bucket = buckets[presentDays];
+        position[slot] = static_cast<int>(bucket.size());
+        bucketOf[slot] = static_cast<uint8_t>(presentDays);
+        bucket.push_back(slot);
+    }
+    
+    void erase(int slot) {
+        if (slot >= static_cast<int>(position.size()) || position[slot] < 0) return;
+        vector<int>& bucket = buckets[bucketOf[slot]];
+        int last = bucket.back();
+        bucket[position[slot]] = last;
+        position[last] = position[slot];
+        bucket.pop_back();
+        position[slot] = -1;
+    }
+    
+    void update(int slot, int presentDays) {
+        if (bucketOf[slot] == presentDays) return;
+        erase(slot);
+        insert(slot, presentDays);
+    }
+    
+    // Slots with exactly this many present days, in no particular order
+    const vector<int>& with(int presentDays) const { return buckets[presentDays]; }
+};
+
+// Day-major copy of the selected month's marks: for each day one column
+// with a bit per slot, packed into 64-bit words, next to a column of the
+// live slots. Whole-day operations and day listings then scan contiguous
+// words instead of striding across every student. Built on first use and
+// kept current by the owner like the other indices.
+class DayColumns {
+private:
+    vector<uint64_t> liveSlots;
+    vector<uint64_t> columns[MAX_DAYS];
+    bool built;
+    
+    void grow(int slot) {
+        size_t words = static_cast<size_t>(slot) / 64 + 1;
+        if (words <= liveSlots.size()) return;
+        words = max(words, liveSlots.size() * 2);
+        liveSlots.resize(words, 0);
+        for (vector<uint64_t>& column : columns) column.resize(words, 0);
+    }
+    
+public:
+    DayColumns() : built(false) {}
+    
+    bool ready() const { return built; }
+    
+    void invalidate() {
+        liveSlots.clear();
+        for (vector<uint64_t>& column : columns) column.clear();
+        built = false;
+    }
+    
+    // Start an empty index for slots 0..slotLimit-1
+    void reset(int slotLimit) {
+        invalidate();
+        size_t words = (static_cast<size_t>(slotLimit) + 63) / 64;
+        liveSlots.assign(words, 0);
+        for (vector<uint64_t>& column : columns) column.assign(words, 0);
+        built = true;
+    }
+    
+    void insert(int slot, DayMask mask) {
+        grow(slot);
+        uint64_t bit = uint64_t(1) << (slot % 64);
+        liveSlots[slot / 64] |= bit;
+        for (DayMask bits = mask; bits != 0; bits &= bits - 1) {
+            columns[__builtin_ctz(bits)][slot / 64] |= bit;
+        }
+    }
+    
+    void erase(int slot) {
+        uint64_t keep = ~(uint64_t(1) << (slot % 64));
+        liveSlots[slot / 64] &= keep;
+        for (vector<uint64_t>& column : columns) column[slot / 64] &= keep;
+    }
+    
+    // day is 0-based
+    void set(int slot, int day, bool present) {
+        uint64_t bit = uint64_t(1) << (slot % 64);
+        if (present) columns[day][slot / 64] |= bit;
+        else columns[day][slot / 64] &= ~bit;
+    }
+    
+    // set() for marks made concurrently; neighbouring slots share a word
+    void setAtomically(int slot, int day, bool present) {
+        uint64_t bit = uint64_t(1) << (slot % 64);
+        uint64_t* word = &columns[day][slot / 64];
+        if (present) __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+        else __atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED);
+    }
+    
+    size_t words() const { return liveSlots.size(); }
+    const uint64_t* live() const { return liveSlots.data(); }
+    const uint64_t* column(int day) const { return columns[day].data(); }
+    
+    // Replace a whole column, e.g. with live() or another day's column
+    void assign(int day, const uint64_t* bits) {
+        memcpy(columns[day].data(), bits, words() * sizeof(uint64_t));
+    }
+};
+
+// Roster sorting. Keys are extracted once per student into compact rows,
+// the rows are sorted, and the resulting slot order is applied to the
+// store in a single pass; students themselves are never swapped.
+enum SortField { SORT_BY_ATTENDANCE, SORT_BY_NAME, SORT_BY_ROLL_NUMBER };
+
+struct SortKey {
+    SortField field;
+    bool descending;
+};
+
+// Keys of one student, extracted once before sorting
+struct SortRow {
+    int slot;
+    int rollNumber;
+    int presentDays;            // same order as the percentage
+    string_view name;
+};
+
+// What is actually sorted: as many leading key bits as fit in 64, so most
+// comparisons are one integer compare, plus the student's row number.
+struct SortEntry {
+    uint64_t packed;
+    uint32_t row;
+};
+
+class RosterSorter {
+private:
+    // Rosters at least this large are sorted on several threads
+    static const int PARALLEL_THRESHOLD = 1 << 16;
+    
+    const vector<SortKey>& keys;
+    vector<SortRow> rows;
+    
+    static uint64_t namePrefix(string_view name) {
+        uint64_t prefix = 0;
+        for (size_t i = 0; i < 8; i++) {
+            uint8_t byte = i < name.size() ? static_cast<uint8_t>(name[i]) : 0;
+            prefix = (prefix << 8) | byte;
+        }
+        return prefix;
+    }
+    
+    // Pack the keys of row, most significant first, into one ordered
+    // integer. Equal packed values still need the full comparison.
+    uint64_t pack(const SortRow& row) const {
+        uint64_t packed = 0;
+        int freeBits = 64;
+        for (const SortKey& key : keys) {
+            uint64_t value;
+            int width;
+            switch (key.field) {
+                case SORT_BY_ATTENDANCE:
+                    value = row.presentDays;
+                    width = 6;
+                    break;
+                case SORT_BY_NAME:
+                    value = namePrefix(row.name);
+                    width = 64;
+                    break;
+                default:
+                    value = static_cast<uint32_t>(row.rollNumber) ^ 0x80000000u;
+                    width = 32;
+                    break;
+            }
+            if (key.descending) value = ~value & (~uint64_t(0) >> (64 - width));
+            if (width >= freeBits) {
+                // Keep the top bits of this key; nothing after it fits
+                return freeBits == 64 ? value : (packed << freeBits) | (value >> (width - freeBits));
+            }
+            packed = (packed << width) | value;
+            freeBits -= width;
+        }
+        return packed << freeBits;
+    }
+    
+    static int compareField(const SortRow& a, const SortRow& b, SortField field) {
+        switch (field) {
+            case SORT_BY_ATTENDANCE:
+                return (a.presentDays > b.presentDays) - (a.presentDays < b.presentDays);
+            case SORT_BY_NAME:
+                return a.name.compare(b.name);
+            default:
+                return (a.rollNumber > b.rollNumber) - (a.rollNumber < b.rollNumber);
+        }
+    }
+    
+    bool less(const SortEntry& a, const SortEntry& b) const {
+        if (a.packed != b.packed) return a.packed < b.packed;
+        for (const SortKey& key : keys) {
+            int order = compareField(rows[a.row], rows[b.row], key.field);
+            if (order != 0) return key.descending ? order > 0 : order < 0;
+        }
+        return false;
+    }
+    
+public:
+    explicit RosterSorter(const vector<SortKey>& sortKeys) : keys(sortKeys) {}
+    
+    // Live slots of store in key order; ties keep roster order
+    vector<int> sortedSlots(const StudentStore& store, int daysInMonth) {
+        DayMask days = dayMaskFor(daysInMonth);
+        rows.clear();
+        rows.reserve(store.size());
+        for (int i = 0; i < store.slotLimit(); i++) {
+            if (!store.isLive(i)) continue;
+            rows.push_back({i, store.rollNumber(i), countPresentDays(store.attendanceMask(i) & days),
+                            store.name(i)});
+        }
+        
+        int count = static_cast<int>(rows.size());
+        vector<SortEntry> entries(count);
+        for (int k = 0; k < count; k++) entries[k] = {pack(rows[k]), static_cast<uint32_t>(k)};
+        
+        auto less = [this](const SortEntry& a, const SortEntry& b) { return this->less(a, b); };
+        int threads = min<int>(thread::hardware_concurrency(), 8);
+        if (count < PARALLEL_THRESHOLD || threads < 2) {
+            stable_sort(entries.begin(), entries.end(), less);
+        } else {
+            // Sort equal runs in parallel, then merge neighbouring runs
+            // pairwise; both steps are stable, so the result is too.
+            vector<int> bounds;
+            for (int t = 0; t <= threads; t++) {
+                bounds.push_back(static_cast<int>(static_cast<int64_t>(count) * t / threads));
+            }
+            vector<thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t] {
+                    stable_sort(entries.begin() + bounds[t], entries.begin() + bounds[t + 1], less);
+                });
+            }
+            for (thread& worker : workers) worker.join();
+            
+            for (int width = 1; width < threads; width *= 2) {
+                workers.clear();
+                for (int t = 0; t + width < threads; t += 2 * width) {
+                    int first = bounds[t];
+                    int middle = bounds[t + width];
+                    int last = bounds[min(t + 2 * width, threads)];
+                    workers.emplace_back([&, first, middle, last] {
+                        inplace_merge(entries.begin() + first, entries.begin() + middle,
+                                      entries.begin() + last, less);
+                    });
+                }
+                for (thread& worker : workers) worker.join();
+            }
+        }
+        
+        vector<int> order(count);
+        for (int k = 0; k < count; k++) order[k] = rows[entries[k].row].slot;
+        return order;
+    }
+};
+
+// Slots kept in a sorted order that survives edits, without touching the
+// store. A B-tree-like list of sorted blocks: a lookup binary-searches the
+// block ends, then the block, and an insert or erase moves at most one
+// block's worth of entries. Order is a comparator over slots whose keys
+// must end in the slot itself, so no two slots compare equal. Entry can be
+// a larger record naming a slot, for indices with several entries per
+// student.
+//
+// A slot's keys must not change while it is in the index: callers erase it,
+// edit the student, then insert it again. The index starts out stale and is
+// built on first use, like the roll index.
+template <typename Order, typename Entry = int>
+class OrderedSlotIndex {
+private:
+    static const size_t BLOCK_SIZE = 512;   // blocks split at twice this
+    
+    Order order;
+    vector<vector<Entry>> blocks;
+    int count;
+    bool built;
+    
+    // Block that holds slot, or would hold it
+    size_t blockFor(const Entry& slot) const {
+        size_t low = 0, high = blocks.size() - 1;
+        while (low < high) {
+            size_t middle = (low + high) / 2;
+            if (order(blocks[middle].back(), slot)) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+    
+public:
+    explicit OrderedSlotIndex(Order slotOrder) : order(slotOrder), count(0), built(false) {}
+    
+    bool ready() const { return built; }
+    int size() const { return count; }
+    
+    // Forget the contents; the owner rebuilds with assign() when next needed
+    void invalidate() {
+        blocks.clear();
+        count = 0;
+        built = false;
+    }
+    
+    // Replace the contents with slots already in index order
+    void assign(const vector<Entry>& sorted) {
+        blocks.clear();
+        for (size_t i = 0; i < sorted.size(); i += BLOCK_SIZE) {
+            size_t end = min(sorted.size(), i + BLOCK_SIZE);
+            blocks.emplace_back(sorted.begin() + i, sorted.begin() + end);
+        }
+        count = static_cast<int>(sorted.size());
+        built = true;
+    }
+    
+    void insert(const Entry& slot) {
+        if (blocks.empty()) {
+            blocks.push_back({slot});
+            count = 1;
+            return;
+        }
+        size_t b = blockFor(slot);
+        vector<Entry>& block = blocks[b];
+        block.insert(lower_bound(block.begin(), block.end(), slot, order), slot);
+        count++;
+        if (block.size() >= 2 * BLOCK_SIZE) {
+            vector<Entry> upper(block.begin() + BLOCK_SIZE, block.end());
+            block.resize(BLOCK_SIZE);
+            blocks.insert(blocks.begin() + b + 1, move(upper));
+        }
+    }
+    
+    void erase(const Entry& slot) {
+        if (blocks.empty()) return;
+        size_t b = blockFor(slot);
+        vector<Entry>& block = blocks[b];
+        typename vector<Entry>::iterator it = lower_bound(block.begin(), block.end(), slot, order);
+        if (it == block.end() || order(slot, *it)) return;
+        block.erase(it);
+        count--;
+        if (block.empty()) blocks.erase(blocks.begin() + b);
+    }
+    
+    // Call visit(slot) for every slot in order
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        for (const vector<Entry>& block : blocks) {
+            for (const Entry& slot : block) visit(slot);
+        }
+    }
+    
+    // Call visit(entry) in order for the entries not before first, until
+    // visit returns false
+    template <typename Visitor>
+    void forEachFrom(const Entry& first, Visitor visit) const {
+        if (blocks.empty()) return;
+        for (size_t b = blockFor(first); b < blocks.size(); b++) {
+            const vector<Entry>& block = blocks[b];
+            typename vector<Entry>::const_iterator it = block.begin();
+            if (order(block.front(), first)) it = lower_bound(block.begin(), block.end(), first, order);
+            for (; it != block.end(); ++it) {
+                if (!visit(*it)) return;
+            }
+        }
+    }
+};
+
+// Orders for the secondary indices; ties fall back to slot order, which is
+// what a stable sort of the roster would give
+struct NameOrder {
+    const StudentStore* store;
+    
+    bool operator()(int a, int b) const {
+        int order = store->name(a).compare(store->name(b));
+        return order != 0 ? order < 0 : a < b;
+    }
+};
+
+// Highest attendance first, then by name
+struct AttendanceOrder {
+    const StudentStore* store;
+    const int* daysInMonth;
+    
+    bool operator()(int a, int b) const {
+        DayMask days = dayMaskFor(*daysInMonth);
+        int presentA = countPresentDays(store->attendanceMask(a) & days);
+        int presentB = countPresentDays(store->attendanceMask(b) & days);
+        if (presentA != presentB) return presentA > presentB;
+        int order = store->name(a).compare(store->name(b));
+        return order != 0 ? order < 0 : a < b;
+    }
+};
+
+struct RollNumberOrder {
+    const StudentStore* store;
+    
+    bool operator()(int a, int b) const {
+        int rollA = store->rollNumber(a);
+        int rollB = store->rollNumber(b);
+        return rollA != rollB ? rollA < rollB : a < b;
+    }
+};
+
+// Case-insensitive search over the words of every name.
+// - Prefix search: every word is kept in an ordered index by its first
+//   eight folded bytes, so a prefix is one range scan; longer prefixes are
+//   checked against the name.
+// - Fuzzy search works on the vocabulary of distinct words, which is far
+//   smaller than the roster, and each word lists the slots using it. A
+//   word's trigrams (with a boundary mark at each end) point back to it. A
+//   word within k edits of the query lacks at most 3k of the query's
+//   distinct trigrams, so counting hits over the query's posting lists
+//   leaves few candidates to check with a bounded edit distance.
+// A query of several words matches names having a match for each word;
+// candidates come from the longest word. Like the sorted indices, a slot's
+// name must not change while it is in the index.
+class NameSearchIndex {
+public:
+    struct Match {
+        int slot;
+        int distance;           // edits, summed over the query words
+    };
+    
+private:
+    struct WordEntry {
+        uint64_t prefix;        // first eight folded bytes, big-endian
+        int slot;
+        int word;               // position in the name
+    };
+    
+    struct WordOrder {
+        bool operator()(const WordEntry& a, const WordEntry& b) const {
+            if (a.prefix != b.prefix) return a.prefix < b.prefix;
+            return a.slot != b.slot ? a.slot < b.slot : a.word < b.word;
+        }
+    };
+    
+    static const int SYMBOLS = 28;      // word boundary, a-z, anything else
+    
+    const StudentStore* store;
+    OrderedSlotIndex<WordOrder, WordEntry> words;
+    vector<string> vocabulary;          // distinct folded words by id; "" if free
+    vector<vector<int>> slotsWithWord;  // by word id, once per occurrence
+    unordered_map<string, int> wordIds;
+    vector<int> freeWordIds;
+    vector<vector<int>> postings;       // word ids by trigram
+    mutable vector<uint16_t> hits;      // scratch for fuzzySearch, by word id; a word
+                                        // has at most SYMBOLS^3 distinct trigrams
+    bool built;
+    
+    static char fold(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    
+    static int symbol(char c) {
+        return c >= 'a' && c <= 'z' ? c - 'a' + 1 : SYMBOLS - 1;
+    }
+    
+    static void foldedWords(string_view name, vector<string>& result) {
+        result.clear();
+        size_t pos = 0;
+        while (pos < name.size()) {
+            while (pos < name.size() && name[pos] == ' ') pos++;
+            if (pos >= name.size()) break;
+            size_t end = pos;
+            while (end < name.size() && name[end] != ' ') end++;
+            result.emplace_back();
+            for (size_t i = pos; i < end; i++) result.back() += fold(name[i]);
+            pos = end;
+        }
+    }
+    
+    static uint64_t prefixKey(const string& word) {
+        uint64_t key = 0;
+        for (size_t i = 0; i < 8; i++) {
+            key = (key << 8) | (i < word.size() ? static_cast<uint8_t>(word[i]) : 0);
+        }
+        return key;
+    }
+    
+    // The distinct trigrams of a folded word
+    static vector<int> trigramsOf(const string& word) {
+        vector<int> trigrams;
+        int previous = 0, current = symbol(word[0]);
+        for (size_t i = 1; i <= word.size(); i++) {
+            int next = i < word.size() ? symbol(word[i]) : 0;
+            trigrams.push_back((previous * SYMBOLS + current) * SYMBOLS + next);
+            previous = current;
+            current = next;
+        }
+        sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        return trigrams;
+    }
+    
+    // Edits allowed for a query word of this length
+    static int allowedEdits(size_t length) {
+        return length <= 3 ? 0 : length <= 7 ? 1 : 2;
+    }
+    
+    // Levenshtein distance, or limit + 1 once it must exceed limit
+    static int editDistance(const string& a, const string& b, int limit) {
+        int lengthA = static_cast<int>(a.size()), lengthB = static_cast<int>(b.size());
+        if (abs(lengthA - lengthB) > limit) return limit + 1;
+        // Two rows on the stack for the usual short words
+        int small[2][64];
+        vector<int> large;
+        int* row = small[0];
+        int* next = small[1];
+        if (lengthB >= 64) {
+            large.resize(2 * (lengthB + 1));
+            row = large.data();
+            next = row + lengthB + 1;
+        }
+        for (int j = 0; j <= lengthB; j++) row[j] = j;
+        for (int i = 1; i <= lengthA; i++) {
+            next[0] = i;
+            int best = i;
+            for (int j = 1; j <= lengthB; j++) {
+                next[j] = min({row[j] + 1, next[j - 1] + 1, row[j - 1] + (a[i - 1] != b[j - 1])});
+                best = min(best, next[j]);
+            }
+            if (best > limit) return limit + 1;
+            swap(row, next);
+        }
+        return min(row[lengthB], limit + 1);
+    }
+    
+    // Whether slot's name has a match for every query word; distance gets
+    // the edits used
+    bool matches(int slot, const vector<string>& query, bool fuzzy, int& distance) const {
+        vector<string> name;
+        foldedWords(store->name(slot), name);
+        distance = 0;
+        for (const string& wanted : query) {
+            int limit = fuzzy ? allowedEdits(wanted.size()) : 0;
+            int best = limit + 1;
+            for (const string& word : name) {
+                if (!fuzzy) {
+                    if (word.compare(0, wanted.size(), wanted) == 0) best = 0;
+                } else {
+                    best = min(best, editDistance(wanted, word, limit));
+                }
+                if (best == 0) break;
+            }
+            if (best > limit) return false;
+            distance += best;
+        }
+        return true;
+    }
+    
+    static size_t longestWord(const vector<string>& query) {
+        size_t longest = 0;
+        for (size_t i = 1; i < query.size(); i++) {
+            if (query[i].size() > query[longest].size()) longest = i;
+        }
+        return longest;
+    }
+    
+    // Call visit(slot) for each word starting with the first eight bytes
+    // of prefix, until visit returns false
+    template <typename Visitor>
+    void forEachWordStarting(const string& prefix, Visitor visit) const {
+        size_t keyBytes = min<size_t>(prefix.size(), 8);
+        uint64_t key = prefixKey(prefix);
+        uint64_t mask = keyBytes == 8 ? ~uint64_t(0) : ~(~uint64_t(0) >> (8 * keyBytes));
+        words.forEachFrom({key, 0, 0}, [&](const WordEntry& entry) {
+            return (entry.prefix & mask) == key && visit(entry.slot);
+        });
+    }
+    
+    void addWord(int slot, const string& word) {
+        unordered_map<string, int>::iterator found = wordIds.find(word);
+        int id;
+        if (found != wordIds.end()) {
+            id = found->second;
+        } else {
+            if (!freeWordIds.empty()) {
+                id = freeWordIds.back();
+                freeWordIds.pop_back();
+                vocabulary[id] = word;
+            } else {
+                id = static_cast<int>(vocabulary.size());
+                vocabulary.push_back(word);
+                slotsWithWord.emplace_back();
+            }
+            wordIds.emplace(word, id);
+            for (int trigram : trigramsOf(word)) postings[trigram].push_back(id);
+        }
+        slotsWithWord[id].push_back(slot);
+    }
+    
+    void removeWord(int slot, const string& word) {
+        unordered_map<string, int>::iterator found = wordIds.find(word);
+        if (found == wordIds.end()) return;
+        int id = found->second;
+        removeOne(slotsWithWord[id], slot);
+        if (!slotsWithWord[id].empty()) return;
+        for (int trigram : trigramsOf(word)) removeOne(postings[trigram], id);
+        wordIds.erase(found);
+        vocabulary[id].clear();
+        freeWordIds.push_back(id);
+    }
+    
+    static void removeOne(vector<int>& list, int value) {
+        vector<int>::iterator it = find(list.begin(), list.end(), value);
+        if (it == list.end()) return;
+        *it = list.back();
+        list.pop_back();
+    }
+    
+public:
+    explicit NameSearchIndex(const StudentStore* studentStore)
+        : store(studentStore), words(WordOrder()), built(false) {}
+    
+    bool ready() const { return built; }
+    
+    void invalidate() {
+        words.invalidate();
+        vocabulary.clear();
+        slotsWithWord.clear();
+        wordIds.clear();
+        freeWordIds.clear();
+        postings.clear();
+        built = false;
+    }
+    
+    void build() {
+        invalidate();
+        vector<WordEntry> entries;
+        vector<string> name;
+        postings.resize(SYMBOLS * SYMBOLS * SYMBOLS);
+        for (int i = 0; i < store->slotLimit(); i++) {
+            if (!store->isLive(i)) continue;
+            foldedWords(store->name(i), name);
+            for (size_t w = 0; w < name.size(); w++) {
+                entries.push_back({prefixKey(name[w]), i, static_cast<int>(w)});
+                addWord(i, name[w]);
+            }
+        }
+        sort(entries.begin(), entries.end(), WordOrder());
+        words.assign(entries);
+        built = true;
+    }
+    
+    void insert(int slot) {
+        vector<string> name;
+        foldedWords(store->name(slot), name);
+        for (size_t w = 0; w < name.size(); w++) {
+            words.insert({prefixKey(name[w]), slot, static_cast<int>(w)});
+            addWord(slot, name[w]);
+        }
+    }
+    
+    void erase(int slot) {
+        vector<string> name;
+        foldedWords(store->name(slot), name);
+        for (size_t w = 0; w < name.size(); w++) {
+            words.erase({prefixKey(name[w]), slot, static_cast<int>(w)});
+            removeWord(slot, name[w]);
+        }
+    }
+    
+    // Up to limit students having a word starting with each query word, in
+    // order of the matching word
+    vector<Match> prefixSearch(string_view text, size_t limit) const {
+        vector<Match> found;
+        vector<string> query;
+        foldedWords(text, query);
+        if (query.empty()) return found;
+        forEachWordStarting(query[longestWord(query)], [&](int slot) {
+            int distance;
+            bool seen = false;
+            for (const Match& match : found) seen = seen || match.slot == slot;
+            if (!seen && matches(slot, query, false, distance)) found.push_back({slot, 0});
+            return found.size() < limit;
+        });
+        return found;
+    }
+    
+    // Up to limit students whose words are each within a few edits of a
+    // query word (none for words of up to 3 letters, 1 up to 7, else 2),
+    // closest first. For one word the answer is read off the closest
+    // vocabulary words in turn, so the cost follows the limit, not the
+    // number of students sharing a common word.
+    vector<Match> fuzzySearch(string_view text, size_t limit) const {
+        vector<Match> found;
+        vector<string> query;
+        foldedWords(text, query);
+        if (query.empty()) return found;
+        const string& anchor = query[longestWord(query)];
+        int allowed = allowedEdits(anchor.size());
+        
+        // Vocabulary words close to the anchor, as (distance, id)
+        vector<pair<int, int>> close;
+        if (allowed == 0) {
+            unordered_map<string, int>::const_iterator exact = wordIds.find(anchor);
+            if (exact != wordIds.end()) close.push_back({0, exact->second});
+        } else {
+            // A word with repeated trigrams may have too few to filter on;
+            // then any shared trigram makes a candidate
+            vector<int> trigrams = trigramsOf(anchor);
+            int needed = max(1, static_cast<int>(trigrams.size()) - 3 * allowed);
+            hits.resize(vocabulary.size(), 0);
+            vector<int> candidates;
+            for (int trigram : trigrams) {
+                for (int id : postings[trigram]) {
+                    if (++hits[id] == needed) candidates.push_back(id);
+                }
+            }
+            for (int trigram : trigrams) {
+                for (int id : postings[trigram]) hits[id] = 0;
+            }
+            for (int id : candidates) {
+                int distance = editDistance(anchor, vocabulary[id], allowed);
+                if (distance <= allowed) close.push_back({distance, id});
+            }
+        }
+        sort(close.begin(), close.end(), [&](const pair<int, int>& a, const pair<int, int>& b) {
+            return a.first != b.first ? a.first < b.first : vocabulary[a.second] < vocabulary[b.second];
+        });
+        
+        if (query.size() == 1) {
+            for (const pair<int, int>& word : close) {
+                for (int slot : slotsWithWord[word.second]) {
+                    bool seen = false;
+                    for (const Match& match : found) seen = seen || match.slot == slot;
+                    if (seen) continue;
+                    found.push_back({slot, word.first});
+                    if (found.size() >= limit) return found;
+                }
+            }
+            return found;
+        }
+        
+        vector<int> slots;
+        for (const pair<int, int>& word : close) {
+            slots.insert(slots.end(), slotsWithWord[word.second].begin(), slotsWithWord[word.second].end());
+        }
+        sort(slots.begin(), slots.end());
+        slots.erase(unique(slots.begin(), slots.end()), slots.end());
+        for (int slot : slots) {
+            int distance;
+            if (matches(slot, query, true, distance)) found.push_back({slot, distance});
+        }
+        sort(found.begin(), found.end(), [](const Match& a, const Match& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.slot < b.slot;
+        });
+        if (found.size() > limit) found.resize(limit);
+        return found;
+    }
+};
+
+// Write head then body to path and fsync it
+bool writeFileSynced(const string& path, const void* head, size_t headBytes,
+                     const void* body, size_t bodyBytes) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    
+    const void* parts[2] = {head, body};
+    size_t sizes[2] = {headBytes, bodyBytes};
+    for (int part = 0; part < 2; part++) {
+        const char* p = static_cast<const char*>(parts[part]);
+        size_t left = sizes[part];
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                ::close(fd);
+                return false;
+            }
+            p += n;
+            left -= n;
+        }
+    }
+    return fsync(fd) == 0 && ::close(fd) == 0;
+}
+
+// Rename a synced file over path and fsync the directory, so the rename
+// itself survives a crash once this returns true
+bool replaceFile(const string& tempPath, const string& path) {
+    if (rename(tempPath.c_str(), path.c_str()) != 0) return false;
+    
+    size_t slash = path.find_last_of('/');
+    string dir = slash == string::npos ? "." : path.substr(0, slash + 1);
+    int dirFd = ::open(dir.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        fsync(dirFd);
+        ::close(dirFd);
+    }
+    return true;
+}
+
+// Write a file durably: write a temporary file, fsync it, rename it over
+// path and fsync the directory, so readers see either the old or the new
+// contents and the new contents survive a crash once this returns true.
+bool writeFileAtomically(const string& path, const void* head, size_t headBytes,
+                         const void* body, size_t bodyBytes) {
+    string tempPath = path + ".tmp";
+    return writeFileSynced(tempPath, head, headBytes, body, bodyBytes) && replaceFile(tempPath, path);
+}
+
+// Write-ahead journal of roster changes made since the last snapshot.
+// students.dat.journal is a JournalHeader followed by fixed-size
+// JournalRecords. The header names the snapshot the records apply to
+// (its two checksums), so a journal left over from before a compaction is
+// recognized and ignored. Each record carries its own checksum, and replay
+// stops at the first torn or corrupt record.
+// A background save keeps logging while it writes: it marks where it froze
+// the roster with JOURNAL_SNAPSHOT_BEGIN and, before renaming the new
+// snapshot into place, logs JOURNAL_SNAPSHOT_DONE with its fingerprint. A
+// journal whose header names an older snapshot still applies to that new
+// one from the marker on, which covers a crash before the journal is
+// rewritten for it.
+enum JournalOp : uint8_t {
+    JOURNAL_ADD = 1,        // rollNumber, name
+    JOURNAL_MARK,           // rollNumber, day, value = present
+    JOURNAL_NAME,           // rollNumber, name
+    JOURNAL_ROLL,           // rollNumber -> argument
+    JOURNAL_REMARKS,        // rollNumber, value = RemarkCode
+    JOURNAL_DELETE,         // rollNumber
+    JOURNAL_MONTH,          // argument = month, day = days in month, rollNumber = year
+                            // (0 in journals written before years were kept)
+    JOURNAL_TEXT,           // leading bytes of the name of the next record
+    JOURNAL_MARK_DAY,       // day, value = present; every student
+    JOURNAL_COPY_DAY,       // day = target day, argument = source day; every student
+    JOURNAL_SNAPSHOT_BEGIN, // a background save froze the roster here
+    JOURNAL_SNAPSHOT_DONE   // rollNumber, argument = low, high half of the fingerprint
+                            // of the snapshot that save wrote
+};
+
+const char JOURNAL_MAGIC[4] = {'S', 'A', 'M', 'J'};
+const uint16_t JOURNAL_VERSION = 1;
+const int JOURNAL_TEXT_BYTES = 16;
+const int JOURNAL_SYNC_RECORDS = 64;          // fsync at least every 64 records...
+const int JOURNAL_SYNC_INTERVAL_MS = 200;     // ...or every 200 ms
+const size_t JOURNAL_COMPACT_RECORDS = 100000; // fold into the snapshot after this many
+const size_t JOURNAL_POLL_RECORDS = 4096;       // check on a running fold after this many more
+
+struct JournalHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t recordSize;
+    uint64_t baseSnapshot;
+    uint32_t reserved[3];
+    uint32_t headerChecksum;
+};
+static_assert(sizeof(JournalHeader) == 32, "JournalHeader must not contain padding");
+
+struct JournalRecord {
+    uint8_t op;
+    uint8_t day;
+    uint8_t value;
+    uint8_t length;         // bytes used in text
+    int32_t rollNumber;
+    int32_t argument;
+    char text[JOURNAL_TEXT_BYTES];
+    uint32_t checksum;      // CRC-32C of the bytes before it
+};
+static_assert(sizeof(JournalRecord) == 32, "JournalRecord must not contain padding");
+
+class AttendanceJournal {
+private:
+    int fd;
+    string path;
+    vector<JournalRecord> pending;      // appended but not yet written
+    size_t recordCount;                 // records in the file, including pending
+    int unsyncedRecords;
+    chrono::steady_clock::time_point lastSync;
+    
+    AttendanceJournal(const AttendanceJournal&) = delete;
+    AttendanceJournal& operator=(const AttendanceJournal&) = delete;
+    
+    static JournalHeader makeHeader(uint64_t baseSnapshot) {
+        JournalHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+        header.version = littleEndian(JOURNAL_VERSION);
+        header.recordSize = littleEndian<uint16_t>(sizeof(JournalRecord));
+        header.baseSnapshot = littleEndian(baseSnapshot);
+        header.headerChecksum = littleEndian(crc32c(0, &header, sizeof(header) - sizeof(uint32_t)));
+        return header;
+    }
+    
+    static bool writeAll(int fd, const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t n = ::write(fd, p, bytes);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= n;
+        }
+        return true;
+    }
+    
+    static JournalRecord makeRecord(uint8_t op, int rollNumber, int argument, uint8_t day,
+                                    uint8_t value, const char* text, size_t length) {
+        JournalRecord record;
+        memset(&record, 0, sizeof(record));
+        record.op = op;
+        record.day = day;
+        record.value = value;
+        record.length = static_cast<uint8_t>(length);
+        record.rollNumber = littleEndian<int32_t>(rollNumber);
+        record.argument = littleEndian<int32_t>(argument);
+        if (length > 0) memcpy(record.text, text, length);
+        record.checksum = littleEndian(crc32c(0, &record, sizeof(record) - sizeof(uint32_t)));
+        return record;
+    }
+    
+    void append(uint8_t op, int rollNumber, int argument = 0, uint8_t day = 0,
+                uint8_t value = 0, const char* text = nullptr, size_t length = 0) {
+        pending.push_back(makeRecord(op, rollNumber, argument, day, value, text, length));
+        recordCount++;
+    }
+    
+    // Names longer than one record are carried by leading JOURNAL_TEXT records
+    void appendWithName(uint8_t op, int rollNumber, const string& name) {
+        size_t offset = 0;
+        while (name.size() - offset > static_cast<size_t>(JOURNAL_TEXT_BYTES)) {
+            append(JOURNAL_TEXT, rollNumber, 0, 0, 0, name.data() + offset, JOURNAL_TEXT_BYTES);
+            offset += JOURNAL_TEXT_BYTES;
+        }
+        append(op, rollNumber, 0, 0, 0, name.data() + offset, name.size() - offset);
+    }
+    
+public:
+    AttendanceJournal() : fd(-1), recordCount(0), unsyncedRecords(0) {}
+    ~AttendanceJournal() { close(); }
+    
+    bool isOpen() const { return fd >= 0; }
+    size_t size() const { return recordCount; }
+    
+    static bool isMarker(uint8_t op) {
+        return op == JOURNAL_SNAPSHOT_BEGIN || op == JOURNAL_SNAPSHOT_DONE;
+    }
+    
+    static uint64_t markedSnapshot(const JournalRecord& record) {
+        return uint32_t(record.rollNumber) | uint64_t(uint32_t(record.argument)) << 32;
+    }
+    
+    // Pass each good record of file, from just after the header, to visit
+    // with its index and the full name it carries, until the first torn or
+    // corrupt one. Returns the number of records up to the last complete
+    // operation.
+    static size_t readRecords(ifstream& file,
+                              const function<void(size_t, const JournalRecord&, const string&)>& visit) {
+        file.clear();
+        file.seekg(sizeof(JournalHeader));
+        size_t index = 0;
+        size_t validRecords = 0;
+        string name;
+        vector<JournalRecord> batch(4096);
+        while (file) {
+            file.read(reinterpret_cast<char*>(batch.data()), batch.size() * sizeof(JournalRecord));
+            size_t count = file.gcount() / sizeof(JournalRecord);
+            for (size_t i = 0; i < count; i++, index++) {
+                JournalRecord& record = batch[i];
+                uint32_t checksum = crc32c(0, &record, sizeof(record) - sizeof(uint32_t));
+                if (littleEndian(record.checksum) != checksum ||
+                    record.length > JOURNAL_TEXT_BYTES) {
+                    return validRecords;
+                }
+                record.rollNumber = littleEndian(record.rollNumber);
+                record.argument = littleEndian(record.argument);
+                name.append(record.text, record.length);
+                if (record.op != JOURNAL_TEXT) {
+                    visit(index, record, name);
+                    name.clear();
+                    validRecords = index + 1;
+                }
+            }
+        }
+        return validRecords;
+    }
+    
+    // Read the journal at journalPath and pass each operation, with the
+    // full name it carries, to apply. Returns false if there is no journal
+    // for baseSnapshot. validRecords receives the number of records up to
+    // the last complete operation; anything after it is a torn tail.
+    // firstRecord receives the index of the first record that applies: 0,
+    // unless the journal was written for an older snapshot and carries on
+    // from a background save of baseSnapshot.
+    static bool replay(const string& journalPath, uint64_t baseSnapshot,
+                       const function<void(const JournalRecord&, const string&)>& apply,
+                       size_t& validRecords, size_t& firstRecord) {
+        validRecords = 0;
+        firstRecord = 0;
+        ifstream file(journalPath, std::ios::binary);
+        if (!file) return false;
+        
+        JournalHeader header;
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+        JournalHeader expected = makeHeader(baseSnapshot);
+        if (memcmp(&header, &expected, sizeof(header)) != 0) {
+            JournalHeader older = makeHeader(littleEndian(header.baseSnapshot));
+            if (memcmp(&header, &older, sizeof(header)) != 0) return false;
+            bool found = false;
+            size_t begin = 0;
+            readRecords(file, [&](size_t index, const JournalRecord& record, const string&) {
+                if (record.op == JOURNAL_SNAPSHOT_BEGIN) begin = index + 1;
+                if (record.op == JOURNAL_SNAPSHOT_DONE && markedSnapshot(record) == baseSnapshot) {
+                    found = true;
+                    firstRecord = begin;
+                }
+            });
+            if (!found) return false;
+        }
+        
+        validRecords = readRecords(file, [&](size_t index, const JournalRecord& record, const string& name) {
+            if (index >= firstRecord && !isMarker(record.op)) apply(record, name);
+        });
+        return true;
+    }
+    
+    // Start a new, empty journal for baseSnapshot, replacing any old one
+    bool reset(const string& journalPath, uint64_t baseSnapshot) {
+        close();
+        JournalHeader header = makeHeader(baseSnapshot);
+        if (!writeFileAtomically(journalPath, &header, sizeof(header), nullptr, 0)) return false;
+        return openForAppend(journalPath, 0);
+    }
+    
+    // Continue appending to an existing journal holding validRecords good
+    // records; anything after them (a torn tail) is cut off
+    bool openForAppend(const string& journalPath, size_t validRecords) {
+        close();
+        fd = ::open(journalPath.c_str(), O_RDWR);
+        if (fd < 0) return false;
+        off_t end = sizeof(JournalHeader) + validRecords * sizeof(JournalRecord);
+        if (ftruncate(fd, end) != 0 || lseek(fd, end, SEEK_SET) != end) {
+            close();
+            return false;
+        }
+        path = journalPath;
+        recordCount = validRecords;
+        unsyncedRecords = 0;
+        lastSync = chrono::steady_clock::now();
+        return true;
+    }
+    
+    void logAdd(int rollNumber, const string& name) { appendWithName(JOURNAL_ADD, rollNumber, name); }
+    void logName(int rollNumber, const string& name) { appendWithName(JOURNAL_NAME, rollNumber, name); }
+    void logMark(int rollNumber, int day, bool present) {
+        append(JOURNAL_MARK, rollNumber, 0, static_cast<uint8_t>(day), present ? 1 : 0);
+    }
+    
+    // A mark record built on the marking thread, to be logged later with
+    // logRecords() in the order it was made
+    static JournalRecord markRecord(int rollNumber, int day, bool present) {
+        return makeRecord(JOURNAL_MARK, rollNumber, 0, static_cast<uint8_t>(day), present ? 1 : 0,
+                          nullptr, 0);
+    }
+    void logRecords(const vector<JournalRecord>& records) {
+        pending.insert(pending.end(), records.begin(), records.end());
+        recordCount += records.size();
+    }
+    void logRollNumber(int rollNumber, int newRollNumber) {
+        append(JOURNAL_ROLL, rollNumber, newRollNumber);
+    }
+    void logRemarks(int rollNumber, uint8_t code) { append(JOURNAL_REMARKS, rollNumber, 0, 0, code); }
+    void logDelete(int rollNumber) { append(JOURNAL_DELETE, rollNumber); }
+    void logMarkDay(int day, bool present) {
+        append(JOURNAL_MARK_DAY, 0, 0, static_cast<uint8_t>(day), present ? 1 : 0);
+    }
+    void logCopyDay(int fromDay, int toDay) {
+        append(JOURNAL_COPY_DAY, 0, fromDay, static_cast<uint8_t>(toDay));
+    }
+    void logMonth(int month, int days, int year) {
+        append(JOURNAL_MONTH, year, month, static_cast<uint8_t>(days));
+    }
+    
+    // Mark where a background save froze the roster; returns the index of
+    // the first record after the mark, for rebase()
+    size_t logSnapshotBegin() {
+        append(JOURNAL_SNAPSHOT_BEGIN, 0);
+        return recordCount;
+    }
+    void logSnapshotDone(uint64_t fingerprint) {
+        append(JOURNAL_SNAPSHOT_DONE, static_cast<int32_t>(fingerprint & 0xffffffff),
+               static_cast<int32_t>(fingerprint >> 32));
+    }
+    
+    // Start the journal over for baseSnapshot, keeping the records from
+    // firstRecord on but not the save markers among them. On failure the
+    // journal is left as it was.
+    bool rebase(uint64_t baseSnapshot, size_t firstRecord) {
+        if (fd < 0 || !sync()) return false;
+        size_t count = recordCount > firstRecord ? recordCount - firstRecord : 0;
+        vector<JournalRecord> kept(count);
+        char* p = reinterpret_cast<char*>(kept.data());
+        size_t left = count * sizeof(JournalRecord);
+        off_t offset = sizeof(JournalHeader) + firstRecord * sizeof(JournalRecord);
+        while (left > 0) {
+            ssize_t n = pread(fd, p, left, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            left -= n;
+            offset += n;
+        }
+        kept.erase(remove_if(kept.begin(), kept.end(),
+                             [](const JournalRecord& record) { return isMarker(record.op); }),
+                   kept.end());
+        
+        JournalHeader header = makeHeader(baseSnapshot);
+        if (!writeFileAtomically(path, &header, sizeof(header),
+                                 kept.data(), kept.size() * sizeof(JournalRecord))) {
+            return false;
+        }
+        string journalPath = path;
+        return openForAppend(journalPath, kept.size());
+    }
+    
+    // Write appended records with one write(). They then survive a crash of
+    // this process; fsync is batched across commits (group commit), so they
+    // survive an OS crash after at most JOURNAL_SYNC_RECORDS records or
+    // JOURNAL_SYNC_INTERVAL_MS, whichever comes first.
+    bool commit() {
+        if (fd < 0 || pending.empty()) return true;
+        bool ok = writeAll(fd, pending.data(), pending.size() * sizeof(JournalRecord));
+        unsyncedRecords += pending.size();
+        pending.clear();
+        
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (unsyncedRecords >= JOURNAL_SYNC_RECORDS ||
+            now - lastSync >= chrono::milliseconds(JOURNAL_SYNC_INTERVAL_MS)) {
+            ok = sync() && ok;
+        }
+        return ok;
+    }
+    
+    // Force everything written so far to stable storage
+    bool sync() {
+        if (fd < 0) return true;
+        bool ok = true;
+        if (!pending.empty()) {
+            ok = writeAll(fd, pending.data(), pending.size() * sizeof(JournalRecord));
+            unsyncedRecords += pending.size();
+            pending.clear();
+        }
+        if (unsyncedRecords > 0) ok = fsync(fd) == 0 && ok;
+        unsyncedRecords = 0;
+        lastSync = chrono::steady_clock::now();
+        return ok;
+    }
+    
+    void close() {
+        if (fd < 0) return;
+        sync();
+        ::close(fd);
+        fd = -1;
+        pending.clear();
+        recordCount = 0;
+    }
+};
+
+// One attendance event from an import file; day is 1-based as in the menu
+struct AttendanceEvent {
+    int32_t rollNumber;
+    int32_t day;
+    int32_t status;         // 1 = present, 0 = absent
+    uint64_t line;          // line (CSV) or record number (binary), for reports
+};
+
+// Outcome of a bulk import. Only the first few rejected rows are kept.
+struct ImportReport {
+    static const size_t MAX_SAMPLES = 10;
+    
+    uint64_t rows = 0;
+    uint64_t applied = 0;
+    uint64_t rejected = 0;
+    vector<string> samples;
+    
+    void reject(uint64_t line, const char* reason) {
+        rejected++;
+        if (samples.size() < MAX_SAMPLES) {
+            samples.push_back("line " + to_string(line) + ": " + reason);
+        }
+    }
+};
+
+// Streams attendance events from a file in fixed-size chunks, so memory
+// use does not depend on the file size. Two formats are accepted:
+//   CSV:    one "rollNumber,day,status" row per line; a first line
+//           with no digits in it is a header and is skipped
+//   Binary: the 8-byte magic "SAMSEVT1" followed by 8-byte records of
+//           int32 rollNumber, uint8 day, uint8 status, uint16 reserved
+//           (little-endian)
+class AttendanceEventReader {
+private:
+    static const size_t CHUNK_BYTES = 1 << 20;
+    
+    int fd;
+    vector<char> buffer;
+    size_t begin;
+    size_t end;
+    bool atEof;
+    bool binary;
+    uint64_t line;
+    
+    AttendanceEventReader(const AttendanceEventReader&) = delete;
+    AttendanceEventReader& operator=(const AttendanceEventReader&) = delete;
+    
+    // Move unread bytes to the front and read more after them
+    bool refill() {
+        if (atEof) return false;
+        if (begin > 0) {
+            memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+        while (end < buffer.size()) {
+            ssize_t n = ::read(fd, buffer.data() + end, buffer.size() - end);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                atEof = true;
+                break;
+            }
+            end += n;
+        }
+        return true;
+    }
+    
+    static const char* parseField(const char* p, const char* last, int32_t& value) {
+        while (p < last && (*p == ' ' || *p == '\t')) p++;
+        from_chars_result result = from_chars(p, last, value);
+        if (result.ec != errc()) return nullptr;
+        p = result.ptr;
+        while (p < last && (*p == ' ' || *p == '\t')) p++;
+        return p;
+    }
+    
+    // Parse one CSV row; returns false if it is malformed
+    static bool parseRow(const char* p, const char* last, AttendanceEvent& event) {
+        if (last > p && last[-1] == '\r') last--;
+        p = parseField(p, last, event.rollNumber);
+        if (!p || p == last || *p++ != ',') return false;
+        p = parseField(p, last, event.day);
+        if (!p || p == last || *p++ != ',') return false;
+        p = parseField(p, last, event.status);
+        return p == last;
+    }
+    
+    static bool isBlank(const char* p, const char* last) {
+        for (; p < last; p++) {
+            if (*p != ' ' && *p != '\t' && *p != '\r') return false;
+        }
+        return true;
+    }
+    
+    static bool hasDigit(const char* p, const char* last) {
+        for (; p < last; p++) {
+            if (*p >= '0' && *p <= '9') return true;
+        }
+        return false;
+    }
+    
+public:
+    AttendanceEventReader() : fd(-1), begin(0), end(0), atEof(false), binary(false), line(0) {}
+    ~AttendanceEventReader() {
+        if (fd >= 0) ::close(fd);
+    }
+    
+    bool open(const string& path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        buffer.resize(CHUNK_BYTES);
+        refill();
+        binary = end - begin >= 8 && memcmp(buffer.data(), "SAMSEVT1", 8) == 0;
+        if (binary) begin += 8;
+        return true;
+    }
+    
+    // Fill batch with up to maxEvents well-formed events. Malformed rows are
+    // counted in report. Returns false once the file is exhausted.
+    bool next(vector<AttendanceEvent>& batch, size_t maxEvents, ImportReport& report) {
+        batch.clear();
+        while (batch.size() < maxEvents) {
+            if (binary) {
+                if (end - begin < 8 && (!refill() || end - begin < 8)) {
+                    if (end > begin) report.reject(line + 1, "truncated record");
+                    begin = end;
+                    break;
+                }
+                const unsigned char* r = reinterpret_cast<const unsigned char*>(buffer.data() + begin);
+                int32_t rollNumber;
+                memcpy(&rollNumber, r, sizeof(rollNumber));
+                batch.push_back(AttendanceEvent{littleEndian(rollNumber), r[4], r[5], ++line});
+                report.rows++;
+                begin += 8;
+                continue;
+            }
+            
+            const char* first = buffer.data() + begin;
+            const char* newline = static_cast<const char*>(memchr(first, '\n', end - begin));
+            if (!newline && !atEof) {
+                if (begin == 0 && end == buffer.size()) {
+                    // A line longer than the buffer: reject and skip it
+                    line++;
+                    report.rows++;
+                    report.reject(line, "line too long");
+                    bool found = false;
+                    while (!found && !atEof) {
+                        begin = end;
+                        refill();
+                        const char* nl = static_cast<const char*>(memchr(buffer.data(), '\n', end));
+                        if (nl) {
+                            begin = nl - buffer.data() + 1;
+                            found = true;
+                        }
+                    }
+                    if (!found) begin = end;
+                    continue;
+                }
+                refill();
+                continue;
+            }
+            if (!newline && begin == end) break;
+            
+            const char* last = newline ? newline : buffer.data() + end;
+            begin = (last - buffer.data()) + (newline ? 1 : 0);
+            line++;
+            if (isBlank(first, last)) continue;
+            
+            AttendanceEvent event;
+            event.line = line;
+            if (parseRow(first, last, event)) {
+                batch.push_back(event);
+                report.rows++;
+            } else if (line > 1 || hasDigit(first, last)) {
+                report.rows++;
+                report.reject(line, "malformed row");
+            }
+            // A first line without digits is taken to be a header
+        }
+        return !batch.empty() || begin < end || !atEof;
+    }
+};
+
+// Built-in instrumentation: call counts, time and a latency histogram for
+// each AttendanceSystem operation, and bytes moved by snapshots. Each
+// thread counts into its own block, so recording is a few uncontended
+// stores; readers sum the blocks. Build with -DSAMS_STATS=0 to compile the
+// instrumentation out, leaving OperationTimer empty.
+enum StatsOperation {
+    STAT_ADD, STAT_MARK, STAT_MARK_DAY, STAT_COPY_DAY, STAT_RENAME, STAT_REROLL, STAT_REMARKS,
+    STAT_DELETE, STAT_LOOKUP, STAT_MONTH, STAT_SORT, STAT_LIST, STAT_THRESHOLD, STAT_DAY,
+    STAT_AVERAGE, STAT_EXTREMES, STAT_HISTORY, STAT_RANGE, STAT_SEARCH, STAT_IMPORT,
+    STAT_JOURNAL, STAT_SAVE, STAT_LOAD, STAT_MAP,
+    STAT_OPERATION_COUNT
+};
+
+const char* statsOperationName(int operation) {
+    static const char* const names[STAT_OPERATION_COUNT] = {
+        "add", "mark", "mark_day", "copy_day", "rename", "reroll", "remarks",
+        "delete", "lookup", "month", "sort", "list", "threshold", "day",
+        "average", "extremes", "history", "range", "search", "import",
+        "journal", "save", "load", "map"
+    };
+    return names[operation];
+}
+
+#if SAMS_STATS
+// Latencies go in power-of-two buckets: bucket b counts calls shorter
+// than 2^(b + 8) ns (256 ns up to about 9 minutes); the last bucket also
+// takes anything longer
+const int STATS_BUCKETS = 32;
+
+inline int statsBucket(uint64_t nanos) {
+    int bits = 64 - __builtin_clzll(nanos | 1);
+    return min(max(bits - 8, 0), STATS_BUCKETS - 1);
+}
+
+inline double statsBucketSeconds(int bucket) {
+    return ldexp(1e-9, bucket + 8);
+}
+
+// Counters summed over every thread
+struct StatsTotals {
+    uint64_t calls[STAT_OPERATION_COUNT];
+    uint64_t nanos[STAT_OPERATION_COUNT];
+    uint64_t buckets[STAT_OPERATION_COUNT][STATS_BUCKETS];
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    
+    // Upper bound of the bucket holding the given fraction of calls
+    double percentileSeconds(int operation, double fraction) const {
+        uint64_t wanted = static_cast<uint64_t>(ceil(fraction * calls[operation]));
+        uint64_t seen = 0;
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            seen += buckets[operation][b];
+            if (seen >= wanted && seen > 0) return statsBucketSeconds(b);
+        }
+        return 0;
+    }
+};
+
+class Stats {
+private:
+    // One thread's counters. Only the owner writes, with relaxed loads and
+    // stores rather than atomic increments; readers may see a count a call
+    // behind, never a torn one.
+    struct Block {
+        atomic<uint64_t> calls[STAT_OPERATION_COUNT];
+        atomic<uint64_t> nanos[STAT_OPERATION_COUNT];
+        atomic<uint64_t> buckets[STAT_OPERATION_COUNT][STATS_BUCKETS];
+        atomic<uint64_t> bytesRead;
+        atomic<uint64_t> bytesWritten;
+        
+        Block() : bytesRead(0), bytesWritten(0) {
+            for (int op = 0; op < STAT_OPERATION_COUNT; op++) {
+                calls[op].store(0, memory_order_relaxed);
+                nanos[op].store(0, memory_order_relaxed);
+                for (int b = 0; b < STATS_BUCKETS; b++) buckets[op][b].store(0, memory_order_relaxed);
+            }
+        }
+        
+        static void bump(atomic<uint64_t>& counter, uint64_t amount) {
+            counter.store(counter.load(memory_order_relaxed) + amount, memory_order_relaxed);
+        }
+        
+        void addTo(StatsTotals& totals) const {
+            for (int op = 0; op < STAT_OPERATION_COUNT; op++) {
+                totals.calls[op] += calls[op].load(memory_order_relaxed);
+                totals.nanos[op] += nanos[op].load(memory_order_relaxed);
+                for (int b = 0; b < STATS_BUCKETS; b++) {
+                    totals.buckets[op][b] += buckets[op][b].load(memory_order_relaxed);
+                }
+            }
+            totals.bytesRead += bytesRead.load(memory_order_relaxed);
+            totals.bytesWritten += bytesWritten.load(memory_order_relaxed);
+        }
+    };
+    
+    // The blocks of running threads, and the sum of those that have exited
+    struct Registry {
+        mutex lock;
+        vector<const Block*> blocks;
+        StatsTotals retired;
+        
+        Registry() : retired() {}
+    };
+    
+    static Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+    
+    struct ThreadBlock {
+        Block block;
+        
+        ThreadBlock() {
+            Registry& shared = registry();
+            lock_guard<mutex> guard(shared.lock);
+            shared.blocks.push_back(&block);
+        }
+        
+        ~ThreadBlock() {
+            Registry& shared = registry();
+            lock_guard<mutex> guard(shared.lock);
+            block.addTo(shared.retired);
+            shared.blocks.erase(find(shared.blocks.begin(), shared.blocks.end(), &block));
+        }
+    };
+    
+    static Block& local() {
+        thread_local ThreadBlock mine;
+        return mine.block;
+    }
+    
+public:
+    static void record(StatsOperation operation, uint64_t nanos) {
+        Block& block = local();
+        Block::bump(block.calls[operation], 1);
+        Block::bump(block.nanos[operation], nanos);
+        Block::bump(block.buckets[operation][statsBucket(nanos)], 1);
+    }
+    
+    static void addBytesRead(uint64_t bytes) { Block::bump(local().bytesRead, bytes); }
+    static void addBytesWritten(uint64_t bytes) { Block::bump(local().bytesWritten, bytes); }
+    
+    static StatsTotals totals() {
+        Registry& shared = registry();
+        lock_guard<mutex> guard(shared.lock);
+        StatsTotals sum = shared.retired;
+        for (const Block* block : shared.blocks) block->addTo(sum);
+        return sum;
+    }
+    
+    // Prometheus text exposition format, ending with "# EOF" so a client
+    // reading a stream knows where it stops
+    static string prometheus() {
+        StatsTotals sum = totals();
+        string text;
+        char line[512];
+        text += "# HELP sams_operation_seconds Latency of AttendanceSystem operations.\n"
+                "# TYPE sams_operation_seconds histogram\n";
+        for (int op = 0; op < STAT_OPERATION_COUNT; op++) {
+            if (sum.calls[op] == 0) continue;
+            uint64_t cumulative = 0;
+            for (int b = 0; b < STATS_BUCKETS - 1; b++) {
+                cumulative += sum.buckets[op][b];
+                snprintf(line, sizeof(line), "sams_operation_seconds_bucket{operation=\"%s\",le=\"%.9g\"} %llu\n",
+                         statsOperationName(op), statsBucketSeconds(b),
+                         static_cast<unsigned long long>(cumulative));
+                text += line;
+            }
+            snprintf(line, sizeof(line),
+                     "sams_operation_seconds_bucket{operation=\"%s\",le=\"+Inf\"} %llu\n"
+                     "sams_operation_seconds_sum{operation=\"%s\"} %.9f\n"
+                     "sams_operation_seconds_count{operation=\"%s\"} %llu\n",
+                     statsOperationName(op), static_cast<unsigned long long>(sum.calls[op]),
+                     statsOperationName(op), sum.nanos[op] / 1e9,
+                     statsOperationName(op), static_cast<unsigned long long>(sum.calls[op]));
+            text += line;
+        }
+        snprintf(line, sizeof(line),
+                 "# HELP sams_snapshot_read_bytes_total Bytes read loading snapshots.\n"
+                 "# TYPE sams_snapshot_read_bytes_total counter\n"
+                 "sams_snapshot_read_bytes_total %llu\n",
+                 static_cast<unsigned long long>(sum.bytesRead));
+        text += line;
+        snprintf(line, sizeof(line),
+                 "# HELP sams_snapshot_written_bytes_total Bytes written saving snapshots.\n"
+                 "# TYPE sams_snapshot_written_bytes_total counter\n"
+                 "sams_snapshot_written_bytes_total %llu\n",
+                 static_cast<unsigned long long>(sum.bytesWritten));
+        text += line;
+        text += "# EOF\n";
+        return text;
+    }
+    
+    // One JSON object; histogram keys are bucket upper bounds in ns
+    static string json() {
+        StatsTotals sum = totals();
+        string text = "{\"ok\":true,\"operations\":[";
+        char field[160];
+        bool first = true;
+        for (int op = 0; op < STAT_OPERATION_COUNT; op++) {
+            if (sum.calls[op] == 0) continue;
+            snprintf(field, sizeof(field),
+                     "%s{\"operation\":\"%s\",\"calls\":%llu,\"seconds\":%.9f,"
+                     "\"p50Micros\":%g,\"p99Micros\":%g,\"histogram\":{",
+                     first ? "" : ",", statsOperationName(op),
+                     static_cast<unsigned long long>(sum.calls[op]), sum.nanos[op] / 1e9,
+                     sum.percentileSeconds(op, 0.5) * 1e6, sum.percentileSeconds(op, 0.99) * 1e6);
+            text += field;
+            first = false;
+            bool firstBucket = true;
+            for (int b = 0; b < STATS_BUCKETS; b++) {
+                if (sum.buckets[op][b] == 0) continue;
+                snprintf(field, sizeof(field), "%s\"%llu\":%llu", firstBucket ? "" : ",",
+                         1ull << (b + 8), static_cast<unsigned long long>(sum.buckets[op][b]));
+                text += field;
+                firstBucket = false;
+            }
+            text += "}}";
+        }
+        snprintf(field, sizeof(field), "],\"bytesRead\":%llu,\"bytesWritten\":%llu}",
+                 static_cast<unsigned long long>(sum.bytesRead),
+                 static_cast<unsigned long long>(sum.bytesWritten));
+        text += field;
+        return text;
+    }
+};
+
+// Times its scope as one call of an operation
+class OperationTimer {
+private:
+    StatsOperation operation;
+    chrono::steady_clock::time_point start;
+    
+public:
+    explicit OperationTimer(StatsOperation timed)
+        : operation(timed), start(chrono::steady_clock::now()) {}
+    ~OperationTimer() {
+        chrono::nanoseconds elapsed = chrono::steady_clock::now() - start;
+        Stats::record(operation, elapsed.count());
+    }
+};
+
+inline void countBytesRead(uint64_t bytes) { Stats::addBytesRead(bytes); }
+inline void countBytesWritten(uint64_t bytes) { Stats::addBytesWritten(bytes); }
+#else
+class OperationTimer {
+public:
+    explicit OperationTimer(StatsOperation) {}
+};
+
+inline void countBytesRead(uint64_t) {}
+inline void countBytesWritten(uint64_t) {}
+#endif
+
+// A page-structured (version 3) students.dat open for checkpoints. The
+// current header and page table are kept in memory along with the file
+// pages they use. A checkpoint is prepared -- changed pages written to
+// unused pages and synced -- then committed by writing the header, so
+// the slow part can run on another thread (see CheckpointWriter). Only
+// one thread may use the file at a time.
+class RosterPageFile {
+private:
+    int fd;
+    PagedRosterHeader header;           // current checkpoint
+    vector<PagedEntry> slotEntries;
+    vector<PagedEntry> textEntries;
+    vector<uint8_t> inUse;              // per file page, by the current checkpoint
+    
+    // Made by prepare() and made current by commit()
+    PagedRosterHeader next;
+    vector<PagedEntry> nextSlotEntries;
+    vector<PagedEntry> nextTextEntries;
+    vector<uint8_t> claimed;            // pages written for next
+    uint32_t searchFrom;
+    bool prepared;
+    
+    RosterPageFile(const RosterPageFile&) = delete;
+    RosterPageFile& operator=(const RosterPageFile&) = delete;
+    
+    static bool writeAt(int fd, const void* data, size_t bytes, off_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t n = pwrite(fd, p, bytes, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= n;
+            offset += n;
+        }
+        countBytesWritten(p - static_cast<const char*>(data));
+        return true;
+    }
+    
+    static bool readAt(int fd, void* data, size_t bytes, off_t offset) {
+        char* p = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t n = pread(fd, p, bytes, offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= n;
+            offset += n;
+        }
+        countBytesRead(p - static_cast<char*>(data));
+        return true;
+    }
+    
+    static uint32_t pagesFor(size_t bytes) {
+        return static_cast<uint32_t>(max<size_t>(1, (bytes + PAGED_PAGE_BYTES - 1) / PAGED_PAGE_BYTES));
+    }
+    
+    static uint32_t tablePagesFor(size_t entries) {
+        return static_cast<uint32_t>((entries + PAGED_TABLE_ENTRIES - 1) / PAGED_TABLE_ENTRIES);
+    }
+    
+    static uint32_t headerChecksum(const PagedRosterHeader& h) {
+        return crc32c(0, &h, offsetof(PagedRosterHeader, headerChecksum));
+    }
+    
+    bool isFree(uint32_t page) const {
+        return !(page < inUse.size() && inUse[page]) && !(page < claimed.size() && claimed[page]);
+    }
+    
+    // Pages for count pages of data that the current checkpoint does not
+    // use: a free page where one will do, otherwise new pages at the end
+    uint32_t allocate(uint32_t count) {
+        uint32_t end = static_cast<uint32_t>(max(inUse.size(), claimed.size()));
+        uint32_t first = end;
+        if (count == 1) {
+            while (searchFrom < end && !isFree(searchFrom)) searchFrom++;
+            first = searchFrom;
+        }
+        if (claimed.size() < first + count) claimed.resize(first + count, 0);
+        fill(claimed.begin() + first, claimed.begin() + first + count, 1);
+        return first;
+    }
+    
+    bool writeData(const void* data, size_t bytes, PagedEntry& entry) {
+        entry.pages = pagesFor(bytes);
+        entry.page = allocate(entry.pages);
+        entry.bytes = static_cast<uint32_t>(bytes);
+        entry.checksum = crc32c(0, data, bytes);
+        return writeAt(fd, data, bytes, off_t(entry.page) * PAGED_PAGE_BYTES);
+    }
+    
+    // Write the table pages of entries that changed, reusing the rest
+    bool writeTable(const vector<PagedEntry>& entries, const vector<uint8_t>& changed,
+                    const PagedTableRef* oldRefs, uint32_t oldPages, PagedTableRef* refs) {
+        vector<PagedEntry> page;
+        for (uint32_t k = 0; k < tablePagesFor(entries.size()); k++) {
+            if (k < oldPages && !changed[k]) {
+                refs[k] = oldRefs[k];
+                continue;
+            }
+            size_t first = k * PAGED_TABLE_ENTRIES;
+            size_t count = min(PAGED_TABLE_ENTRIES, entries.size() - first);
+            page.assign(entries.begin() + first, entries.begin() + first + count);
+            for (PagedEntry& e : page) {
+                e = PagedEntry{littleEndian(e.page), littleEndian(e.pages),
+                               littleEndian(e.bytes), littleEndian(e.checksum)};
+            }
+            PagedEntry entry;
+            if (!writeData(page.data(), count * sizeof(PagedEntry), entry)) return false;
+            refs[k] = PagedTableRef{littleEndian(entry.page), littleEndian(entry.checksum)};
+        }
+        return true;
+    }
+    
+    bool readTable(const PagedTableRef* refs, uint32_t pages, size_t count, vector<PagedEntry>& entries) {
+        entries.resize(count);
+        for (uint32_t k = 0; k < pages; k++) {
+            size_t first = k * PAGED_TABLE_ENTRIES;
+            size_t n = min(PAGED_TABLE_ENTRIES, count - first);
+            uint32_t page = littleEndian(refs[k].page);
+            if (page == 0 || page >= inUse.size()) return false;
+            if (!readAt(fd, &entries[first], n * sizeof(PagedEntry), off_t(page) * PAGED_PAGE_BYTES)) return false;
+            if (crc32c(0, &entries[first], n * sizeof(PagedEntry)) != littleEndian(refs[k].checksum)) return false;
+            inUse[page] = 1;
+        }
+        for (PagedEntry& e : entries) {
+            e = PagedEntry{littleEndian(e.page), littleEndian(e.pages),
+                           littleEndian(e.bytes), littleEndian(e.checksum)};
+            if (e.page == 0 || e.pages == 0 || uint64_t(e.page) + e.pages > inUse.size() ||
+                e.bytes > uint64_t(e.pages) * PAGED_PAGE_BYTES) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    void markUsed(const vector<PagedEntry>& entries) {
+        for (const PagedEntry& e : entries) {
+            if (inUse.size() < e.page + e.pages) inUse.resize(e.page + e.pages, 0);
+            fill(inUse.begin() + e.page, inUse.begin() + e.page + e.pages, 1);
+        }
+    }
+    
+    static bool validHeader(const PagedRosterHeader& h) {
+        if (memcmp(h.magic, ROSTER_MAGIC, sizeof(h.magic)) != 0 ||
+            littleEndian(h.version) != PAGED_ROSTER_VERSION ||
+            littleEndian(h.headerSize) != PAGED_HEADER_BYTES ||
+            littleEndian(h.headerChecksum) != headerChecksum(h) || littleEndian(h.generation) == 0) {
+            return false;
+        }
+        int32_t month = littleEndian(h.currentMonth);
+        int32_t days = littleEndian(h.daysInMonth);
+        uint32_t slotCount = littleEndian(h.slotCount);
+        uint32_t slotPages = littleEndian(h.slotPages);
+        uint32_t slotTables = littleEndian(h.slotTablePages);
+        uint32_t textTables = littleEndian(h.textTablePages);
+        return month >= 1 && month <= 12 && days >= 1 && days <= MAX_DAYS &&
+               slotCount <= uint32_t(INT32_MAX) &&
+               slotPages == (uint64_t(slotCount) + PAGED_PAGE_SLOTS - 1) / PAGED_PAGE_SLOTS &&
+               slotTables == tablePagesFor(slotPages) &&
+               textTables == tablePagesFor(littleEndian(h.textBlocks)) &&
+               uint64_t(slotTables) + textTables <= uint64_t(PAGED_TABLE_REFS) &&
+               littleEndian(h.textPosition) <= PAGED_PAGE_BYTES;
+    }
+    
+public:
+    RosterPageFile() : fd(-1), header(), next(), searchFrom(1), prepared(false) {}
+    ~RosterPageFile() { close(); }
+    
+    // Whether the file at path is a paged students.dat; either header
+    // copy may be the one that was written last
+    static bool recognizes(const string& path) {
+        ifstream file(path, std::ios::binary);
+        for (int copy = 0; copy < 2; copy++) {
+            char head[8];
+            file.seekg(copy * PAGED_HEADER_BYTES);
+            if (!file.read(head, sizeof(head))) return false;
+            uint16_t version;
+            memcpy(&version, head + 4, sizeof(version));
+            if (memcmp(head, ROSTER_MAGIC, sizeof(ROSTER_MAGIC)) == 0 &&
+                littleEndian(version) == PAGED_ROSTER_VERSION) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Open an existing paged file at its newest intact checkpoint
+    bool open(const string& path, string& error) {
+        close();
+        fd = ::open(path.c_str(), O_RDWR);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            error = "No saved data found or error opening file.";
+            return false;
+        }
+        PagedRosterHeader copies[2];
+        if (!readAt(fd, copies, sizeof(copies), 0)) {
+            error = "Saved data is truncated.";
+            return false;
+        }
+        bool valid[2] = {validHeader(copies[0]), validHeader(copies[1])};
+        if (!valid[0] && !valid[1]) {
+            error = "Saved data is corrupt (header checksum mismatch).";
+            return false;
+        }
+        int newest = !valid[0] || (valid[1] && littleEndian(copies[1].generation) >
+                                               littleEndian(copies[0].generation));
+        header = copies[newest];
+        
+        inUse.assign((info.st_size + PAGED_PAGE_BYTES - 1) / PAGED_PAGE_BYTES, 0);
+        inUse[0] = 1;
+        uint32_t slotTables = littleEndian(header.slotTablePages);
+        if (!readTable(header.tables, slotTables, littleEndian(header.slotPages), slotEntries) ||
+            !readTable(header.tables + slotTables, littleEndian(header.textTablePages),
+                       littleEndian(header.textBlocks), textEntries)) {
+            error = "Saved data is corrupt (bad page table).";
+            return false;
+        }
+        for (const PagedEntry& e : slotEntries) {
+            if (e.bytes != PAGED_SLOT_PAGE_BYTES) {
+                error = "Saved data is corrupt (bad page table).";
+                return false;
+            }
+        }
+        markUsed(slotEntries);
+        markUsed(textEntries);
+        return true;
+    }
+    
+    // Start an empty paged file at path, replacing anything there
+    bool create(const string& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        memset(&header, 0, sizeof(header));
+        slotEntries.clear();
+        textEntries.clear();
+        inUse.assign(1, 1);
+        return fd >= 0;
+    }
+    
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        prepared = false;
+    }
+    
+    int month() const { return littleEndian(header.currentMonth); }
+    int daysInMonth() const { return littleEndian(header.daysInMonth); }
+    int year() const { return littleEndian(header.currentYear); }
+    int slotCount() const { return static_cast<int>(littleEndian(header.slotCount)); }
+    int slotPages() const { return static_cast<int>(slotEntries.size()); }
+    size_t textBlocks() const { return textEntries.size(); }
+    uint32_t textPosition() const { return littleEndian(header.textPosition); }
+    uint64_t textBytes() const { return littleEndian(header.textBytes); }
+    const vector<PagedEntry>& slotPageEntries() const { return slotEntries; }
+    const vector<PagedEntry>& textBlockEntries() const { return textEntries; }
+    uint64_t fingerprint() const { return pagedFingerprint(header); }
+    uint64_t preparedFingerprint() const { return pagedFingerprint(next); }
+    
+    // Read a page or block of the current checkpoint into buffer,
+    // checking its checksum
+    bool readSlotPage(int page, vector<char>& buffer) {
+        return readEntry(slotEntries[page], buffer);
+    }
+    bool readTextBlock(size_t block, vector<char>& buffer) {
+        return readEntry(textEntries[block], buffer);
+    }
+    bool readEntry(const PagedEntry& entry, vector<char>& buffer) {
+        buffer.resize(entry.bytes);
+        return readAt(fd, buffer.data(), entry.bytes, off_t(entry.page) * PAGED_PAGE_BYTES) &&
+               crc32c(0, buffer.data(), entry.bytes) == entry.checksum;
+    }
+    
+    // Write the slot pages listed in pages and the text blocks from
+    // textFrom on, from roster, to pages the current checkpoint does not
+    // use, with the table pages that changed, and sync them. Nothing is
+    // current until commit().
+    bool prepare(const StudentStore& roster, const vector<int>& pages, size_t textFrom,
+                 int month, int days, int year) {
+        prepared = false;
+        claimed.clear();
+        searchFrom = 1;
+        nextSlotEntries = slotEntries;
+        nextTextEntries = textEntries;
+        
+        int slotPageCount = roster.slotPageCount();
+        nextSlotEntries.resize(slotPageCount, PagedEntry());
+        vector<uint8_t> slotTableChanged(tablePagesFor(slotPageCount), 0);
+        vector<char> buffer(PAGED_SLOT_PAGE_BYTES);
+        for (int page : pages) {
+            roster.encodeSlotPage(page, buffer.data());
+            if (!writeData(buffer.data(), buffer.size(), nextSlotEntries[page])) return false;
+            slotTableChanged[page / PAGED_TABLE_ENTRIES] = 1;
+        }
+        
+        const TextArena& text = roster.textArena();
+        nextTextEntries.resize(text.blockCount(), PagedEntry());
+        vector<uint8_t> textTableChanged(tablePagesFor(text.blockCount()), 0);
+        for (size_t block = textFrom; block < text.blockCount(); block++) {
+            string_view data = text.block(block);
+            if (!writeData(data.data(), data.size(), nextTextEntries[block])) return false;
+            textTableChanged[block / PAGED_TABLE_ENTRIES] = 1;
+        }
+        // A table that shrank changes in its last page
+        if (!slotTableChanged.empty() && nextSlotEntries.size() != slotEntries.size()) {
+            slotTableChanged.back() = 1;
+        }
+        if (!textTableChanged.empty() && nextTextEntries.size() != textEntries.size()) {
+            textTableChanged.back() = 1;
+        }
+        
+        uint32_t slotTables = tablePagesFor(nextSlotEntries.size());
+        uint32_t textTables = tablePagesFor(nextTextEntries.size());
+        if (slotTables + textTables > uint32_t(PAGED_TABLE_REFS)) return false;
+        memset(&next, 0, sizeof(next));
+        uint32_t oldSlotTables = littleEndian(header.slotTablePages);
+        if (!writeTable(nextSlotEntries, slotTableChanged, header.tables, oldSlotTables, next.tables) ||
+            !writeTable(nextTextEntries, textTableChanged, header.tables + oldSlotTables,
+                        littleEndian(header.textTablePages), next.tables + slotTables)) {
+            return false;
+        }
+        if (fsync(fd) != 0) return false;
+        
+        memcpy(next.magic, ROSTER_MAGIC, sizeof(next.magic));
+        next.version = littleEndian(PAGED_ROSTER_VERSION);
+        next.headerSize = littleEndian<uint16_t>(PAGED_HEADER_BYTES);
+        next.generation = littleEndian<uint64_t>(littleEndian(header.generation) + 1);
+        next.textBytes = littleEndian(roster.referencedText());
+        next.currentMonth = littleEndian<int32_t>(month);
+        next.daysInMonth = littleEndian<int32_t>(days);
+        next.currentYear = littleEndian<int32_t>(year);
+        next.slotCount = littleEndian<uint32_t>(roster.slotLimit());
+        next.slotPages = littleEndian<uint32_t>(slotPageCount);
+        next.textBlocks = littleEndian<uint32_t>(text.blockCount());
+        next.textPosition = littleEndian(text.tailPosition());
+        next.slotTablePages = littleEndian(slotTables);
+        next.textTablePages = littleEndian(textTables);
+        next.headerChecksum = littleEndian(headerChecksum(next));
+        prepared = true;
+        return true;
+    }
+    
+    // Make the prepared checkpoint current: overwrite the older header
+    // copy and sync. The pages of the previous checkpoint are then free.
+    bool commit() {
+        if (!prepared) return false;
+        prepared = false;
+        off_t offset = (littleEndian(next.generation) % 2) * PAGED_HEADER_BYTES;
+        if (!writeAt(fd, &next, sizeof(next), offset) || fsync(fd) != 0) return false;
+        header = next;
+        slotEntries.swap(nextSlotEntries);
+        textEntries.swap(nextTextEntries);
+        inUse.assign(1, 1);
+        markUsed(slotEntries);
+        markUsed(textEntries);
+        uint32_t tables = littleEndian(header.slotTablePages) + littleEndian(header.textTablePages);
+        for (uint32_t k = 0; k < tables; k++) {
+            uint32_t page = littleEndian(header.tables[k].page);
+            if (inUse.size() <= page) inUse.resize(page + 1, 0);
+            inUse[page] = 1;
+        }
+        return true;
+    }
+};
+
+// A checkpoint prepared on a background thread from a frozen copy of the
+// roster. The owner commits it once done() -- the one step that holds up
+// the owner -- and must not touch the file before then.
+class CheckpointWriter {
+private:
+    StudentStore roster;
+    RosterPageFile* file;
+    vector<int> pages;
+    size_t textFrom;
+    bool everything;
+    int month;
+    int days;
+    int year;
+    bool written;
+    atomic<bool> finished;
+    thread worker;
+    
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+    
+    void run() {
+        {
+            OperationTimer timer(STAT_SAVE);
+            written = file->prepare(roster, pages, textFrom, month, days, year);
+        }
+        finished.store(true, memory_order_release);
+    }
+    
+public:
+    // frozen comes from StudentStore::frozenCopy() and is destroyed with
+    // this writer, so the writer must be destroyed by whoever is editing
+    // the store at the time (see PagedColumn). pages,
+    // textFrom and all are what the store's markClean() dropped.
+    CheckpointWriter(RosterPageFile* target, StudentStore frozen, vector<int> slotPages,
+                     size_t textStart, bool all, int currentMonth, int daysInMonth, int currentYear)
+        : roster(move(frozen)), file(target), pages(move(slotPages)), textFrom(textStart),
+          everything(all), month(currentMonth), days(daysInMonth), year(currentYear),
+          written(false), finished(false) {
+        worker = thread(&CheckpointWriter::run, this);
+    }
+    
+    ~CheckpointWriter() { wait(); }
+    
+    bool done() const { return finished.load(memory_order_acquire); }
+    
+    // Block until the worker is finished; true if every page is written
+    // and synced
+    bool wait() {
+        if (worker.joinable()) worker.join();
+        return written;
+    }
+    
+    // Hand the changes back to store after a failure
+    void restore(StudentStore& store) const { store.markChanged(pages, textFrom, everything); }
+};
+
+// Lets marks on different students run at once while every other use of
+// the roster has it to itself. A mark holds one of STRIPES stripes picked
+// by its roll number, so marks of one student stay in order; the
+// exclusive side raises a flag that turns new marks away and waits for
+// the stripes entered since the last exclusive hold to empty. A mark
+// writes only its own stripe's cache line, and the shared set of entered
+// stripes once after each exclusive hold, so marks under different
+// stripes hardly contend. Taking either side uncontended is one atomic
+// exchange; waiters spin briefly, then sleep. Exclusive holds nest on the
+// thread holding the lock, and a stripe taken there is a no-op.
+class RosterLock {
+public:
+    static const int STRIPES = 64;
+    
+private:
+    struct alignas(64) Stripe {
+        atomic<bool> held;
+        Stripe() : held(false) {}
+    };
+    
+    atomic<bool> closed;        // an exclusive holder is inside or waiting
+    atomic<uint64_t> used;      // stripes entered since the last exclusive hold
+    uint64_t entered;           // used, as the current exclusive hold found it
+    atomic<thread::id> owner;
+    int depth;                  // holds by owner, which alone uses it
+    Stripe stripes[STRIPES];
+    
+    RosterLock(const RosterLock&) = delete;
+    RosterLock& operator=(const RosterLock&) = delete;
+    
+    static void backOff(int& attempts) {
+        if (++attempts < 64) this_thread::yield();
+        else this_thread::sleep_for(chrono::microseconds(50));
+    }
+    
+public:
+    RosterLock() : closed(false), used(0), entered(0), depth(0) {}
+    
+    static int stripeFor(int rollNumber) {
+        return static_cast<int>((static_cast<uint32_t>(rollNumber) * 0x9E3779B9u) >> 26);
+    }
+    
+    bool heldHere() const { return owner.load(memory_order_relaxed) == this_thread::get_id(); }
+    
+    // Take the whole roster; true for the outermost hold on this thread
+    bool lock() {
+        if (heldHere()) {
+            depth++;
+            return false;
+        }
+        for (int attempts = 0; closed.exchange(true);) backOff(attempts);
+        // A stripe entered after this finds the flag raised and backs off
+        entered = used.load() != 0 ? used.exchange(0) : 0;
+        for (uint64_t bits = entered; bits != 0; bits &= bits - 1) {
+            atomic<bool>& stripe = stripes[__builtin_ctzll(bits)].held;
+            for (int attempts = 0; stripe.load();) backOff(attempts);
+        }
+        owner.store(this_thread::get_id(), memory_order_relaxed);
+        depth = 1;
+        return true;
+    }
+    
+    // Stripes entered between the last exclusive hold and this one, the
+    // only ones that can have left anything behind; for the holder
+    uint64_t enteredStripes() const { return entered; }
+    
+    void unlock() {
+        if (--depth > 0) return;
+        owner.store(thread::id(), memory_order_relaxed);
+        closed.store(false, memory_order_release);
+    }
+    
+    // Take one stripe; false, taking nothing, if this thread holds the
+    // whole roster already
+    bool lockStripe(int index) {
+        if (heldHere()) return false;
+        atomic<bool>& stripe = stripes[index].held;
+        uint64_t bit = uint64_t(1) << index;
+        for (int attempts = 0;; backOff(attempts)) {
+            if ((used.load() & bit) == 0) used.fetch_or(bit);
+            if (stripe.exchange(true)) continue;
+            if (!closed.load()) return true;
+            stripe.store(false, memory_order_release);
+            while (closed.load(memory_order_relaxed)) backOff(attempts);
+        }
+    }
+    
+    void unlockStripe(int index) { stripes[index].held.store(false, memory_order_release); }
+    
+    // lockStripe() for a scope
+    class StripeHold {
+    private:
+        RosterLock& lock;
+        int index;
+        bool taken;
+        
+        StripeHold(const StripeHold&) = delete;
+        StripeHold& operator=(const StripeHold&) = delete;
+        
+    public:
+        StripeHold(RosterLock& owner, int stripe)
+            : lock(owner), index(stripe), taken(owner.lockStripe(stripe)) {}
+        ~StripeHold() {
+            if (taken) lock.unlockStripe(index);
+        }
+        bool held() const { return taken; }
+    };
+};
+
+// What readers on other threads see (see AttendanceSystem::Reader): a copy
+// of the roster made when the last exclusive hold ended, sharing its
+// pages. Marks made since land in the shared attendance pages and in the
+// stripes' tallies, so readers see those as well.
+struct RosterVersion {
+    StudentStore students;
+    RollIndex rollIndex;
+    AttendanceTotals totals;    // without the tallies
+    int month;
+    int year;
+    int daysInMonth;
+};
+
+class AttendanceSystem {
+private:
+    StudentStore students;
+    int currentMonth;
+    int currentYear;
+    int daysInMonth;
+    RollIndex rollIndex;
+    bool rollIndexReady;    // false until first lookup after mapping a file
+    OrderedSlotIndex<NameOrder> nameOrder;
+    OrderedSlotIndex<AttendanceOrder> attendanceOrder;
+    OrderedSlotIndex<RollNumberOrder> rollNumberOrder;
+    NameSearchIndex nameSearch;
+    AttendanceTotals totals;
+    bool totalsReady;       // false until first needed after loading
+    PresentDayBuckets presentDayBuckets;
+    DayColumns dayColumns;
+    string dataFile;
+    AttendanceJournal journal;
+    vector<int> eventSlots;     // scratch space for applyEvents
+    bool quiet;                 // status messages go to stderr (command mode)
+    bool silent;                // status messages are dropped (benchmarks)
+    string statusPrefix;        // names the section in sharded mode
+    bool journalDeferred;       // commits wait for flushJournal() (server mode)
+    bool dataUnreadable;        // the data file exists but could not be read
+    unique_ptr<RosterPageFile> pageFile;        // the data file, once it is paged
+    unique_ptr<RosterPageFile> newPageFile;     // a whole new data file being written
+    unique_ptr<CheckpointWriter> backgroundSave; // checkpoint being written, if any
+    size_t backgroundSaveStart; // first journal record it does not cover
+    size_t journalPollAt;       // journal size at which a mark next takes the roster (see writeJournal)
+    bool concurrent;            // see setConcurrent()
+    
+    // Concurrent use (see markStudent() and Reader). Marks hold one stripe
+    // of rosterLock; anything else holds all of it through Exclusive.
+    RosterLock rosterLock;
+    
+    // What marks made under one stripe have not handed over yet: their
+    // journal records while the journal is deferred, and their net change
+    // to the totals, which is kept out of totals
+    struct alignas(64) MarkStripe {
+        vector<JournalRecord> records;
+        atomic<int64_t> presentDays;
+        atomic<int64_t> presentOnDay[MAX_DAYS];
+        
+        MarkStripe() : presentDays(0) {
+            for (atomic<int64_t>& count : presentOnDay) count.store(0, memory_order_relaxed);
+        }
+    };
+    MarkStripe markStripes[RosterLock::STRIPES];
+    mutex journalLock;          // marks committing the journal themselves
+    
+    // In concurrent mode every exclusive hold ends by publishing a new
+    // RosterVersion for the readers. A replaced version is retired with
+    // the read epoch it was replaced in and freed once no reader that
+    // started by then is left.
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> epoch;     // 0 when free
+        ReaderSlot() : epoch(0) {}
+    };
+    static const int READER_SLOTS = 64;
+    unique_ptr<RosterVersion> view;             // the published version
+    atomic<const RosterVersion*> published;
+    vector<pair<uint64_t, unique_ptr<RosterVersion>>> retired;
+    ReaderSlot readerSlots[READER_SLOTS];
+    atomic<uint64_t> readEpoch;
+    
+    enum StripeMark { STRIPE_MARKED, STRIPE_MARKED_POLL, STRIPE_FAILED, STRIPE_TAKE_ROSTER };
+    
+    // markStudent() for a thread holding only the stripe of rollNumber.
+    // The mark is made in place, the only edit that can be when another
+    // stripe may be marking too; anything else it would need, such as a
+    // roll index to build or an order to keep, sends it to the roster.
+    StripeMark markUnderStripe(int stripeIndex, int rollNumber, int day, int present, string& error) {
+        if (!editable(error)) return STRIPE_FAILED;
+        if (day < 1 || day > daysInMonth) {
+            error = "Invalid day. Please enter a day between 1 and " + to_string(daysInMonth) + ".";
+            return STRIPE_FAILED;
+        }
+        if (present != 0 && present != 1) {
+            error = "Invalid input. Please enter 0 for absent or 1 for present.";
+            return STRIPE_FAILED;
+        }
+        if (!rollIndexReady) return STRIPE_TAKE_ROSTER;
+        int slot = rollIndex.find(rollNumber);
+        if (slot < 0) {
+            error = notFound(rollNumber);
+            return STRIPE_FAILED;
+        }
+        if (!students.markableInPlace(slot) || attendanceOrder.ready() || presentDayBuckets.ready()) {
+            return STRIPE_TAKE_ROSTER;
+        }
+        
+        MarkStripe& stripe = markStripes[stripeIndex];
+        DayMask before = students.markInPlace(slot, day - 1, present == 1);
+        if (((before >> (day - 1)) & 1u) != DayMask(present)) {
+            int64_t change = present == 1 ? 1 : -1;
+            stripe.presentDays.store(stripe.presentDays.load(memory_order_relaxed) + change,
+                                     memory_order_relaxed);
+            atomic<int64_t>& onDay = stripe.presentOnDay[day - 1];
+            onDay.store(onDay.load(memory_order_relaxed) + change, memory_order_relaxed);
+            if (dayColumns.ready()) dayColumns.setAtomically(slot, day - 1, present == 1);
+        }
+        stripe.records.push_back(AttendanceJournal::markRecord(rollNumber, day - 1, present == 1));
+        if (journalDeferred) return STRIPE_MARKED;
+        
+        lock_guard<mutex> hold(journalLock);
+        journal.logRecords(stripe.records);
+        stripe.records.clear();
+        if (!journal.isOpen()) return STRIPE_MARKED;
+        if (!journal.commit()) status("Warning: could not write the attendance journal.");
+        return journal.size() >= journalPollAt ? STRIPE_MARKED_POLL : STRIPE_MARKED;
+    }
+    
+    // Log the marks the stripes in mask kept back and, outside concurrent
+    // mode, where no reader adds them to a published version's totals,
+    // move their changes into totals; under Exclusive
+    void collectMarks(uint64_t mask) {
+        for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+            MarkStripe& stripe = markStripes[__builtin_ctzll(bits)];
+            if (!stripe.records.empty()) {
+                journal.logRecords(stripe.records);
+                stripe.records.clear();
+            }
+            if (concurrent) continue;
+            MarkTally tally;
+            tally.presentDays = stripe.presentDays.load(memory_order_relaxed);
+            stripe.presentDays.store(0, memory_order_relaxed);
+            for (int day = 0; day < MAX_DAYS; day++) {
+                tally.presentOnDay[day] = stripe.presentOnDay[day].load(memory_order_relaxed);
+                stripe.presentOnDay[day].store(0, memory_order_relaxed);
+            }
+            if (totalsReady) totals.addTally(tally, 1);
+        }
+    }
+    
+    // Sum of the stripes' changes to the totals
+    MarkTally markTally() const {
+        MarkTally tally;
+        memset(&tally, 0, sizeof(tally));
+        for (const MarkStripe& stripe : markStripes) {
+            tally.presentDays += stripe.presentDays.load(memory_order_relaxed);
+            for (int day = 0; day < MAX_DAYS; day++) {
+                tally.presentOnDay[day] += stripe.presentOnDay[day].load(memory_order_relaxed);
+            }
+        }
+        return tally;
+    }
+    
+    // One count of markTally() on its own, for readers: the present days,
+    // or with a 0-based day the students present on it
+    int64_t tallied(int day) const {
+        int64_t sum = 0;
+        for (const MarkStripe& stripe : markStripes) {
+            sum += (day < 0 ? stripe.presentDays : stripe.presentOnDay[day]).load(memory_order_relaxed);
+        }
+        return sum;
+    }
+    
+    // Hand readers a copy of the roster as it is now; under Exclusive
+    void publish() {
+        if (!rollIndexReady) rebuildRollIndex();
+        unique_ptr<RosterVersion> next(new RosterVersion{students.frozenCopy(), rollIndex, baseTotals(),
+                                                         currentMonth, currentYear, daysInMonth});
+        published.store(next.get());
+        if (view) retired.emplace_back(readEpoch.fetch_add(1), move(view));
+        view = move(next);
+        
+        uint64_t oldest = UINT64_MAX;
+        for (const ReaderSlot& slot : readerSlots) {
+            uint64_t epoch = slot.epoch.load();
+            if (epoch != 0) oldest = min(oldest, epoch);
+        }
+        retired.erase(remove_if(retired.begin(), retired.end(),
+                                [&](const pair<uint64_t, unique_ptr<RosterVersion>>& version) {
+                                    return version.first < oldest;
+                                }),
+                      retired.end());
+    }
+    
+    // Slot of the student with this roll number, or -1
+    int findStudent(int rollNumber) {
+        if (!rollIndexReady) rebuildRollIndex();
+        return rollIndex.find(rollNumber);
+    }
+    
+    void rebuildRollIndex() {
+        rollIndex.clear();
+        rollIndex.reserve(students.size());
+        for (int i = 0; i < students.slotLimit(); i++) {
+            if (!students.isLive(i)) continue;
+            rollIndex.insert(students.rollNumber(i), i);
+        }
+        rollIndexReady = true;
+    }
+    
+    static bool isValidYear(int year) { return year >= 1970 && year <= 2999; }
+    
+    // A data file that exists but could not be read must be neither
+    // journaled against nor saved over, so edits wait until it is fixed
+    bool editable(string& error) const {
+        if (!dataUnreadable) return true;
+        error = "Saved data could not be read; no changes are accepted until " + dataFile +
+                " is repaired or removed.";
+        return false;
+    }
+    
+    static string notFound(int rollNumber) {
+        return "Student with roll number " + to_string(rollNumber) + " not found.";
+    }
+    
+    bool isValidName(const string& name) {
+        for (char c : name) {
+            if (!isalpha(c) && c != ' ') {
+                return false;
+            }
+        }
+        return !name.empty();
+    }
+    
+    static int thisYear() {
+        time_t now = time(nullptr);
+        struct tm local;
+        localtime_r(&now, &local);
+        return local.tm_year + 1900;
+    }
+    
+    // Build a stale sorted index from a sort of the roster
+    template <typename Order>
+    void buildOrder(OrderedSlotIndex<Order>& index, const vector<SortKey>& keys) {
+        if (!index.ready()) index.assign(RosterSorter(keys).sortedSlots(students, daysInMonth));
+    }
+    
+    // Totals for the current roster but for the marks the stripes have
+    // not folded in; counted on first use after loading and kept current
+    // afterwards
+    const AttendanceTotals& baseTotals() {
+        if (!totalsReady) {
+            totals.reset(daysInMonth);
+            for (int i = 0; i < students.slotLimit(); i++) {
+                if (students.isLive(i)) totals.add(students.attendanceMask(i));
+            }
+            totals.addTally(markTally(), -1);   // counted above already
+            totalsReady = true;
+        }
+        return totals;
+    }
+    
+    // Totals for the current roster
+    AttendanceTotals attendanceTotals() {
+        AttendanceTotals current = baseTotals();
+        if (concurrent) current.addTally(markTally(), 1);
+        return current;
+    }
+    
+    // Students by present days; filled on first use after a load or month
+    // change and kept current afterwards
+    const PresentDayBuckets& buckets() {
+        if (!presentDayBuckets.ready()) {
+            DayMask days = dayMaskFor(daysInMonth);
+            presentDayBuckets.reset(students.slotLimit());
+            for (int i = 0; i < students.slotLimit(); i++) {
+                if (!students.isLive(i)) continue;
+                presentDayBuckets.insert(i, countPresentDays(students.attendanceMask(i) & days));
+            }
+        }
+        return presentDayBuckets;
+    }
+    
+    // Name search; built on first use and kept current afterwards
+    const NameSearchIndex& nameIndex() {
+        if (!nameSearch.ready()) nameSearch.build();
+        return nameSearch;
+    }
+    
+    // Marks by day; built on first use like the buckets
+    const DayColumns& columns() {
+        if (!dayColumns.ready()) {
+            dayColumns.reset(students.slotLimit());
+            for (int i = 0; i < students.slotLimit(); i++) {
+                if (students.isLive(i)) dayColumns.insert(i, students.attendanceMask(i));
+            }
+        }
+        return dayColumns;
+    }
+    
+    // The roster was replaced wholesale
+    void invalidateTotals() {
+        totalsReady = false;
+    }
+    
+    // Slots are about to be renumbered or replaced wholesale
+    void invalidateOrders() {
+        nameOrder.invalidate();
+        attendanceOrder.invalidate();
+        rollNumberOrder.invalidate();
+        nameSearch.invalidate();
+        presentDayBuckets.invalidate();
+        dayColumns.invalidate();
+    }
+    
+    // Core operations. They take no input and print nothing; the menu
+    // handlers and journal replay are built on them. Callers log to the
+    // journal themselves, so replay does not log twice. Every change to a
+    // student's roll number, name or attendance goes through here so the
+    // indices stay current.
+    int insertStudent(int rollNumber, const string& name) {
+        int slot = students.add();
+        students.setRollNumber(slot, rollNumber);
+        students.setName(slot, name);
+        if (rollIndexReady) rollIndex.insert(rollNumber, slot);
+        if (nameOrder.ready()) nameOrder.insert(slot);
+        if (attendanceOrder.ready()) attendanceOrder.insert(slot);
+        if (rollNumberOrder.ready()) rollNumberOrder.insert(slot);
+        if (nameSearch.ready()) nameSearch.insert(slot);
+        if (totalsReady) totals.add(0);
+        if (presentDayBuckets.ready()) presentDayBuckets.insert(slot, 0);
+        if (dayColumns.ready()) dayColumns.insert(slot, 0);
+        return slot;
+    }
+    
+    void removeStudent(int slot) {
+        rollIndex.erase(students.rollNumber(slot));
+        if (nameOrder.ready()) nameOrder.erase(slot);
+        if (attendanceOrder.ready()) attendanceOrder.erase(slot);
+        if (rollNumberOrder.ready()) rollNumberOrder.erase(slot);
+        if (nameSearch.ready()) nameSearch.erase(slot);
+        if (totalsReady) totals.remove(students.attendanceMask(slot));
+        if (presentDayBuckets.ready()) presentDayBuckets.erase(slot);
+        if (dayColumns.ready()) dayColumns.erase(slot);
+        students.remove(slot);
+    }
+    
+    void changeRollNumber(int slot, int newRollNumber) {
+        rollIndex.erase(students.rollNumber(slot));
+        if (rollNumberOrder.ready()) rollNumberOrder.erase(slot);
+        students.setRollNumber(slot, newRollNumber);
+        if (rollIndexReady) rollIndex.insert(newRollNumber, slot);
+        if (rollNumberOrder.ready()) rollNumberOrder.insert(slot);
+    }
+    
+    void changeName(int slot, const string& name) {
+        if (nameOrder.ready()) nameOrder.erase(slot);
+        if (attendanceOrder.ready()) attendanceOrder.erase(slot);
+        if (nameSearch.ready()) nameSearch.erase(slot);
+        students.setName(slot, name);
+        if (nameOrder.ready()) nameOrder.insert(slot);
+        if (attendanceOrder.ready()) attendanceOrder.insert(slot);
+        if (nameSearch.ready()) nameSearch.insert(slot);
+    }
+    
+    // day is 0-based
+    void changeAttendance(int slot, int day, bool present) {
+        DayMask before = students.attendanceMask(slot);
+        if (((before >> day) & 1u) == DayMask(present)) return;
+        if (attendanceOrder.ready()) attendanceOrder.erase(slot);
+        students.setAttendance(slot, day, present);
+        DayMask after = students.attendanceMask(slot);
+        if (totalsReady) totals.change(before, after);
+        if (presentDayBuckets.ready()) {
+            presentDayBuckets.update(slot, countPresentDays(after & dayMaskFor(daysInMonth)));
+        }
+        if (attendanceOrder.ready()) attendanceOrder.insert(slot);
+        if (dayColumns.ready()) dayColumns.set(slot, day, present);
+    }
+    
+    // Set a 0-based day for every student to the matching bit of target,
+    // a column laid out as in DayColumns. The column scan finds the
+    // students whose mark changes; only those are touched.
+    void changeDay(int day, const vector<uint64_t>& target) {
+        const DayColumns& index = columns();
+        const uint64_t* current = index.column(day);
+        size_t changed = 0;
+        for (size_t w = 0; w < index.words(); w++) changed += __builtin_popcountll(current[w] ^ target[w]);
+        
+        // As for imports, a change to much of the roster is cheaper to
+        // follow with a rebuild of the attendance order
+        bool keepOrder = attendanceOrder.ready() && changed <= size_t(students.size() / 64);
+        if (!keepOrder) attendanceOrder.invalidate();
+        DayMask days = dayMaskFor(daysInMonth);
+        for (size_t w = 0; w < index.words(); w++) {
+            for (uint64_t bits = current[w] ^ target[w]; bits != 0; bits &= bits - 1) {
+                int slot = static_cast<int>(w * 64) + __builtin_ctzll(bits);
+                if (keepOrder) attendanceOrder.erase(slot);
+                DayMask before = students.attendanceMask(slot);
+                students.setAttendance(slot, day, (target[w] >> (slot % 64)) & 1);
+                DayMask after = students.attendanceMask(slot);
+                if (totalsReady) totals.change(before, after);
+                if (presentDayBuckets.ready()) {
+                    presentDayBuckets.update(slot, countPresentDays(after & days));
+                }
+                if (keepOrder) attendanceOrder.insert(slot);
+            }
+        }
+        dayColumns.assign(day, target.data());
+    }
+    
+    // Mark every student present or absent on a 0-based day, except the
+    // students in exceptSlots, who get the opposite mark
+    void fillDay(int day, bool present, const vector<int>& exceptSlots) {
+        const DayColumns& index = columns();
+        vector<uint64_t> target(index.words(), 0);
+        if (present) target.assign(index.live(), index.live() + index.words());
+        for (int slot : exceptSlots) target[slot / 64] ^= uint64_t(1) << (slot % 64);
+        changeDay(day, target);
+    }
+    
+    // Copy every student's mark on a 0-based day to another
+    void copyDay(int fromDay, int toDay) {
+        const DayColumns& index = columns();
+        changeDay(toDay, vector<uint64_t>(index.column(fromDay), index.column(fromDay) + index.words()));
+    }
+    
+    // Select another month: file the selected month's marks into each
+    // student's history and bring the new month's marks out of it. Only
+    // students with marks in either month are touched.
+    void changeMonth(int month, int year) {
+        int oldKey = MonthHistory::monthKey(currentYear, currentMonth);
+        int newKey = MonthHistory::monthKey(year, month);
+        if (newKey != oldKey) {
+            for (int i = 0; i < students.slotLimit(); i++) {
+                if (!students.isLive(i)) continue;
+                StudentView student = students.view(i);
+                if (student.getAttendanceMask() == 0 && student.getHistory().empty()) continue;
+                
+                string history(student.getHistory());
+                DayMask next = MonthHistory::exchange(history, oldKey, student.getAttendanceMask(), newKey);
+                if (next == student.getAttendanceMask() && history == student.getHistory()) continue;
+                students.setHistory(i, history);
+                students.setAttendanceMask(i, next);
+            }
+        }
+        currentMonth = month;
+        currentYear = year;
+        daysInMonth = daysInMonthOf(month, year);
+        attendanceOrder.invalidate();   // percentages depend on the month
+        presentDayBuckets.invalidate();
+        dayColumns.invalidate();
+        invalidateTotals();
+    }
+    
+    void applyJournalRecord(const JournalRecord& record, const string& name) {
+        if (record.op == JOURNAL_MONTH) {
+            int year = record.rollNumber != 0 ? record.rollNumber : currentYear;
+            if (record.argument >= 1 && record.argument <= 12 && isValidYear(year)) {
+                changeMonth(record.argument, year);
+            }
+            return;
+        }
+        if (record.op == JOURNAL_MARK_DAY) {
+            if (record.day < daysInMonth) fillDay(record.day, record.value != 0, {});
+            return;
+        }
+        if (record.op == JOURNAL_COPY_DAY) {
+            if (record.day < daysInMonth && record.argument >= 0 && record.argument < daysInMonth) {
+                copyDay(record.argument, record.day);
+            }
+            return;
+        }
+        
+        int slot = findStudent(record.rollNumber);
+        if (record.op == JOURNAL_ADD) {
+            if (slot < 0) insertStudent(record.rollNumber, name);
+            return;
+        }
+        if (slot < 0) return;
+        
+        switch (record.op) {
+            case JOURNAL_MARK:
+                if (record.day < daysInMonth) changeAttendance(slot, record.day, record.value != 0);
+                break;
+            case JOURNAL_NAME:
+                changeName(slot, name);
+                break;
+            case JOURNAL_ROLL:
+                if (findStudent(record.argument) < 0) changeRollNumber(slot, record.argument);
+                break;
+            case JOURNAL_REMARKS:
+                students.setRemarks(slot, record.value);
+                break;
+            case JOURNAL_DELETE:
+                removeStudent(slot);
+                break;
+        }
+    }
+    
+    // Replay the journal on top of the snapshot just loaded, then keep
+    // appending to it
+    void recoverJournal(uint64_t baseSnapshot) {
+        dataUnreadable = false;
+        string journalPath = dataFile + ".journal";
+        size_t replayed = 0;
+        size_t validRecords = 0;
+        size_t firstRecord = 0;
+        bool found = AttendanceJournal::replay(journalPath, baseSnapshot,
+            [this, &replayed](const JournalRecord& record, const string& name) {
+                applyJournalRecord(record, name);
+                replayed++;
+            }, validRecords, firstRecord);
+        
+        if (found && journal.openForAppend(journalPath, validRecords)) {
+            // A background save was renamed into place but its journal
+            // was not yet rewritten for it
+            if (firstRecord > 0 && !journal.rebase(baseSnapshot, firstRecord)) {
+                status("Warning: could not reset the attendance journal.");
+            }
+            if (replayed > 0) {
+                status("Recovered " + to_string(replayed) + " unsaved change(s) from the journal.");
+            }
+            return;
+        }
+        if (!journal.reset(journalPath, baseSnapshot)) {
+            status("Warning: could not open the attendance journal.");
+        }
+    }
+    
+    // Write what the current operation logged, and fold a long journal
+    // back into the snapshot
+    void commitJournal() {
+        if (!journalDeferred) writeJournal();
+    }
+    
+    void writeJournal() {
+        finishBackgroundSave(false);
+        if (!journal.isOpen()) return;
+        OperationTimer timer(STAT_JOURNAL);
+        if (!journal.commit()) {
+            status("Warning: could not write the attendance journal.");
+        }
+        if (journal.size() >= JOURNAL_COMPACT_RECORDS && !backgroundSave) {
+            string error;
+            if (!startBackgroundSave(error)) status(error);
+        }
+        // Marks that commit the journal themselves come back here when it
+        // reaches journalPollAt
+        journalPollAt = backgroundSave ? journal.size() + JOURNAL_POLL_RECORDS : JOURNAL_COMPACT_RECORDS;
+    }
+    
+    // Progress and warning messages. In command mode they go to stderr so
+    // they never mix with the machine-readable output on stdout.
+    // Each message is written whole so sections loading in parallel do not
+    // interleave.
+    void status(const string& message) {
+        if (silent) return;
+        (quiet ? cerr : cout) << (statusPrefix + message + "\n");
+    }
+    
+    // Reorder the roster by keys, most significant first
+    void sortRoster(const vector<SortKey>& keys) {
+        OperationTimer timer(STAT_SORT);
+        students.reorder(RosterSorter(keys).sortedSlots(students, daysInMonth));
+        rebuildRollIndex();
+        invalidateOrders();
+    }
+    
+public:
+    void clearInputBuffer() {
+        cin.clear();
+        cin.ignore(10000, '\n');
+    }
+
+    AttendanceSystem()
+        : currentMonth(5), currentYear(thisYear()), daysInMonth(31), rollIndexReady(true),
+          nameOrder(NameOrder{&students}),
+          attendanceOrder(AttendanceOrder{&students, &daysInMonth}),
+          rollNumberOrder(RollNumberOrder{&students}), nameSearch(&students), totalsReady(true),
+          dataFile("students.dat"), quiet(false), silent(false), journalDeferred(false), dataUnreadable(false),
+          backgroundSaveStart(0), journalPollAt(JOURNAL_COMPACT_RECORDS), concurrent(false),
+          published(nullptr), readEpoch(1) {}
+    
+    ~AttendanceSystem() { finishBackgroundSave(true); }
+    
+    // The secondary indices point into this object
+    AttendanceSystem(const AttendanceSystem&) = delete;
+    AttendanceSystem& operator=(const AttendanceSystem&) = delete;
+    
+    // ---- Non-interactive API ----
+    // Used by command mode and by the menu handlers below. Mutators check
+    // their input the same way the menu does, log to the journal, and on
+    // failure return false with a user-facing message in error.
+    
+    // The roster to this thread alone for a scope. The calls below take it,
+    // but for the settings and markStudent(), which mostly needs only its
+    // stripe; a caller making several calls that must see the same roster
+    // holds one across them. The outermost hold first logs the marks the
+    // stripes kept back, so the journal stays in order, and ends by
+    // publishing the roster in concurrent mode.
+    class Exclusive {
+    private:
+        AttendanceSystem& system;
+        bool outermost;
+        
+        Exclusive(const Exclusive&) = delete;
+        Exclusive& operator=(const Exclusive&) = delete;
+        
+    public:
+        explicit Exclusive(AttendanceSystem& owner) : system(owner), outermost(owner.rosterLock.lock()) {
+            if (outermost) system.collectMarks(owner.rosterLock.enteredStripes());
+        }
+        ~Exclusive() {
+            if (outermost && system.concurrent) system.publish();
+            system.rosterLock.unlock();
+        }
+    };
+    
+    void setDataFile(const string& path) { dataFile = path; }
+    void setQuiet(bool value) { quiet = value; }
+    void setSilent(bool value) { silent = value; }
+    void setStatusPrefix(const string& prefix) { statusPrefix = prefix; }
+    
+    // While deferred, changes are logged but written to the journal only
+    // by flushJournal(), so a server can write many requests at once
+    void setJournalDeferred(bool value) {
+        Exclusive hold(*this);
+        journalDeferred = value;
+    }
+    void flushJournal() {
+        Exclusive hold(*this);
+        writeJournal();
+    }
+    
+    // In concurrent mode marks, and Readers, may run on any number of
+    // threads alongside the other calls; every exclusive call then ends by
+    // publishing a read-only copy of the roster, which costs a few
+    // pointers per 4096 students. Readers must be gone before it is
+    // turned off.
+    void setConcurrent(bool value) {
+        Exclusive hold(*this);
+        concurrent = value;
+        if (!concurrent) {
+            collectMarks(~uint64_t(0));
+            published.store(nullptr);
+            view.reset();
+            retired.clear();
+        }
+    }
+    
+    // The roster as published by the last exclusive hold, for a thread
+    // that only reads; marks made since show as well. Taking one never
+    // waits for the roster, and what it returns stays valid while it is
+    // held. Only in concurrent mode; hold one briefly, as the versions it
+    // may be reading are kept until then.
+    class Reader {
+    private:
+        const AttendanceSystem& system;
+        atomic<uint64_t>* slot;
+        const RosterVersion* version;
+        
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        
+    public:
+        explicit Reader(AttendanceSystem& owner) : system(owner), slot(nullptr) {
+            size_t first = hash<thread::id>()(this_thread::get_id());
+            for (size_t i = 0; !slot; i++) {
+                if (i > 0 && i % READER_SLOTS == 0) this_thread::yield();    // more readers than slots
+                atomic<uint64_t>& candidate = owner.readerSlots[(first + i) % READER_SLOTS].epoch;
+                uint64_t free = 0;
+                if (candidate.compare_exchange_strong(free, owner.readEpoch.load())) slot = &candidate;
+            }
+            version = owner.published.load();
+        }
+        ~Reader() { slot->store(0); }
+        
+        // Slot of the student with this roll number, or -1
+        int find(int rollNumber) const { return version ? version->rollIndex.find(rollNumber) : -1; }
+        StudentView student(int slot) const { return version->students.view(slot); }
+        int studentCount() const { return version ? version->students.size() : 0; }
+        int monthDays() const { return version ? version->daysInMonth : 0; }
+        
+        // Number of students present on a 1-based day
+        int presentOnDay(int day) const {
+            if (!version) return 0;
+            return version->totals.presentOn(day - 1) + static_cast<int>(system.tallied(day - 1));
+        }
+        
+        double averageAttendance() const {
+            if (!version) return 0;
+            AttendanceTotals current = version->totals;
+            MarkTally tally = MarkTally();
+            tally.presentDays = system.tallied(-1);
+            current.addTally(tally, 1);
+            return current.averagePercentage();
+        }
+    };
+    
+    int studentCount() {
+        Exclusive hold(*this);
+        return students.size();
+    }
+    int month() {
+        Exclusive hold(*this);
+        return currentMonth;
+    }
+    int year() {
+        Exclusive hold(*this);
+        return currentYear;
+    }
+    int monthDays() {
+        Exclusive hold(*this);
+        return daysInMonth;
+    }
+    
+    // Slot of the student with this roll number, or -1
+    int lookupStudent(int rollNumber) {
+        OperationTimer timer(STAT_LOOKUP);
+        Exclusive hold(*this);
+        return findStudent(rollNumber);
+    }
+    StudentView studentAt(int slot) {
+        Exclusive hold(*this);
+        return students.view(slot);
+    }
+    
+    // Call visit(slot, view) for every student in roster order
+    template <typename Visitor>
+    void forEachStudent(Visitor visit) {
+        Exclusive hold(*this);
+        for (int i = 0; i < students.slotLimit(); i++) {
+            if (!students.isLive(i)) continue;
+            visit(i, students.view(i));
+        }
+    }
+    
+    // Call visit(slot, view) for every student in the order of field:
+    // highest attendance first, or ascending name or roll number. Read from
+    // an index kept up to date across edits, so the roster is not touched.
+    template <typename Visitor>
+    void forEachStudentSorted(SortField field, Visitor visit) {
+        OperationTimer timer(STAT_LIST);
+        Exclusive hold(*this);
+        auto visitSlot = [&](int slot) { visit(slot, students.view(slot)); };
+        switch (field) {
+            case SORT_BY_ATTENDANCE:
+                buildOrder(attendanceOrder, {{SORT_BY_ATTENDANCE, true}, {SORT_BY_NAME, false}});
+                attendanceOrder.forEach(visitSlot);
+                break;
+            case SORT_BY_NAME:
+                buildOrder(nameOrder, {{SORT_BY_NAME, false}});
+                nameOrder.forEach(visitSlot);
+                break;
+            default:
+                buildOrder(rollNumberOrder, {{SORT_BY_ROLL_NUMBER, false}});
+                rollNumberOrder.forEach(visitSlot);
+                break;
+        }
+    }
+    
+    bool addStudentRecord(int rollNumber, const string& name, string& error) {
+        OperationTimer timer(STAT_ADD);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        if (rollNumber <= 0) {
+            error = "Invalid roll number. Please enter a positive number.";
+            return false;
+        }
+        if (findStudent(rollNumber) >= 0) {
+            error = "Roll number already exists. Please try again.";
+            return false;
+        }
+        if (!isValidName(name)) {
+            error = "Invalid name. Please enter letters only.";
+            return false;
+        }
+        insertStudent(rollNumber, name);
+        journal.logAdd(rollNumber, name);
+        commitJournal();
+        return true;
+    }
+    
+    // day is 1-based; status is 1 for present, 0 for absent. Marks on
+    // different students may be made from several threads at once: most
+    // need only their stripe of the roster (see markUnderStripe()).
+    bool markStudent(int rollNumber, int day, int present, string& error) {
+        OperationTimer timer(STAT_MARK);
+        int stripe = RosterLock::stripeFor(rollNumber);
+        StripeMark result = STRIPE_TAKE_ROSTER;
+        {
+            RosterLock::StripeHold hold(rosterLock, stripe);
+            if (hold.held()) result = markUnderStripe(stripe, rollNumber, day, present, error);
+        }
+        if (result == STRIPE_MARKED_POLL) {
+            Exclusive hold(*this);
+            writeJournal();
+        }
+        if (result != STRIPE_TAKE_ROSTER) return result != STRIPE_FAILED;
+        
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        if (day < 1 || day > daysInMonth) {
+            error = "Invalid day. Please enter a day between 1 and " + to_string(daysInMonth) + ".";
+            return false;
+        }
+        if (present != 0 && present != 1) {
+            error = "Invalid input. Please enter 0 for absent or 1 for present.";
+            return false;
+        }
+        int slot = findStudent(rollNumber);
+        if (slot < 0) {
+            error = notFound(rollNumber);
+            return false;
+        }
+        if (concurrent) {
+            // Orders kept mark by mark would send every mark here
+            attendanceOrder.invalidate();
+            presentDayBuckets.invalidate();
+        }
+        changeAttendance(slot, day - 1, present == 1);
+        journal.logMark(rollNumber, day - 1, present == 1);
+        commitJournal();
+        return true;
+    }
+    
+    // Mark every student present (1) or absent (0) on a 1-based day, except
+    // the students in exceptRollNumbers, who get the opposite mark
+    bool markWholeDay(int day, int present, const vector<int>& exceptRollNumbers, string& error) {
+        OperationTimer timer(STAT_MARK_DAY);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        if (day < 1 || day > daysInMonth) {
+            error = "Invalid day. Please enter a day between 1 and " + to_string(daysInMonth) + ".";
+            return false;
+        }
+        if (present != 0 && present != 1) {
+            error = "Invalid input. Please enter 0 for absent or 1 for present.";
+            return false;
+        }
+        vector<int> exceptSlots;
+        for (int rollNumber : exceptRollNumbers) {
+            int slot = findStudent(rollNumber);
+            if (slot < 0) {
+                error = notFound(rollNumber);
+                return false;
+            }
+            if (find(exceptSlots.begin(), exceptSlots.end(), slot) == exceptSlots.end()) {
+                exceptSlots.push_back(slot);
+            }
+        }
+        fillDay(day - 1, present == 1, exceptSlots);
+        journal.logMarkDay(day - 1, present == 1);
+        for (int slot : exceptSlots) {
+            journal.logMark(students.rollNumber(slot), day - 1, present != 1);
+        }
+        commitJournal();
+        return true;
+    }
+    
+    // Give every student the same mark on toDay as on fromDay (1-based)
+    bool copyDayMarks(int fromDay, int toDay, string& error) {
+        OperationTimer timer(STAT_COPY_DAY);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        if (fromDay < 1 || fromDay > daysInMonth || toDay < 1 || toDay > daysInMonth) {
+            error = "Invalid day. Please enter a day between 1 and " + to_string(daysInMonth) + ".";
+            return false;
+        }
+        copyDay(fromDay - 1, toDay - 1);
+        journal.logCopyDay(fromDay - 1, toDay - 1);
+        commitJournal();
+        return true;
+    }
+    
+    bool renameStudent(int rollNumber, const string& name, string& error) {
+        OperationTimer timer(STAT_RENAME);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        int slot = findStudent(rollNumber);
+        if (slot < 0) {
+            error = notFound(rollNumber);
+            return false;
+        }
+        if (!isValidName(name)) {
+            error = "Invalid name. Please enter letters only.";
+            return false;
+        }
+        changeName(slot, name);
+        journal.logName(rollNumber, name);
+        commitJournal();
+        return true;
+    }
+    
+    bool changeStudentRollNumber(int oldRollNumber, int newRollNumber, string& error) {
+        OperationTimer timer(STAT_REROLL);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        int slot = findStudent(oldRollNumber);
+        if (slot < 0) {
+            error = notFound(oldRollNumber);
+            return false;
+        }
+        int other = findStudent(newRollNumber);
+        if (other >= 0 && other != slot) {
+            error = "Roll number already exists. Please try again.";
+            return false;
+        }
+        changeRollNumber(slot, newRollNumber);
+        journal.logRollNumber(oldRollNumber, newRollNumber);
+        commitJournal();
+        return true;
+    }
+    
+    // code is a RemarkCode from REMARK_POOR to REMARK_EXCELLENT
+    bool setStudentRemarks(int rollNumber, int code, string& error) {
+        OperationTimer timer(STAT_REMARKS);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        int slot = findStudent(rollNumber);
+        if (slot < 0) {
+            error = notFound(rollNumber);
+            return false;
+        }
+        if (code < REMARK_POOR || code > REMARK_EXCELLENT) {
+            error = "Invalid choice. Remarks not updated.";
+            return false;
+        }
+        students.setRemarks(slot, static_cast<uint8_t>(code));
+        journal.logRemarks(rollNumber, static_cast<uint8_t>(code));
+        commitJournal();
+        return true;
+    }
+    
+    bool deleteStudentRecord(int rollNumber, string& error) {
+        OperationTimer timer(STAT_DELETE);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        int slot = findStudent(rollNumber);
+        if (slot < 0) {
+            error = notFound(rollNumber);
+            return false;
+        }
+        removeStudent(slot);
+        journal.logDelete(rollNumber);
+        commitJournal();
+        return true;
+    }
+    
+    bool selectMonth(int month, int year, string& error) {
+        OperationTimer timer(STAT_MONTH);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        if (month < 1 || month > 12) {
+            error = "Invalid month number. Please enter a number between 1 and 12.";
+            return false;
+        }
+        if (!isValidYear(year)) {
+            error = "Invalid year. Please enter a year between 1970 and 2999.";
+            return false;
+        }
+        changeMonth(month, year);
+        journal.logMonth(currentMonth, daysInMonth, currentYear);
+        commitJournal();
+        return true;
+    }
+    
+    // Call visit(year, month, mask) for every month in which the student in
+    // slot has marks, the selected month included, in date order
+    template <typename Visitor>
+    void forEachMonth(int slot, Visitor visit) {
+        OperationTimer timer(STAT_HISTORY);
+        Exclusive hold(*this);
+        StudentView student = students.view(slot);
+        int selected = MonthHistory::monthKey(currentYear, currentMonth);
+        bool visited = student.getAttendanceMask() == 0;
+        MonthHistory::forEach(student.getHistory(), [&](int key, DayMask mask) {
+            if (!visited && selected < key) {
+                visit(currentYear, currentMonth, student.getAttendanceMask());
+                visited = true;
+            }
+            visit(MonthHistory::yearOf(key), MonthHistory::monthOf(key), mask);
+            return true;
+        });
+        if (!visited) visit(currentYear, currentMonth, student.getAttendanceMask());
+    }
+    
+    // Class average for any month, read from the histories without
+    // selecting it; each student's history is walked only up to that month
+    double monthAverage(int month, int year) {
+        OperationTimer timer(STAT_HISTORY);
+        Exclusive hold(*this);
+        int key = MonthHistory::monthKey(year, month);
+        if (key == MonthHistory::monthKey(currentYear, currentMonth)) return averageAttendance();
+        if (students.size() == 0) return 0;
+        int days = daysInMonthOf(month, year);
+        int64_t presentDays = 0;
+        for (int i = 0; i < students.slotLimit(); i++) {
+            if (!students.isLive(i)) continue;
+            string_view history = students.history(i);
+            if (history.empty()) continue;
+            presentDays += countPresentDays(MonthHistory::lookup(history, key) & dayMaskFor(days));
+        }
+        return 100.0 * presentDays / (static_cast<double>(students.size()) * days);
+    }
+    
+    // Days the student in slot was present within range
+    int presentBetween(int slot, const DateRange& range) {
+        OperationTimer timer(STAT_RANGE);
+        Exclusive hold(*this);
+        StudentView student = students.view(slot);
+        int selected = MonthHistory::monthKey(currentYear, currentMonth);
+        int present = countPresentDays(student.getAttendanceMask() & range.daysIn(selected));
+        string_view history = student.getHistory();
+        if (!history.empty() && (range.firstKey != selected || range.lastKey != selected)) {
+            present += MonthHistory::presentBetween(history, range.firstKey, range.firstDays,
+                                                    range.lastKey, range.lastDays);
+        }
+        return present;
+    }
+    
+    // Call visit(slot, presentDays) for every student in roster order, in
+    // one pass. Returns the class average percentage for the range.
+    template <typename Visitor>
+    double rangeReport(const DateRange& range, Visitor visit) {
+        OperationTimer timer(STAT_RANGE);
+        Exclusive hold(*this);
+        int selected = MonthHistory::monthKey(currentYear, currentMonth);
+        DayMask selectedDays = range.daysIn(selected);
+        bool onlySelected = range.firstKey == selected && range.lastKey == selected;
+        int64_t totalPresent = 0;
+        for (int i = 0; i < students.slotLimit(); i++) {
+            if (!students.isLive(i)) continue;
+            int present = countPresentDays(students.attendanceMask(i) & selectedDays);
+            string_view history = onlySelected ? string_view() : students.history(i);
+            if (!history.empty()) {
+                present += MonthHistory::presentBetween(history, range.firstKey,
+                                                        range.firstDays, range.lastKey, range.lastDays);
+            }
+            totalPresent += present;
+            visit(i, present);
+        }
+        if (students.size() == 0 || range.totalDays == 0) return 0;
+        return 100.0 * totalPresent / (static_cast<double>(students.size()) * range.totalDays);
+    }
+    
+    void sortStudents(const vector<SortKey>& keys) {
+        Exclusive hold(*this);
+        sortRoster(keys);
+    }
+    
+    // Number of students present on a 1-based day
+    int presentOnDay(int day) {
+        OperationTimer timer(STAT_DAY);
+        Exclusive hold(*this);
+        return attendanceTotals().presentOn(day - 1);
+    }
+    
+    double averageAttendance() {
+        OperationTimer timer(STAT_AVERAGE);
+        Exclusive hold(*this);
+        return attendanceTotals().averagePercentage();
+    }
+    
+    // Slots of the students with the highest and lowest attendance; the
+    // first such student in roster order wins ties. Both -1 if empty.
+    void findExtremes(int& highestSlot, int& lowestSlot) {
+        OperationTimer timer(STAT_EXTREMES);
+        Exclusive hold(*this);
+        highestSlot = -1;
+        lowestSlot = -1;
+        if (students.size() == 0) return;
+        
+        const PresentDayBuckets& index = buckets();
+        int highest = daysInMonth;
+        while (index.with(highest).empty()) highest--;
+        int lowest = 0;
+        while (index.with(lowest).empty()) lowest++;
+        highestSlot = *min_element(index.with(highest).begin(), index.with(highest).end());
+        lowestSlot = *min_element(index.with(lowest).begin(), index.with(lowest).end());
+    }
+    
+    // Slots, in roster order, of the students whose attendance percentage
+    // satisfies match(percentage). Only matching buckets are visited, so
+    // the cost follows the size of the answer, not of the roster.
+    template <typename Match>
+    vector<int> studentsWithPercentage(Match match) {
+        OperationTimer timer(STAT_THRESHOLD);
+        Exclusive hold(*this);
+        const PresentDayBuckets& index = buckets();
+        vector<int> slots;
+        for (int present = 0; present <= daysInMonth; present++) {
+            if (!match(attendancePercentage(dayMaskFor(present), daysInMonth))) continue;
+            slots.insert(slots.end(), index.with(present).begin(), index.with(present).end());
+        }
+        sort(slots.begin(), slots.end());
+        return slots;
+    }
+    
+    // Number of students whose percentage satisfies match, in O(MAX_DAYS)
+    template <typename Match>
+    int countWithPercentage(Match match) {
+        OperationTimer timer(STAT_THRESHOLD);
+        Exclusive hold(*this);
+        const PresentDayBuckets& index = buckets();
+        int count = 0;
+        for (int present = 0; present <= daysInMonth; present++) {
+            if (match(attendancePercentage(dayMaskFor(present), daysInMonth))) {
+                count += static_cast<int>(index.with(present).size());
+            }
+        }
+        return count;
+    }
+    
+    // Students with a name word starting with each word of query, or with
+    // fuzzy set, within a few typos of each; at most limit of them
+    vector<NameSearchIndex::Match> searchNames(const string& query, bool fuzzy, size_t limit) {
+        OperationTimer timer(STAT_SEARCH);
+        Exclusive hold(*this);
+        return fuzzy ? nameIndex().fuzzySearch(query, limit) : nameIndex().prefixSearch(query, limit);
+    }
+    
+    bool save(string& error) {
+        Exclusive hold(*this);
+        return writeSnapshot(error);
+    }
+    
+    // ---- Menu handlers ----
+    
+    // Enhanced display with colors and better formatting
+    void displayStudents() {
+        displayStudentList(false, SORT_BY_ROLL_NUMBER);
+    }
+    
+    // Student table in roster order, or in the order of field if sorted
+    void displayStudentList(bool sorted, SortField field) {
+        clearScreen();
+        if (students.size() == 0) {
+            setConsoleColor(12); // Red
+            cout << "\n  X No students registered.\n";
+            setConsoleColor(7);
+            pauseScreen();
+            return;
+        }
+        
+        setConsoleColor(11); // Light cyan
+        cout << "\n+==================================================================+\n";
+        cout << "|                          STUDENT LIST                           |\n";
+        cout << "+==================================================================+\n";
+        setConsoleColor(7);
+        
+        cout << "| Roll No |      Name      | Attendance % |    Remarks    |\n";
+        cout << "+---------+----------------+--------------+---------------+\n";
+        
+        auto displayRow = [this](int, const StudentView& student) {
+            double attendancePercentage = student.getAttendancePercentage(daysInMonth);
+            
+            // Color code based on attendance percentage
+            if (attendancePercentage >= 85) setConsoleColor(10); // Green
+            else if (attendancePercentage >= 75) setConsoleColor(14); // Yellow
+            else setConsoleColor(12); // Red
+            
+            string_view name = student.getName().substr(0, 14);
+            string_view remarks = student.getRemarks().substr(0, 13);
+            screen.format("| %7d | %-14.*s |    %6.2f%%    | %-13.*s |\n", 
+                          student.getRollNumber(), 
+                          static_cast<int>(name.size()), name.data(),
+                          attendancePercentage,
+                          static_cast<int>(remarks.size()), remarks.data());
+        };
+        if (sorted) forEachStudentSorted(field, displayRow);
+        else forEachStudent(displayRow);
+        
+        setConsoleColor(7);
+        cout << "+=================================================================+\n";
+        pauseScreen();
+    }
+    
+    // Get valid roll number input (unique)
+    int getRollNumber() {
+        string input;
+        int rollNumber;
+        
+        while (true) {
+            cout << "Enter student roll number: ";
+            getline(cin, input);
+            
+            try {
+                rollNumber = stoi(input);
+                
+                if (rollNumber <= 0) {
+                    cout << "Invalid roll number. Please enter a positive number.\n";
+                    continue;
+                }
+                
+                // Check for duplicate roll number
+                if (findStudent(rollNumber) < 0) {
+                    return rollNumber; // Return valid, non-duplicate roll number
+                } else {
+                    cout << "Roll number already exists. Please try again.\n";
+                }
+            } catch (exception&) {
+                cout << "Invalid roll number. Please enter numbers only.\n";
+            }
+        }
+    }
+    
+    // Add a new student
+    void addStudent() {
+        clearScreen();
+        setConsoleColor(11);
+        cout << "\n+======================================+\n";
+        cout << "|            ADD NEW STUDENT           |\n";
+        cout << "+======================================+\n";
+        setConsoleColor(7);
+        
+        int rollNumber = getRollNumber();
+        string name;
+        
+        while (true) {
+            cout << "\nEnter student name: ";
+            getline(cin, name);
+            
+            if (isValidName(name)) {
+                break;
+            } else {
+                setConsoleColor(12);
+                cout << "X Invalid name. Please enter letters only.\n";
+                setConsoleColor(7);
+            }
+        }
+        
+        string error;
+        if (!addStudentRecord(rollNumber, name, error)) {
+            setConsoleColor(12);
+            cout << "\nX " << error << "\n";
+            setConsoleColor(7);
+            pauseScreen();
+            return;
+        }
+        
+        setConsoleColor(10);
+        cout << "\n* Student added successfully!\n";
+        setConsoleColor(7);
+        pauseScreen();
+    }
+    
+    // Mark attendance for a student on a specific day
+    void markAttendance() {
+        if (students.size() == 0) {
+            cout << "No students to mark attendance for.\n";
+            return;
+        }
+        
+        int rollNumber;
+        cout << "Enter student roll number: ";
+        cin >> rollNumber;
+        clearInputBuffer();
+        
+        int day;
+        cout << "Enter day (1-" << daysInMonth << "): ";
+        cin >> day;
+        clearInputBuffer();
+        
+        if (day < 1 || day > daysInMonth) {
+            cout << "Invalid day. Please enter a day between 1 and " << daysInMonth << ".\n";
+            return;
+        }
+        
+        int status;
+        cout << "Mark student as (1: Present, 0: Absent): ";
+        cin >> status;
+        clearInputBuffer();
+        
+        if (status != 0 && status != 1) {
+            cout << "Invalid input. Please enter 0 for absent or 1 for present.\n";
+            return;
+        }
+        
+        string error;
+        if (!markStudent(rollNumber, day, status, error)) {
+            cout << error << "\n";
+            return;
+        }
+        cout << "Attendance marked successfully for " << students.view(findStudent(rollNumber)).getName() 
+                 << " on day " << day << " as " 
+                 << (status == 1 ? "Present" : "Absent") << ".\n";
+    }
+    
+    // Mark the whole class for one day, optionally leaving some students out
+    void markWholeDayAttendance() {
+        if (students.size() == 0) {
+            cout << "No students to mark attendance for.\n";
+            return;
+        }
+        
+        int day;
+        cout << "Enter day (1-" << daysInMonth << "): ";
+        cin >> day;
+        clearInputBuffer();
+        
+        if (day < 1 || day > daysInMonth) {
+            cout << "Invalid day. Please enter a day between 1 and " << daysInMonth << ".\n";
+            return;
+        }
+        
+        int status;
+        cout << "Mark all students as (1: Present, 0: Absent): ";
+        cin >> status;
+        clearInputBuffer();
+        
+        if (status != 0 && status != 1) {
+            cout << "Invalid input. Please enter 0 for absent or 1 for present.\n";
+            return;
+        }
+        
+        cout << "Roll numbers to mark " << (status == 1 ? "absent" : "present")
+             << " instead (separated by spaces, blank for none): ";
+        string line;
+        getline(cin, line);
+        vector<int> exceptions;
+        const char* next = line.data();
+        const char* last = line.data() + line.size();
+        while (true) {
+            while (next < last && isspace(static_cast<unsigned char>(*next))) next++;
+            if (next == last) break;
+            int rollNumber;
+            from_chars_result result = from_chars(next, last, rollNumber);
+            if (result.ec != errc() || (result.ptr < last && !isspace(static_cast<unsigned char>(*result.ptr)))) {
+                cout << "Invalid roll numbers. Please enter numbers separated by spaces.\n";
+                return;
+            }
+            exceptions.push_back(rollNumber);
+            next = result.ptr;
+        }
+        
+        string error;
+        if (!markWholeDay(day, status, exceptions, error)) {
+            cout << error << "\n";
+            return;
+        }
+        cout << "All students marked " << (status == 1 ? "Present" : "Absent") << " on day " << day;
+        if (!exceptions.empty()) cout << ", except " << exceptions.size() << " student(s)";
+        cout << ".\n";
+    }
+    
+    // Repeat one day's marks on another day
+    void copyDayAttendance() {
+        if (students.size() == 0) {
+            cout << "No students registered.\n";
+            return;
+        }
+        
+        int fromDay, toDay;
+        cout << "Copy marks from day (1-" << daysInMonth << "): ";
+        cin >> fromDay;
+        clearInputBuffer();
+        cout << "To day (1-" << daysInMonth << "): ";
+        cin >> toDay;
+        clearInputBuffer();
+        
+        string error;
+        if (!copyDayMarks(fromDay, toDay, error)) {
+            cout << error << "\n";
+            return;
+        }
+        cout << "Marks for day " << fromDay << " copied to day " << toDay << ".\n";
+    }
+    
+    // View attendance for a specific student
+    void viewStudentAttendance() {
+        if (students.size() == 0) {
+            cout << "No students registered.\n";
+            return;
+        }
+        
+        int rollNumber;
+        cout << "Enter student roll number: ";
+        cin >> rollNumber;
+        clearInputBuffer();
+        
+        int i = findStudent(rollNumber);
+        if (i < 0) {
+            cout << "Student with roll number " << rollNumber << " not found.\n";
+            return;
+        }
+        
+        StudentView student = students.view(i);
+        cout << "\nAttendance record for " << student.getName() << ":\n";
+        cout << "----------------------------\n";
+        cout << "Day | Status\n";
+        cout << "----------------------------\n";
+        
+        for (int day = 0; day < daysInMonth; day++) {
+            cout << day + 1 << " | " 
+                    << (student.getAttendance(day) ? "Present" : "Absent") << "\n";
+        }
+        
+        double attendancePercentage = student.getAttendancePercentage(daysInMonth);
+        cout << "----------------------------\n";
+        cout << "Attendance Percentage: " << attendancePercentage << "%\n";
+    }
+    
+    // View a student's attendance for every month on record
+    void viewAttendanceHistory() {
+        if (students.size() == 0) {
+            cout << "No students registered.\n";
+            return;
+        }
+        
+        int rollNumber;
+        cout << "Enter student roll number: ";
+        cin >> rollNumber;
+        clearInputBuffer();
+        
+        int slot = findStudent(rollNumber);
+        if (slot < 0) {
+            cout << notFound(rollNumber) << "\n";
+            return;
+        }
+        
+        cout << "\nAttendance history for " << students.name(slot) << ":\n";
+        cout << "----------------------------\n";
+        cout << "Month   | Present | Attendance %\n";
+        cout << "----------------------------\n";
+        bool found = false;
+        forEachMonth(slot, [&found](int year, int month, DayMask mask) {
+            int days = daysInMonthOf(month, year);
+            screen.format("%02d/%04d | %2d / %2d | %6.2f%%\n", month, year,
+                          countPresentDays(mask & dayMaskFor(days)), days,
+                          attendancePercentage(mask, days));
+            found = true;
+        });
+        if (!found) cout << "No attendance marked yet.\n";
+        cout << "----------------------------\n";
+    }
+    
+    // Attendance between two dates, for one student or the whole class
+    void viewAttendanceBetweenDates() {
+        if (students.size() == 0) {
+            cout << "No students registered.\n";
+            return;
+        }
+        
+        string from, to, input;
+        int fromYear, fromMonth, fromDay, toYear, toMonth, toDay;
+        cout << "Enter the first date (YYYY-MM-DD): ";
+        getline(cin, from);
+        cout << "Enter the last date (YYYY-MM-DD): ";
+        getline(cin, to);
+        DateRange range;
+        if (!DateRange::parseDate(from, fromYear, fromMonth, fromDay) ||
+            !DateRange::parseDate(to, toYear, toMonth, toDay) ||
+            !range.set(fromYear, fromMonth, fromDay, toYear, toMonth, toDay)) {
+            cout << "Invalid dates. Please enter two dates, the first no later than the second.\n";
+            return;
+        }
+        
+        cout << "Enter roll number (press Enter for the whole class): ";
+        getline(cin, input);
+        if (!input.empty()) {
+            int rollNumber = atoi(input.c_str());
+            int slot = findStudent(rollNumber);
+            if (slot < 0) {
+                cout << notFound(rollNumber) << "\n";
+                return;
+            }
+            int present = presentBetween(slot, range);
+            cout << "Present on " << present << " of " << range.totalDays << " days ("
+                    << 100.0 * present / range.totalDays << "%).\n";
+            return;
+        }
+        
+        cout << "\nAttendance from " << from << " to " << to << " (" << range.totalDays << " days):\n";
+        cout << "----------------------------\n";
+        double average = rangeReport(range, [this, &range](int slot, int present) {
+            StudentView student = students.view(slot);
+            cout << "Roll Number: " << student.getRollNumber() 
+                    << ", Name: " << student.getName() 
+                    << ", Attendance: " << 100.0 * present / range.totalDays << "%\n";
+        });
+        cout << "----------------------------\n";
+        cout << "Class average: " << average << "%\n";
+    }
+    
+    // View attendance by day
+    void viewDayAttendance() {
+        if (students.size() == 0) {
+            cout << "No students registered.\n";
+            return;
+        }
+        
+        int day;
+        cout << "Enter day (1-" << daysInMonth << "): ";
+        cin >> day;
+        clearInputBuffer();
+        
+        if (day < 1 || day > daysInMonth) {
+            cout << "Invalid day. Please enter a day between 1 and " << daysInMonth << ".\n";
+            return;
+        }
+        
+        cout << "\nAttendance for Day " << day << ":\n";
+        cout << "----------------------------\n";
+        cout << "Roll Number | Name | Status\n";
+        cout << "----------------------------\n";
+        
+        // Status comes from the day's column rather than each student
+        const uint64_t* present = columns().column(day - 1);
+        for (int i = 0; i < students.slotLimit(); i++) {
+            if (!students.isLive(i)) continue;
+            StudentView student = students.view(i);
+            cout << student.getRollNumber() << " | " 
+                    << student.getName() << " | " 
+                    << ((present[i / 64] >> (i % 64)) & 1 ? "Present" : "Absent") << "\n";
+        }
+        cout << "----------------------------\n";
+        
+        // Calculate attendance statistics for the day
+        int presentCount = presentOnDay(day);
+        
+        double presentPercentage = (static_cast<double>(presentCount) / students.size()) * 100.0;
+        double absentPercentage = 100.0 - presentPercentage;
+        
+        cout << "Present: " << presentCount << " (" << presentPercentage << "%)\n";
+        cout << "Absent: " << (students.size() - presentCount) << " (" << absentPercentage << "%)\n";
+    }
+    
+    // Calculate average attendance for all students
+    void calculateAverageAttendance() {
+        if (students.size() == 0) {
+            cout << "No students to calculate average attendance.\n";
+            return;
+        }
+        
+        cout << "Average Attendance Percentage: " << averageAttendance() << "%\n";
+    }
+    
+    // Find students with highest and lowest attendance
+    void findHighestLowestAttendance() {
+        if (students.size() == 0) {
+            cout << "No students to evaluate.\n";
+            return;
+        }
+        
+        int highestStudentIndex, lowestStudentIndex;
+        findExtremes(highestStudentIndex, lowestStudentIndex);
+        
+        StudentView highest = students.view(highestStudentIndex);
+        StudentView lowest = students.view(lowestStudentIndex);
+        double highestAttendance = highest.getAttendancePercentage(daysInMonth);
+        double lowestAttendance = lowest.getAttendancePercentage(daysInMonth);
+        cout << "Highest Attendance: " << highestAttendance << "% (Student: " 
+                << highest.getName() << ", Roll Number: " 
+                << highest.getRollNumber() << ")\n";
+        cout << "Lowest Attendance: " << lowestAttendance << "% (Student: " 
+                << lowest.getName() << ", Roll Number: " 
+                << lowest.getRollNumber() << ")\n";
+    }
+    
+    // Update student name
+    void updateStudentName() {
+        if (students.size() == 0) {
+            cout << "No students to update.\n";
+            return;
+        }
+        
+        int rollNumber;
+        cout << "Enter the roll number of the student to update: ";
+        cin >> rollNumber;
+        clearInputBuffer();
+        
+        int i = findStudent(rollNumber);
+        if (i < 0) {
+            cout << "Student with roll number " << rollNumber << " not found.\n";
+            return;
+        }
+        
+        string newName;
+        while (true) {
+            cout << "Enter new name for the student: ";
+            getline(cin, newName);
+            
+            string error;
+            if (renameStudent(rollNumber, newName, error)) {
+                cout << "Student name updated successfully.\n";
+                break;
+            } else {
+                cout << error << "\n";
+            }
+        }
+    }
+    
+    // Update student roll number
+    void updateStudentRollNumber() {
+        if (students.size() == 0) {
+            cout << "No students to update.\n";
+            return;
+        }
+        
+        int oldRollNumber;
+        cout << "Enter the current roll number of the student: ";
+        cin >> oldRollNumber;
+        clearInputBuffer();
+        
+        int i = findStudent(oldRollNumber);
+        if (i < 0) {
+            cout << "Student with roll number " << oldRollNumber << " not found.\n";
+            return;
+        }
+        
+        int newRollNumber;
+        cout << "Enter new roll number for the student: ";
+        cin >> newRollNumber;
+        clearInputBuffer();
+        
+        string error;
+        if (changeStudentRollNumber(oldRollNumber, newRollNumber, error)) {
+            cout << "Student roll number updated successfully.\n";
+        } else {
+            cout << error << "\n";
+        }
+    }
+    
+    // Update student remarks
+    void updateStudentRemarks() {
+        if (students.size() == 0) {
+            cout << "No students to update.\n";
+            return;
+        }
+        
+        int rollNumber;
+        cout << "Enter the roll number of the student to update remarks: ";
+        cin >> rollNumber;
+        clearInputBuffer();
+        
+        int i = findStudent(rollNumber);
+        if (i < 0) {
+            cout << "Student with roll number " << rollNumber << " not found.\n";
+            return;
+        }
+        
+        cout << "Enter remarks for the student (1: Poor, 2: Average, 3: Good, 4: Excellent): ";
+        int choice;
+        cin >> choice;
+        clearInputBuffer();
+        
+        // Menu choices 1-4 are the remark codes Poor..Excellent
+        string error;
+        if (!setStudentRemarks(rollNumber, choice, error)) {
+            cout << error << "\n";
+            return;
+        }
+        cout << "Student remarks updated successfully.\n";
+    }
+    
+    // Delete a student
+    void deleteStudent() {
+        if (students.size() == 0) {
+            cout << "No students to delete.\n";
+            return;
+        }
+        
+        int rollNumber;
+        cout << "Enter the roll number of the student to delete: ";
+        cin >> rollNumber;
+        clearInputBuffer();
+        
+        string error;
+        if (!deleteStudentRecord(rollNumber, error)) {
+            cout << error << "\n";
+            return;
+        }
+        cout << "Student with roll number " << rollNumber << " deleted successfully.\n";
+    }
+    
+    // Search student by roll number
+    void searchStudentByRollNumber() {
+        if (students.size() == 0) {
+            cout << "No students to search.\n";
+            return;
+        }
+        
+        int rollNumber;
+        cout << "Enter the roll number of the student to search: ";
+        cin >> rollNumber;
+        clearInputBuffer();
+        
+        int i = findStudent(rollNumber);
+        if (i < 0) {
+            cout << "Student with roll number " << rollNumber << " not found.\n";
+            return;
+        }
+        
+        StudentView student = students.view(i);
+        double attendancePercentage = student.getAttendancePercentage(daysInMonth);
+        
+        cout << "Student found:\n";
+        cout << "Roll Number: " << student.getRollNumber() << "\n";
+        cout << "Name: " << student.getName() << "\n";
+        cout << "Attendance Percentage: " << attendancePercentage << "%\n";
+        cout << "Remarks: " << student.getRemarks() << "\n";
+    }
+    
+    // Find students from part of a name; if nothing starts with it, offer
+    // close spellings
+    void searchStudentByName() {
+        if (students.size() == 0) {
+            cout << "No students to search.\n";
+            return;
+        }
+        
+        string query;
+        cout << "Enter the name, or the start of any part of it: ";
+        getline(cin, query);
+        
+        const size_t SHOWN = 20;
+        vector<NameSearchIndex::Match> matches = searchNames(query, false, SHOWN + 1);
+        if (matches.empty()) {
+            matches = searchNames(query, true, SHOWN + 1);
+            if (matches.empty()) {
+                cout << "No students found matching \"" << query << "\".\n";
+                return;
+            }
+            cout << "No names start with \"" << query << "\". Did you mean:\n";
+        } else {
+            cout << "Students found:\n";
+        }
+        
+        cout << "----------------------------\n";
+        for (size_t i = 0; i < matches.size() && i < SHOWN; i++) {
+            StudentView student = students.view(matches[i].slot);
+            cout << "Roll Number: " << student.getRollNumber()
+                    << ", Name: " << student.getName()
+                    << ", Attendance: " << student.getAttendancePercentage(daysInMonth) << "%\n";
+        }
+        if (matches.size() > SHOWN) cout << "(more matches; type more of the name to narrow them)\n";
+        cout << "----------------------------\n";
+    }
+    
+    // Show students by attendance percentage
+    void sortStudentsByAttendance() {
+        if (students.size() == 0) {
+            cout << "No students to sort.\n";
+            return;
+        }
+        
+        // Read from the sorted index; the roster keeps its order
+        displayStudentList(true, SORT_BY_ATTENDANCE);
+    }
+    
+    // Show students by name
+    void sortStudentsByName() {
+        if (students.size() == 0) {
+            cout << "No students to sort.\n";
+            return;
+        }
+        
+        // Read from the sorted index; the roster keeps its order
+        displayStudentList(true, SORT_BY_NAME);
+    }
+    
+    // Show students by roll number
+    void sortStudentsByRollNumber() {
+        if (students.size() == 0) {
+            cout << "No students to sort.\n";
+            return;
+        }
+        
+        // Read from the sorted index; the roster keeps its order
+        displayStudentList(true, SORT_BY_ROLL_NUMBER);
+    }
+    
+    // Display total number of students
+    void displayTotalNumberOfStudents() {
+        cout << "Total number of students: " << students.size() << "\n";
+    }
+    
+    // Display students with attendance above a certain threshold
+    void displayStudentsAboveThreshold() {
+        if (students.size() == 0) {
+            cout << "No students to display.\n";
+            return;
+        }
+        
+        double threshold;
+        cout << "Enter the attendance percentage threshold: ";
+        cin >> threshold;
+        clearInputBuffer();
+        
+        cout << "\nStudents with attendance percentage above " << threshold << "%:\n";
+        cout << "----------------------------\n";
+        
+        vector<int> matches = studentsWithPercentage([threshold](double p) {
+            return p > threshold;
+        });
+        for (int slot : matches) {
+            StudentView student = students.view(slot);
+            cout << "Roll Number: " << student.getRollNumber() 
+                    << ", Name: " << student.getName() 
+                    << ", Attendance: " << student.getAttendancePercentage(daysInMonth) << "%\n";
+        }
+        
+        if (matches.empty()) {
+            cout << "No students found with attendance above " << threshold << "%.\n";
+        }
+        
+        cout << "----------------------------\n";
+    }
+    
+    // Display students with attendance below a certain threshold
+    void displayStudentsBelowThreshold() {
+        if (students.size() == 0) {
+            cout << "No students to display.\n";
+            return;
+        }
+        
+        double threshold;
+        cout << "Enter the attendance percentage threshold: ";
+        cin >> threshold;
+        clearInputBuffer();
+        
+        cout << "\nStudents with attendance percentage below " << threshold << "%:\n";
+        cout << "----------------------------\n";
+        
+        vector<int> matches = studentsWithPercentage([threshold](double p) {
+            return p < threshold;
+        });
+        for (int slot : matches) {
+            StudentView student = students.view(slot);
+            cout << "Roll Number: " << student.getRollNumber() 
+                    << ", Name: " << student.getName() 
+                    << ", Attendance: " << student.getAttendancePercentage(daysInMonth) << "%\n";
+        }
+        
+        if (matches.empty()) {
+            cout << "No students found with attendance below " << threshold << "%.\n";
+        }
+        
+        cout << "----------------------------\n";
+    }
+    
+    // Display students with attendance in a specific range
+    void displayStudentsInAttendanceRange() {
+        if (students.size() == 0) {
+            cout << "No students to display.\n";
             return;
         }
         
-        int day;
-        cout << "Enter day (1-" << daysInMonth << "): ";
-        cin >> day;
+        double minAttendance, maxAttendance;
+        cout << "Enter the minimum attendance percentage: ";
+        cin >> minAttendance;
+        cout << "Enter the maximum attendance percentage: ";
+        cin >> maxAttendance;
         clearInputBuffer();
         
-        if (day < 1 || day > daysInMonth) {
-            cout << "Invalid day. Please enter a day between 1 and " << daysInMonth << ".\n";
+        cout << "\nStudents with attendance percentage between " 
+                << minAttendance << "% and " << maxAttendance << "%:\n";
+        cout << "----------------------------\n";
+        
+        vector<int> matches = studentsWithPercentage([minAttendance, maxAttendance](double p) {
+            return p >= minAttendance && p <= maxAttendance;
+        });
+        for (int slot : matches) {
+            StudentView student = students.view(slot);
+            cout << "Roll Number: " << student.getRollNumber() 
+                    << ", Name: " << student.getName() 
+                    << ", Attendance: " << student.getAttendancePercentage(daysInMonth) << "%\n";
+        }
+        
+        if (matches.empty()) {
+            cout << "No students found with attendance between " 
+                    << minAttendance << "% and " << maxAttendance << "%.\n";
+        }
+        
+        cout << "----------------------------\n";
+    }
+    
+    // Update month and days in month
+    void setMonth() {
+        int month;
+        cout << "Enter month number (1-12): ";
+        cin >> month;
+        clearInputBuffer();
+        
+        string input;
+        int year = currentYear;
+        cout << "Enter year (press Enter for " << currentYear << "): ";
+        getline(cin, input);
+        if (!input.empty()) {
+            try {
+                year = stoi(input);
+            } catch (const exception&) {
+                year = 0;
+            }
+        }
+        
+        string error;
+        if (!selectMonth(month, year, error)) {
+            cout << error << "\n";
+            return;
+        }
+        
+        cout << "Month set to " << month << "/" << year << " with " << daysInMonth << " days.\n";
+    }
+    
+    // Write a checkpoint and wait for it; the journal then holds nothing
+    bool writeSnapshot(string& error) {
+        Exclusive hold(*this);
+        return startBackgroundSave(error) && finishCheckpoint(true, error);
+    }
+    
+    // Start a checkpoint on a background thread from a frozen copy of the
+    // roster; edits go on meanwhile and are journaled after a marker, so
+    // the journal can carry on from the checkpoint. Only the slot pages and
+    // text blocks changed since the last checkpoint are written, in place
+    // in the paged data file. A roster read from an older data file, or
+    // one that has mostly changed, is written whole to a new file that
+    // then replaces the data file; that also keeps the file from growing.
+    bool startBackgroundSave(string& error) {
+        Exclusive hold(*this);
+        if (!finishCheckpoint(true, error)) status(error);
+        error.clear();
+        if (!editable(error)) return false;
+        // A paged mapping is checkpointed as it is; other files are
+        // converted, which needs every student in memory
+        if (students.isMapped() && !students.mapsPages()) students.detach();
+        if (students.takeDamaged()) {
+            status("Warning: some saved data was corrupt (checksum mismatch) and is saved as found.");
+        }
+        
+        vector<int> pages = students.changedSlotPages();
+        size_t textFrom = students.changedTextFrom();
+        size_t blocks = students.textArena().blockCount();
+        size_t changed = pages.size() + (blocks - min(textFrom, blocks));
+        size_t total = students.slotPageCount() + blocks;
+        RosterPageFile* target = pageFile.get();
+        if (!pageFile || students.everythingChanged() || changed * 2 > total) {
+            newPageFile.reset(new RosterPageFile());
+            if (!newPageFile->create(dataFile + ".tmp")) {
+                newPageFile.reset();
+                error = "Error writing student data file.";
+                return false;
+            }
+            target = newPageFile.get();
+            pages.resize(students.slotPageCount());
+            for (size_t page = 0; page < pages.size(); page++) pages[page] = static_cast<int>(page);
+            textFrom = 0;
+        }
+        
+        backgroundSaveStart = journal.isOpen() ? journal.logSnapshotBegin() : 0;
+        bool all = students.everythingChanged();
+        students.markClean();
+        backgroundSave.reset(new CheckpointWriter(target, students.frozenCopy(), move(pages), textFrom, all,
+                                                  currentMonth, daysInMonth, currentYear));
+        return true;
+    }
+    
+    // Commit a background checkpoint once it is written, or at once with
+    // wait: log which checkpoint it is, write its header (or rename a new
+    // file over the data file) and rewrite the journal with just the
+    // changes made since the roster was frozen
+    bool finishCheckpoint(bool wait, string& error) {
+        Exclusive hold(*this);
+        if (!backgroundSave || (!wait && !backgroundSave->done())) return true;
+        unique_ptr<CheckpointWriter> save = move(backgroundSave);
+        bool ok = save->wait();
+        RosterPageFile* target = newPageFile ? newPageFile.get() : pageFile.get();
+        uint64_t fingerprint = target->preparedFingerprint();
+        
+        // The journal must name the new checkpoint before it becomes
+        // current, or a crash in between would drop the later changes
+        if (ok && journal.isOpen()) {
+            journal.logSnapshotDone(fingerprint);
+            ok = journal.sync();
+        }
+        ok = ok && target->commit();
+        if (ok && newPageFile) ok = replaceFile(dataFile + ".tmp", dataFile);
+        if (!ok) {
+            save->restore(students);
+            if (newPageFile) {
+                newPageFile.reset();
+                unlink((dataFile + ".tmp").c_str());
+            }
+            error = "Error writing student data file.";
+            return false;
+        }
+        if (newPageFile) pageFile = move(newPageFile);
+        
+        bool journalOk = journal.isOpen() ? journal.rebase(fingerprint, backgroundSaveStart)
+                                          : journal.reset(dataFile + ".journal", fingerprint);
+        if (!journalOk) {
+            error = "Warning: could not reset the attendance journal.";
+            return false;
+        }
+        return true;
+    }
+    
+    void finishBackgroundSave(bool wait) {
+        string error;
+        if (!finishCheckpoint(wait, error)) status(error);
+    }
+    
+    // Menu handler: save without waiting for the write
+    void saveInBackground() {
+        string error;
+        if (!startBackgroundSave(error)) {
+            cout << error << "\n";
+            return;
+        }
+        cout << "Saving student data in the background; you can carry on working.\n";
+    }
+    
+    // Check whether a background save has finished and install it
+    void pollBackgroundSave() { finishBackgroundSave(false); }
+    
+    // Save data to file
+    void saveToFile() {
+        string error;
+        if (!writeSnapshot(error)) {
+            cout << error << "\n";
+            return;
+        }
+        cout << "Student data saved to file.\n";
+    }
+    
+    // Load data from file
+    void loadFromFile() {
+        Exclusive hold(*this);
+        finishBackgroundSave(true);
+        OperationTimer timer(STAT_LOAD);
+        dataUnreadable = true;      // until recoverJournal() runs
+        if (RosterPageFile::recognizes(dataFile)) {
+            loadPagedFile();
+            return;
+        }
+        pageFile.reset();
+        ifstream file(dataFile, std::ios::binary);
+        if (!file) {
+            status("No saved data found or error opening file.");
+            if (access(dataFile.c_str(), F_OK) != 0) startFresh();
+            return;
+        }
+        
+        RosterFileHeader header;
+        char rawHeader[sizeof(RosterFileHeader)];
+        string error;
+        file.read(rawHeader, sizeof(rawHeader));
+        countBytesRead(file.gcount());
+        if (!readRosterHeader(rawHeader, file.gcount(), header, error)) {
+            status(error);
+            return;
+        }
+        
+        uint32_t studentCount = littleEndian(header.studentCount);
+        uint32_t nameBytes = littleEndian(header.nameBytes);
+        uint32_t historyBytes = littleEndian(header.historyBytes);
+        RosterLayout layout(header);
+        
+        // One bulk read of all columns, then a single checksum pass
+        vector<char> payload(layout.payloadBytes);
+        file.clear();
+        file.seekg(littleEndian(header.headerSize));
+        bool complete = static_cast<bool>(file.read(payload.data(), payload.size()));
+        countBytesRead(file.gcount());
+        if (!complete) {
+            status("Saved data is truncated.");
+            return;
+        }
+        file.close();
+        if (crc32c(0, payload.data(), payload.size()) != littleEndian(header.payloadChecksum)) {
+            status("Saved data is corrupt (checksum mismatch).");
+            return;
+        }
+        
+        int32_t* rollNumbers = reinterpret_cast<int32_t*>(&payload[layout.rollNumbers]);
+        uint32_t* nameOffsets = reinterpret_cast<uint32_t*>(&payload[layout.nameOffsets]);
+        const char* names = &payload[layout.names];
+        const uint8_t* remarks = reinterpret_cast<const uint8_t*>(&payload[layout.remarks]);
+        DayMask* attendance = reinterpret_cast<DayMask*>(&payload[layout.attendance]);
+        littleEndianColumn(rollNumbers, studentCount);
+        littleEndianColumn(nameOffsets, studentCount + 1);
+        littleEndianColumn(attendance, studentCount);
+        for (uint32_t i = 0; i < studentCount; i++) {
+            if (nameOffsets[i] > nameOffsets[i + 1] || nameOffsets[i + 1] > nameBytes) {
+                status("Saved data is corrupt (bad name table).");
+                return;
+            }
+        }
+        
+        // Version 1 files have no history; every student starts empty
+        uint32_t* historyOffsets = nullptr;
+        const char* history = nullptr;
+        if (layout.history != 0) {
+            historyOffsets = reinterpret_cast<uint32_t*>(&payload[layout.historyOffsets]);
+            history = &payload[layout.history];
+            littleEndianColumn(historyOffsets, studentCount + 1);
+            for (uint32_t i = 0; i < studentCount; i++) {
+                if (historyOffsets[i] > historyOffsets[i + 1] || historyOffsets[i + 1] > historyBytes) {
+                    status("Saved data is corrupt (bad history table).");
+                    return;
+                }
+            }
+        }
+        
+        if (header.currentYear != 0) currentYear = littleEndian(header.currentYear);
+        currentMonth = littleEndian(header.currentMonth);
+        daysInMonth = littleEndian(header.daysInMonth);
+        students.clear();
+        invalidateOrders();
+        invalidateTotals();
+        rollIndex.clear();
+        rollIndex.reserve(studentCount);
+        for (uint32_t i = 0; i < studentCount; i++) {
+            int slot = students.add();
+            students.setRollNumber(slot, rollNumbers[i]);
+            students.setName(slot, string_view(names + nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]));
+            students.setRemarks(slot, remarks[i]);
+            students.setAttendanceMask(slot, attendance[i]);
+            if (history) {
+                students.setHistory(slot, string_view(history + historyOffsets[i],
+                                                      historyOffsets[i + 1] - historyOffsets[i]));
+            }
+            rollIndex.insert(rollNumbers[i], slot);
+        }
+        rollIndexReady = true;
+        
+        status("Student data loaded from file.");
+        recoverJournal(snapshotFingerprint(header));
+    }
+    
+    // Apply a batch of imported events. The batch is processed in two
+    // passes so that memory accesses can be prefetched ahead of use: first
+    // every roll number is resolved through the index, then the students
+    // are updated. On large rosters both passes are bound by cache misses.
+    void applyEvents(const vector<AttendanceEvent>& batch, ImportReport& report, bool log) {
+        Exclusive hold(*this);
+        if (!rollIndexReady) rebuildRollIndex();
+        const size_t PREFETCH_DISTANCE = 16;
+        size_t count = batch.size();
+        
+        // A batch that touches much of the roster is cheaper to follow with
+        // a rebuild of the attendance order than to keep it current
+        bool keepOrder = attendanceOrder.ready() && count <= size_t(students.size() / 64);
+        if (!keepOrder) attendanceOrder.invalidate();
+        DayMask days = dayMaskFor(daysInMonth);
+        
+        eventSlots.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            if (i + PREFETCH_DISTANCE < count) {
+                rollIndex.prefetch(batch[i + PREFETCH_DISTANCE].rollNumber);
+            }
+            eventSlots[i] = rollIndex.find(batch[i].rollNumber);
+        }
+        
+        for (size_t i = 0; i < count; i++) {
+            if (i + PREFETCH_DISTANCE < count && eventSlots[i + PREFETCH_DISTANCE] >= 0) {
+                students.prefetch(eventSlots[i + PREFETCH_DISTANCE]);
+            }
+            const AttendanceEvent& event = batch[i];
+            if (event.day < 1 || event.day > daysInMonth) {
+                report.reject(event.line, "day out of range");
+                continue;
+            }
+            if (event.status != 0 && event.status != 1) {
+                report.reject(event.line, "status must be 0 or 1");
+                continue;
+            }
+            int slot = eventSlots[i];
+            if (slot < 0) {
+                report.reject(event.line, "unknown roll number");
+                continue;
+            }
+            if (keepOrder) {
+                changeAttendance(slot, event.day - 1, event.status == 1);
+            } else {
+                DayMask before = students.attendanceMask(slot);
+                students.setAttendance(slot, event.day - 1, event.status == 1);
+                DayMask after = students.attendanceMask(slot);
+                if (totalsReady) totals.change(before, after);
+                if (presentDayBuckets.ready()) {
+                    presentDayBuckets.update(slot, countPresentDays(after & days));
+                }
+                if (dayColumns.ready()) dayColumns.set(slot, event.day - 1, event.status == 1);
+            }
+            if (log) journal.logMark(event.rollNumber, event.day - 1, event.status == 1);
+            report.applied++;
+        }
+    }
+    
+    // Import attendance events from a CSV or binary event file (see
+    // AttendanceEventReader). Small imports are journaled like menu marks;
+    // once an import would overflow the journal it stops journaling and
+    // finishes with a snapshot instead. Marks are idempotent, so an import
+    // interrupted by a crash can simply be run again.
+    bool importAttendanceEvents(const string& path, ImportReport& report, string& error) {
+        OperationTimer timer(STAT_IMPORT);
+        Exclusive hold(*this);
+        if (!editable(error)) return false;
+        AttendanceEventReader reader;
+        if (!reader.open(path)) {
+            error = "Could not open " + path + ".";
+            return false;
+        }
+        
+        const size_t BATCH_EVENTS = 65536;
+        vector<AttendanceEvent> batch;
+        batch.reserve(BATCH_EVENTS);
+        bool journaling = journal.isOpen();
+        bool snapshotAtEnd = false;
+        while (reader.next(batch, BATCH_EVENTS, report)) {
+            if (journaling && journal.size() + batch.size() >= JOURNAL_COMPACT_RECORDS) {
+                journaling = false;
+                snapshotAtEnd = true;
+            }
+            applyEvents(batch, report, journaling);
+            if (journaling) commitJournal();
+        }
+        
+        if (snapshotAtEnd && !writeSnapshot(error)) status(error);
+        return true;
+    }
+    
+    // Menu handler for bulk import
+    void importAttendance() {
+        string path;
+        cout << "Enter the path of the attendance file (CSV rows: roll,day,status): ";
+        getline(cin, path);
+        
+        ImportReport report;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        string error;
+        if (!importAttendanceEvents(path, report, error)) {
+            cout << error << "\n";
+            return;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        
+        cout << "Rows read: " << report.rows << "\n";
+        cout << "Marks applied: " << report.applied << "\n";
+        cout << "Rows rejected: " << report.rejected << "\n";
+        for (const string& sample : report.samples) {
+            cout << "  " << sample << "\n";
+        }
+        if (report.rejected > report.samples.size()) {
+            cout << "  ... and " << (report.rejected - report.samples.size()) << " more\n";
+        }
+        if (seconds > 0) {
+            cout << "Imported in " << seconds << " s (" 
+                    << static_cast<uint64_t>(report.rows / seconds) << " rows/s).\n";
+        }
+    }
+    
+    // Map the data file instead of reading it. Startup cost no longer grows
+    // with the roster: queries read the mapping in place, a student is
+    // copied into memory on its first edit, and the roll index is built on
+    // the first lookup. Use loadFromFile() to also verify the payload checksum;
+    // a mapped paged file checks each slot page when it is first copied.
+    void mapFromFile() {
+        Exclusive hold(*this);
+        finishBackgroundSave(true);
+        OperationTimer timer(STAT_MAP);
+        dataUnreadable = true;      // until recoverJournal() runs
+        if (RosterPageFile::recognizes(dataFile)) {
+            mapPagedFile();
+            return;
+        }
+        pageFile.reset();
+        unique_ptr<MappedRoster> roster(new MappedRoster());
+        string error;
+        if (!roster->open(dataFile, error)) {
+            status(error);
+            if (access(dataFile.c_str(), F_OK) != 0) startFresh();
+            return;
+        }
+        
+        if (roster->year() != 0) currentYear = roster->year();
+        currentMonth = roster->month();
+        daysInMonth = roster->daysInMonth();
+        uint64_t fingerprint = roster->fingerprint();
+        students.attach(move(roster));
+        invalidateOrders();
+        invalidateTotals();
+        rollIndex.clear();
+        rollIndexReady = false;
+        status("Student data loaded from file.");
+        recoverJournal(fingerprint);
+    }
+    
+    // Map a paged data file and keep it open for the checkpoints that
+    // follow. Only the header and page tables are read here; a slot page
+    // is checked and copied when one of its students is first changed.
+    void mapPagedFile() {
+        Exclusive hold(*this);
+        pageFile.reset();
+        unique_ptr<RosterPageFile> file(new RosterPageFile());
+        unique_ptr<MappedRoster> roster(new MappedRoster());
+        string error;
+        if (!file->open(dataFile, error) ||
+            !roster->openPaged(dataFile, file->slotPageEntries(), file->textBlockEntries(),
+                               file->slotCount(), error)) {
+            status(error);
+            return;
+        }
+        
+        invalidateOrders();
+        invalidateTotals();
+        rollIndex.clear();
+        rollIndexReady = false;
+        if (!students.attachPages(move(roster), file->textPosition(), file->textBytes())) {
+            status("Saved data is corrupt (bad page table).");
+            return;
+        }
+        
+        if (file->year() != 0) currentYear = file->year();
+        currentMonth = file->month();
+        daysInMonth = file->daysInMonth();
+        uint64_t fingerprint = file->fingerprint();
+        pageFile = move(file);
+        status("Student data loaded from file.");
+        recoverJournal(fingerprint);
+    }
+    
+    // Read a paged data file, checking every page, and keep it open for
+    // the checkpoints that follow
+    void loadPagedFile() {
+        Exclusive hold(*this);
+        pageFile.reset();
+        unique_ptr<RosterPageFile> file(new RosterPageFile());
+        string error;
+        if (!file->open(dataFile, error)) {
+            status(error);
+            return;
+        }
+        
+        students.clear();
+        invalidateOrders();
+        invalidateTotals();
+        rollIndex.clear();
+        rollIndexReady = false;
+        vector<char> buffer;
+        bool ok = true;
+        for (size_t block = 0; ok && block < file->textBlocks(); block++) {
+            ok = file->readTextBlock(block, buffer);
+            if (ok) students.appendTextBlock(string_view(buffer.data(), buffer.size()));
+        }
+        ok = ok && students.setTextTail(file->textPosition());
+        if (ok) students.beginSlots(file->slotCount());
+        for (int page = 0; ok && page < file->slotPages(); page++) {
+            ok = file->readSlotPage(page, buffer) && students.decodeSlotPage(page, buffer.data());
+        }
+        if (!ok) {
+            students.clear();
+            status("Saved data is corrupt (checksum mismatch).");
             return;
         }
+        students.endSlots();
+        
+        if (file->year() != 0) currentYear = file->year();
+        currentMonth = file->month();
+        daysInMonth = file->daysInMonth();
+        uint64_t fingerprint = file->fingerprint();
+        pageFile = move(file);
+        status("Student data loaded from file.");
+        recoverJournal(fingerprint);
+    }
+    
+    // No snapshot exists yet: begin with an empty roster, keeping any
+    // changes journaled since the program was first run. A snapshot that
+    // exists but cannot be read leaves its journal untouched, and no edits
+    // are accepted (see editable()).
+    void startFresh() {
+        Exclusive hold(*this);
+        finishBackgroundSave(true);
+        pageFile.reset();
+        students.clear();
+        invalidateOrders();
+        invalidateTotals();
+        rollIndex.clear();
+        rollIndexReady = true;
+        recoverJournal(0);
+    }
+    
+    // Where time has gone in this session, with an option to write the
+    // Prometheus and JSON exports to files
+    void displayPerformanceStats() {
+#if SAMS_STATS
+        StatsTotals sum = Stats::totals();
+        cout << "\nPerformance statistics for this session:\n";
+        cout << "---------------------------------------------------------\n";
+        cout << "Operation  |    Calls |   Total ms |  p50 us  |  p99 us\n";
+        cout << "---------------------------------------------------------\n";
+        bool any = false;
+        for (int op = 0; op < STAT_OPERATION_COUNT; op++) {
+            if (sum.calls[op] == 0) continue;
+            screen.format("%-10s | %8llu | %10.3f | %8.1f | %8.1f\n", statsOperationName(op),
+                          static_cast<unsigned long long>(sum.calls[op]), sum.nanos[op] / 1e6,
+                          sum.percentileSeconds(op, 0.5) * 1e6, sum.percentileSeconds(op, 0.99) * 1e6);
+            any = true;
+        }
+        if (!any) cout << "No operations recorded yet.\n";
+        cout << "---------------------------------------------------------\n";
+        cout << "Snapshot bytes read: " << sum.bytesRead << ", written: " << sum.bytesWritten << "\n";
+        cout << "(Percentiles are bucket upper bounds, within a factor of two.)\n";
+        
+        char choice;
+        cout << "\nWrite sams-stats.prom and sams-stats.json? (y/n): ";
+        cin >> choice;
+        clearInputBuffer();
+        if (choice != 'y' && choice != 'Y') return;
+        string prometheus = Stats::prometheus();
+        string json = Stats::json() + "\n";
+        if (writeFileAtomically("sams-stats.prom", prometheus.data(), prometheus.size(), nullptr, 0) &&
+            writeFileAtomically("sams-stats.json", json.data(), json.size(), nullptr, 0)) {
+            cout << "Statistics written to sams-stats.prom and sams-stats.json.\n";
+        } else {
+            cout << "Error writing the statistics files.\n";
+        }
+#else
+        cout << "Statistics were compiled out of this build (SAMS_STATS=0).\n";
+#endif
+    }
+    
+    // Display additional information about the project
+    void displayAdditionalInfo() {
+        cout << "\n";
+        cout << "Project Team Contributions\n";
+        cout << "----------------------------\n";
+        cout << "Md Anis Mondal: Coding and Report\n";
+        cout << "Md Reag Rahaman: PowerPoint Presentation\n";
+        cout << "Harsh: PowerPoint Presentation\n";
+        cout << "----------------------------\n";
+        cout << "If you encounter any issues or bugs, kindly report them to Md Anis Mondal (BCA)\n";
+    }
+};
+
+// Enhanced menu display
+void displayMenu() {
+    clearScreen();
+    setConsoleColor(11); // Light cyan
+    cout << "\n+==============================================================+\n";
+    cout << "|           STUDENT ATTENDANCE MANAGEMENT SYSTEM              |\n";
+    cout << "+==============================================================+\n";
+    setConsoleColor(14); // Yellow
+    cout << "|  1. Add Student                    13. Sort by Attendance    |\n";
+    cout << "|  2. Display Students               14. Sort by Name          |\n";
+    cout << "|  3. Mark Attendance                15. Sort by Roll Number   |\n";
+    cout << "|  4. View Student Attendance        16. Display Total Students|\n";
+    cout << "|  5. View Day Attendance            17. Students Above %      |\n";
+    cout << "|  6. Calculate Average Attendance   18. Students Below %      |\n";
+    cout << "|  7. Highest/Lowest Attendance      19. Students in Range     |\n";
+    cout << "|  8. Update Student Name            20. Set Month             |\n";
+    cout << "|  9. Update Roll Number             21. Save to File          |\n";
+    cout << "| 10. Update Remarks                 22. Additional Info       |\n";
+    cout << "| 11. Delete Student                 23. Exit                  |\n";
+    cout << "| 12. Search Student                 24. Import Attendance     |\n";
+    cout << "|                                    25. Attendance History    |\n";
+    cout << "|                                    26. Attendance by Dates   |\n";
+    cout << "|                                    27. Mark Whole Day        |\n";
+    cout << "|                                    28. Copy Day Marks        |\n";
+    cout << "|                                    29. Search by Name        |\n";
+    cout << "|                                    30. Performance Stats     |\n";
+    setConsoleColor(11);
+    cout << "+==============================================================+\n";
+    setConsoleColor(7);
+    cout << "\nEnter your choice (1-30): ";
+}
+
+// JSON output and argument parsing shared by the command runners
+
+void appendJsonString(string& text, string_view value) {
+    text += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': text += "\\\""; break;
+            case '\\': text += "\\\\"; break;
+            case '\n': text += "\\n"; break;
+            case '\r': text += "\\r"; break;
+            case '\t': text += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    text += escaped;
+                } else {
+                    text += c;
+                }
+        }
+    }
+    text += '"';
+}
+
+void appendNumber(string& text, double value) {
+    char number[32];
+    snprintf(number, sizeof(number), "%.2f", value);
+    text += number;
+}
+
+bool parseInt(const string& text, int& value) {
+    const char* last = text.data() + text.size();
+    from_chars_result result = from_chars(text.data(), last, value);
+    return result.ec == errc() && result.ptr == last;
+}
+
+bool parseDouble(const string& text, double& value) {
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && end == text.c_str() + text.size();
+}
+
+void appendStudentJson(string& text, const StudentView& student, int days) {
+    text += "{\"roll\":";
+    text += to_string(student.getRollNumber());
+    text += ",\"name\":";
+    appendJsonString(text, student.getName());
+    text += ",\"percentage\":";
+    appendNumber(text, student.getAttendancePercentage(days));
+    text += ",\"remarks\":";
+    appendJsonString(text, student.getRemarks());
+    text += '}';
+}
+
+// The stats command: append the stats export in format ("json", the
+// default, or "prometheus") to out
+bool appendStats(string& out, const vector<string>& args, string& error) {
+#if SAMS_STATS
+    if (args.size() == 1 || args[1] == "json") {
+        out += Stats::json();
+        out += '\n';
+        return true;
+    }
+    if (args[1] == "prometheus") {
+        out += Stats::prometheus();
+        return true;
+    }
+    error = "Unknown stats format: " + args[1];
+    return false;
+#else
+    (void)out;
+    (void)args;
+    error = "Statistics were compiled out (SAMS_STATS=0).";
+    return false;
+#endif
+}
+
+// Split a command line on whitespace
+void splitCommandLine(const string& line, vector<string>& args) {
+    args.clear();
+    size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && isspace(static_cast<unsigned char>(line[pos]))) pos++;
+        if (pos >= line.size()) break;
+        size_t end = pos;
+        while (end < line.size() && !isspace(static_cast<unsigned char>(line[end]))) end++;
+        args.push_back(line.substr(pos, end - pos));
+        pos = end;
+    }
+}
+
+// Run every command in a script through runner; blank lines and lines
+// starting with # are skipped. Returns the number of failed commands.
+template <typename Runner>
+int runCommandScript(Runner& runner, istream& input) {
+    int failures = 0;
+    string line;
+    vector<string> args;
+    while (getline(input, line)) {
+        splitCommandLine(line, args);
+        if (args.empty() || args[0][0] == '#') continue;
+        if (!runner.run(args)) failures++;
+    }
+    return failures;
+}
+
+// Command mode: runs AttendanceSystem operations from the command line or
+// from a script (one command per line) with no screen clearing, colors or
+// pauses. Each command writes exactly one JSON object on its own line to
+// stdout; output is buffered and written in large blocks.
+class CommandRunner {
+private:
+    AttendanceSystem& system;
+    string buffer;
+    string& out;                // buffer, or the output of a SectionRunner
+    
+    // Shared output is left to its owner
+    void flushIfFull() {
+        if (&out == &buffer && out.size() >= (1 << 16)) flush();
+    }
+    
+    void appendStudent(const StudentView& student) {
+        appendStudentJson(out, student, system.monthDays());
+    }
+    
+    void fail(const string& message) {
+        out += "{\"ok\":false,\"error\":";
+        appendJsonString(out, message);
+        out += "}\n";
+    }
+    
+    // attendance, name or roll, optionally followed by :asc or :desc.
+    // Attendance defaults to descending, the others to ascending.
+    static bool parseSortKey(const string& text, SortKey& key) {
+        size_t colon = text.find(':');
+        string field = text.substr(0, colon);
+        if (field == "attendance") key = {SORT_BY_ATTENDANCE, true};
+        else if (field == "name") key = {SORT_BY_NAME, false};
+        else if (field == "roll") key = {SORT_BY_ROLL_NUMBER, false};
+        else return false;
+        if (colon == string::npos) return true;
+        string direction = text.substr(colon + 1);
+        if (direction != "asc" && direction != "desc") return false;
+        key.descending = direction == "desc";
+        return true;
+    }
+    
+    // Rejoin arguments from index first, for names with spaces
+    static string joinFrom(const vector<string>& args, size_t first) {
+        string joined;
+        for (size_t i = first; i < args.size(); i++) {
+            if (!joined.empty()) joined += ' ';
+            joined += args[i];
+        }
+        return joined;
+    }
+    
+    void listAll() {
+        out += "{\"ok\":true,\"students\":[";
+        bool first = true;
+        system.forEachStudent([&](int, const StudentView& student) {
+            if (!first) out += ',';
+            first = false;
+            appendStudent(student);
+            flushIfFull();
+        });
+        out += "]}\n";
+    }
+    
+    // Students whose percentage satisfies match, read from the buckets
+    template <typename Match>
+    void listMatching(Match match) {
+        vector<int> slots = system.studentsWithPercentage(match);
+        out += "{\"ok\":true,\"count\":" + to_string(slots.size()) + ",\"students\":[";
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (i > 0) out += ',';
+            appendStudent(system.studentAt(slots[i]));
+            flushIfFull();
+        }
+        out += "]}\n";
+    }
+    
+    // run() for a command with at least its name
+    bool runCommand(const vector<string>& args) {
+        const string& command = args[0];
+        string error;
+        int a = 0, b = 0, c = 0;
         
-        cout << "\nAttendance for Day " << day << ":\n";
-        cout << "----------------------------\n";
-        cout << "Roll Number | Name | Status\n";
-        cout << "----------------------------\n";
-        
-        for (int i = 0; i < studentCount; i++) {
-            cout << students[i].getRollNumber() << " | " 
-                    << students[i].getName() << " | " 
-                    << (students[i].getAttendance(day - 1) ? "Present" : "Absent") << "\n";
+        if (command == "add" && args.size() >= 3 && parseInt(args[1], a)) {
+            if (!system.addStudentRecord(a, joinFrom(args, 2), error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "mark" && args.size() == 4 && parseInt(args[1], a) &&
+                   parseInt(args[2], b) && parseInt(args[3], c)) {
+            if (!system.markStudent(a, b, c, error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "markday" && args.size() >= 3 && parseInt(args[1], a) &&
+                   parseInt(args[2], b)) {
+            // markday DAY 0|1 [except ROLL...]
+            vector<int> exceptions;
+            if (args.size() > 3 && args[3] != "except") {
+                return fail("Unknown command or wrong arguments: " + joinFrom(args, 0)), false;
+            }
+            for (size_t i = 4; i < args.size(); i++) {
+                if (!parseInt(args[i], c)) return fail("Invalid roll number: " + args[i]), false;
+                exceptions.push_back(c);
+            }
+            if (!system.markWholeDay(a, b, exceptions, error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "copyday" && args.size() == 3 && parseInt(args[1], a) &&
+                   parseInt(args[2], b)) {
+            if (!system.copyDayMarks(a, b, error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "rename" && args.size() >= 3 && parseInt(args[1], a)) {
+            if (!system.renameStudent(a, joinFrom(args, 2), error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "reroll" && args.size() == 3 && parseInt(args[1], a) &&
+                   parseInt(args[2], b)) {
+            if (!system.changeStudentRollNumber(a, b, error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "remarks" && args.size() == 3 && parseInt(args[1], a)) {
+            int code = remarkCode(args[2]);
+            if (code == REMARK_NONE && !parseInt(args[2], code)) code = -1;
+            if (!system.setStudentRemarks(a, code, error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "delete" && args.size() == 2 && parseInt(args[1], a)) {
+            if (!system.deleteStudentRecord(a, error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "month" && (args.size() == 2 || args.size() == 3) &&
+                   parseInt(args[1], a)) {
+            b = system.year();
+            if (args.size() == 3 && !parseInt(args[2], b)) return fail("Invalid year."), false;
+            if (!system.selectMonth(a, b, error)) return fail(error), false;
+            out += "{\"ok\":true,\"month\":" + to_string(system.month()) +
+                   ",\"year\":" + to_string(system.year()) +
+                   ",\"days\":" + to_string(system.monthDays()) + "}\n";
+        } else if (command == "between" && (args.size() == 3 || args.size() == 4)) {
+            int fromYear, fromMonth, fromDay, toYear, toMonth, toDay;
+            DateRange range;
+            if (!DateRange::parseDate(args[1], fromYear, fromMonth, fromDay) ||
+                !DateRange::parseDate(args[2], toYear, toMonth, toDay) ||
+                !range.set(fromYear, fromMonth, fromDay, toYear, toMonth, toDay)) {
+                return fail("Invalid dates."), false;
+            }
+            if (args.size() == 4) {
+                int slot = parseInt(args[3], a) ? system.lookupStudent(a) : -1;
+                if (slot < 0) return fail("Student with roll number " + args[3] + " not found."), false;
+                int present = system.presentBetween(slot, range);
+                out += "{\"ok\":true,\"present\":" + to_string(present) +
+                       ",\"days\":" + to_string(range.totalDays) + ",\"percentage\":";
+                appendNumber(out, 100.0 * present / range.totalDays);
+                out += "}\n";
+            } else {
+                out += "{\"ok\":true,\"days\":" + to_string(range.totalDays) + ",\"students\":[";
+                bool first = true;
+                double average = system.rangeReport(range, [&](int slot, int present) {
+                    if (!first) out += ',';
+                    first = false;
+                    out += "{\"roll\":" + to_string(system.studentAt(slot).getRollNumber()) +
+                           ",\"present\":" + to_string(present) + ",\"percentage\":";
+                    appendNumber(out, 100.0 * present / range.totalDays);
+                    out += '}';
+                    flushIfFull();
+                });
+                out += "],\"average\":";
+                appendNumber(out, average);
+                out += "}\n";
+            }
+        } else if (command == "history" && args.size() == 2 && parseInt(args[1], a)) {
+            int slot = system.lookupStudent(a);
+            if (slot < 0) return fail("Student with roll number " + args[1] + " not found."), false;
+            out += "{\"ok\":true,\"months\":[";
+            bool first = true;
+            system.forEachMonth(slot, [&](int year, int month, DayMask mask) {
+                int days = daysInMonthOf(month, year);
+                if (!first) out += ',';
+                first = false;
+                out += "{\"year\":" + to_string(year) + ",\"month\":" + to_string(month) +
+                       ",\"present\":" + to_string(countPresentDays(mask & dayMaskFor(days))) +
+                       ",\"days\":" + to_string(days) + ",\"percentage\":";
+                appendNumber(out, attendancePercentage(mask, days));
+                out += '}';
+            });
+            out += "]}\n";
+        } else if (command == "show" && args.size() == 2 && parseInt(args[1], a)) {
+            int slot = system.lookupStudent(a);
+            if (slot < 0) return fail("Student with roll number " + args[1] + " not found."), false;
+            StudentView student = system.studentAt(slot);
+            out += "{\"ok\":true,\"student\":";
+            appendStudent(student);
+            out += ",\"days\":\"";
+            for (int day = 0; day < system.monthDays(); day++) {
+                out += student.getAttendance(day) ? '1' : '0';
+            }
+            out += "\"}\n";
+        } else if ((command == "find" || command == "fuzzy") && args.size() >= 2) {
+            // find NAME... matches word prefixes; fuzzy NAME... allows typos
+            bool fuzzy = command == "fuzzy";
+            vector<NameSearchIndex::Match> matches = system.searchNames(joinFrom(args, 1), fuzzy, 100);
+            out += "{\"ok\":true,\"students\":[";
+            for (size_t i = 0; i < matches.size(); i++) {
+                if (i > 0) out += ',';
+                appendStudent(system.studentAt(matches[i].slot));
+                if (fuzzy) {
+                    out.pop_back();
+                    out += ",\"distance\":" + to_string(matches[i].distance) + '}';
+                }
+            }
+            out += "]}\n";
+        } else if (command == "list" && args.size() == 1) {
+            listAll();
+        } else if (command == "list" && args.size() == 2) {
+            // Sorted view; the roster order is left alone
+            SortKey key;
+            if (!parseSortKey(args[1], key) || args[1].find(':') != string::npos) {
+                return fail("Unknown sort key: " + args[1]), false;
+            }
+            out += "{\"ok\":true,\"students\":[";
+            bool first = true;
+            system.forEachStudentSorted(key.field, [&](int, const StudentView& student) {
+                if (!first) out += ',';
+                first = false;
+                appendStudent(student);
+                flushIfFull();
+            });
+            out += "]}\n";
+        } else if (command == "count" && args.size() == 1) {
+            out += "{\"ok\":true,\"count\":" + to_string(system.studentCount()) + "}\n";
+        } else if (command == "count" && args.size() >= 3) {
+            // count above PCT | count below PCT | count range MIN MAX
+            double low, high = 0;
+            int count;
+            if (!parseDouble(args[2], low) || (args.size() == 4 && !parseDouble(args[3], high))) {
+                return fail("Invalid threshold."), false;
+            }
+            if (args[1] == "above" && args.size() == 3) {
+                count = system.countWithPercentage([low](double p) { return p > low; });
+            } else if (args[1] == "below" && args.size() == 3) {
+                count = system.countWithPercentage([low](double p) { return p < low; });
+            } else if (args[1] == "range" && args.size() == 4) {
+                count = system.countWithPercentage([low, high](double p) { return p >= low && p <= high; });
+            } else {
+                return fail("Unknown command or wrong arguments: " + joinFrom(args, 0)), false;
+            }
+            out += "{\"ok\":true,\"count\":" + to_string(count) + "}\n";
+        } else if (command == "day" && args.size() == 2 && parseInt(args[1], a)) {
+            if (a < 1 || a > system.monthDays()) {
+                return fail("Invalid day. Please enter a day between 1 and " +
+                            to_string(system.monthDays()) + "."), false;
+            }
+            int present = system.presentOnDay(a);
+            int total = system.studentCount();
+            out += "{\"ok\":true,\"day\":" + to_string(a) + ",\"present\":" + to_string(present) +
+                   ",\"absent\":" + to_string(total - present) + ",\"presentPercentage\":";
+            appendNumber(out, total > 0 ? 100.0 * present / total : 0);
+            out += "}\n";
+        } else if (command == "average" && args.size() == 1) {
+            out += "{\"ok\":true,\"average\":";
+            appendNumber(out, system.averageAttendance());
+            out += "}\n";
+        } else if (command == "average" && args.size() == 3 && parseInt(args[1], a) &&
+                   parseInt(args[2], b)) {
+            if (a < 1 || a > 12 || b < 1970 || b > 2999) return fail("Invalid month or year."), false;
+            out += "{\"ok\":true,\"month\":" + to_string(a) + ",\"year\":" + to_string(b) +
+                   ",\"average\":";
+            appendNumber(out, system.monthAverage(a, b));
+            out += "}\n";
+        } else if (command == "extremes" && args.size() == 1) {
+            int highest, lowest;
+            system.findExtremes(highest, lowest);
+            if (highest < 0) return fail("No students to evaluate."), false;
+            out += "{\"ok\":true,\"highest\":";
+            appendStudent(system.studentAt(highest));
+            out += ",\"lowest\":";
+            appendStudent(system.studentAt(lowest));
+            out += "}\n";
+        } else if ((command == "above" || command == "below") && args.size() == 2) {
+            double threshold;
+            if (!parseDouble(args[1], threshold)) return fail("Invalid threshold."), false;
+            if (command == "above") {
+                listMatching([threshold](double p) { return p > threshold; });
+            } else {
+                listMatching([threshold](double p) { return p < threshold; });
+            }
+        } else if (command == "range" && args.size() == 3) {
+            double low, high;
+            if (!parseDouble(args[1], low) || !parseDouble(args[2], high)) {
+                return fail("Invalid range."), false;
+            }
+            listMatching([low, high](double p) { return p >= low && p <= high; });
+        } else if (command == "sort" && args.size() >= 2) {
+            vector<SortKey> keys;
+            for (size_t i = 1; i < args.size(); i++) {
+                SortKey key;
+                if (!parseSortKey(args[i], key)) {
+                    return fail("Unknown sort key: " + args[i]), false;
+                }
+                keys.push_back(key);
+            }
+            system.sortStudents(keys);
+            out += "{\"ok\":true}\n";
+        } else if (command == "import" && args.size() >= 2) {
+            ImportReport report;
+            string path = joinFrom(args, 1);
+            if (!system.importAttendanceEvents(path, report, error)) {
+                return fail(error), false;
+            }
+            out += "{\"ok\":true,\"rows\":" + to_string(report.rows) +
+                   ",\"applied\":" + to_string(report.applied) +
+                   ",\"rejected\":" + to_string(report.rejected) + ",\"samples\":[";
+            for (size_t i = 0; i < report.samples.size(); i++) {
+                if (i > 0) out += ',';
+                appendJsonString(out, report.samples[i]);
+            }
+            out += "]}\n";
+        } else if (command == "save" && args.size() == 1) {
+            if (!system.save(error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "stats" && args.size() <= 2) {
+            if (!appendStats(out, args, error)) return fail(error), false;
+        } else {
+            return fail("Unknown command or wrong arguments: " + joinFrom(args, 0)), false;
         }
-        cout << "----------------------------\n";
-        
-        // Calculate attendance statistics for the day
-        int presentCount = 0;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getAttendance(day - 1)) {
-                presentCount++;
+        flushIfFull();
+        return true;
+    }
+    
+public:
+    explicit CommandRunner(AttendanceSystem& attendanceSystem)
+        : system(attendanceSystem), out(buffer) {}
+    
+    // Write into output, which the caller flushes
+    CommandRunner(AttendanceSystem& attendanceSystem, string& output)
+        : system(attendanceSystem), out(output) {}
+    ~CommandRunner() {
+        if (&out == &buffer) flush();
+    }
+    
+    void flush() {
+        if (!out.empty()) fwrite(out.data(), 1, out.size(), stdout);
+        out.clear();
+        fflush(stdout);
+    }
+    
+    // Run one command; returns false if it failed
+    bool run(const vector<string>& args) {
+        if (args.empty()) return true;
+        // A mark needs only its stripe of the roster; other commands make
+        // several calls that must see the same roster
+        if (args[0] == "mark") return runCommand(args);
+        AttendanceSystem::Exclusive hold(system);
+        return runCommand(args);
+    }
+};
+
+// Fixed set of worker threads for running one job over many indices at
+// once. The calling thread takes part too, so a pool of one thread runs
+// everything inline.
+class ThreadPool {
+private:
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake;
+    condition_variable finished;
+    const function<void(int)>* job;
+    int jobSize;
+    atomic<int> next;
+    int pending;                // indices of the current job not yet run
+    int active;                 // workers still inside the current job
+    uint64_t generation;
+    bool stopping;
+    
+    // Run indices of the current job until none are left; returns how many
+    // this thread ran
+    int drain(const function<void(int)>& task, int size) {
+        int done = 0;
+        for (int i = next.fetch_add(1); i < size; i = next.fetch_add(1)) {
+            task(i);
+            done++;
+        }
+        return done;
+    }
+    
+    void work() {
+        uint64_t seen = 0;
+        while (true) {
+            const function<void(int)>* task;
+            int size;
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                task = job;
+                size = jobSize;
+                active++;
             }
+            int done = drain(*task, size);
+            lock_guard<mutex> guard(lock);
+            pending -= done;
+            active--;
+            if (pending == 0 && active == 0) finished.notify_all();
         }
-        
-        double presentPercentage = (static_cast<double>(presentCount) / studentCount) * 100.0;
-        double absentPercentage = 100.0 - presentPercentage;
-        
-        cout << "Present: " << presentCount << " (" << presentPercentage << "%)\n";
-        cout << "Absent: " << (studentCount - presentCount) << " (" << absentPercentage << "%)\n";
     }
     
-    // Calculate average attendance for all students
-    void calculateAverageAttendance() {
-        if (studentCount == 0) {
-            cout << "No students to calculate average attendance.\n";
-            return;
+public:
+    explicit ThreadPool(int threads)
+        : job(nullptr), jobSize(0), next(0), pending(0), active(0), generation(0),
+          stopping(false) {
+        for (int i = 1; i < threads; i++) workers.emplace_back(&ThreadPool::work, this);
+    }
+    
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
         }
-        
-        double totalAttendancePercentage = 0;
-        for (int i = 0; i < studentCount; i++) {
-            totalAttendancePercentage += students[i].getAttendancePercentage(daysInMonth);
+        wake.notify_all();
+        for (thread& worker : workers) worker.join();
+    }
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+    
+    // Call task(i) for every i in [0, count) and return when all are done.
+    // Workers still finishing the previous job are waited for as well, so
+    // none of them can pick up an index of this one with a stale task.
+    void forEachIndex(int count, const function<void(int)>& task) {
+        if (count <= 0) return;
+        {
+            lock_guard<mutex> guard(lock);
+            job = &task;
+            jobSize = count;
+            next = 0;
+            pending = count;
+            generation++;
         }
-        
-        double averageAttendance = totalAttendancePercentage / studentCount;
-        cout << "Average Attendance Percentage: " << averageAttendance << "%\n";
+        wake.notify_all();
+        int done = drain(task, count);
+        unique_lock<mutex> guard(lock);
+        pending -= done;
+        finished.wait(guard, [&] { return pending == 0 && active == 0; });
+        job = nullptr;
+    }
+};
+
+// A student in one section of a SectionSet
+struct SectionStudent {
+    int section;
+    int slot;
+    double percentage;
+};
+
+// Sharded mode: many sections, each an AttendanceSystem with its own data
+// file and journal (DIR/NAME.dat). Aggregates run on every section at once
+// in a thread pool and their results are merged here; each task touches
+// only its own section, so the sections need no locking.
+class SectionSet {
+private:
+    string directory;
+    vector<string> names;                           // sorted
+    vector<unique_ptr<AttendanceSystem>> sections;  // parallel to names
+    ThreadPool pool;
+    
+    unique_ptr<AttendanceSystem> makeSection(const string& name) {
+        unique_ptr<AttendanceSystem> section(new AttendanceSystem());
+        section->setQuiet(true);
+        section->setStatusPrefix(name + ": ");
+        section->setDataFile(directory + "/" + name + ".dat");
+        return section;
     }
     
-    // Find students with highest and lowest attendance
-    void findHighestLowestAttendance() {
-        if (studentCount == 0) {
-            cout << "No students to evaluate.\n";
-            return;
+    // Report the first section whose task left an error
+    bool firstError(const vector<string>& errors, string& error) const {
+        for (int i = 0; i < size(); i++) {
+            if (errors[i].empty()) continue;
+            error = names[i] + ": " + errors[i];
+            return false;
         }
-        
-        int highestStudentIndex = 0;
-        int lowestStudentIndex = 0;
-        double highestAttendance = students[0].getAttendancePercentage(daysInMonth);
-        double lowestAttendance = students[0].getAttendancePercentage(daysInMonth);
-        
-        for (int i = 1; i < studentCount; i++) {
-            double attendance = students[i].getAttendancePercentage(daysInMonth);
-            if (attendance > highestAttendance) {
-                highestAttendance = attendance;
-                highestStudentIndex = i;
-            }
-            if (attendance < lowestAttendance) {
-                lowestAttendance = attendance;
-                lowestStudentIndex = i;
-            }
+        return true;
+    }
+    
+    static bool endsWith(const string& text, const string& suffix) {
+        return text.size() > suffix.size() &&
+               text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+    
+public:
+    explicit SectionSet(int threads) : pool(threads) {}
+    
+    // Section names become file names, so only letters, digits, - and _
+    static bool isValidName(const string& name) {
+        if (name.empty() || name.size() > 64) return false;
+        for (char c : name) {
+            if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') return false;
         }
-        
-        cout << "Highest Attendance: " << highestAttendance << "% (Student: " 
-                << students[highestStudentIndex].getName() << ", Roll Number: " 
-                << students[highestStudentIndex].getRollNumber() << ")\n";
-        cout << "Lowest Attendance: " << lowestAttendance << "% (Student: " 
-                << students[lowestStudentIndex].getName() << ", Roll Number: " 
-                << students[lowestStudentIndex].getRollNumber() << ")\n";
+        return true;
     }
     
-    // Update student name
-    void updateStudentName() {
-        if (studentCount == 0) {
-            cout << "No students to update.\n";
-            return;
+    // Open every section in path: one per NAME.dat, or per NAME.dat.journal
+    // for a section whose first snapshot has not been written yet
+    bool open(const string& path, string& error) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr) {
+            error = "Cannot open section directory " + path + ": " + strerror(errno);
+            return false;
         }
+        directory = path;
+        while (dirent* entry = readdir(dir)) {
+            string file = entry->d_name;
+            string name;
+            if (endsWith(file, ".dat")) name = file.substr(0, file.size() - 4);
+            else if (endsWith(file, ".dat.journal")) name = file.substr(0, file.size() - 12);
+            if (isValidName(name)) names.push_back(name);
+        }
+        closedir(dir);
+        sort(names.begin(), names.end());
+        names.erase(unique(names.begin(), names.end()), names.end());
         
-        int rollNumber;
-        cout << "Enter the roll number of the student to update: ";
-        cin >> rollNumber;
-        clearInputBuffer();
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getRollNumber() == rollNumber) {
-                string newName;
-                while (true) {
-                    cout << "Enter new name for the student: ";
-                    getline(cin, newName);
-                    
-                    if (isValidName(newName)) {
-                        students[i].setName(newName);
-                        cout << "Student name updated successfully.\n";
-                        found = true;
-                        break;
-                    } else {
-                        cout << "Invalid name. Please enter letters only.\n";
-                    }
+        for (const string& name : names) sections.push_back(makeSection(name));
+        pool.forEachIndex(size(), [&](int i) { sections[i]->mapFromFile(); });
+        return true;
+    }
+    
+    // Start a new, empty section
+    bool create(const string& name, string& error) {
+        if (!isValidName(name)) {
+            error = "Invalid section name. Use letters, digits, - and _.";
+            return false;
+        }
+        vector<string>::iterator position = lower_bound(names.begin(), names.end(), name);
+        if (position != names.end() && *position == name) {
+            error = "Section " + name + " already exists.";
+            return false;
+        }
+        unique_ptr<AttendanceSystem> section = makeSection(name);
+        section->mapFromFile();
+        sections.insert(sections.begin() + (position - names.begin()), move(section));
+        names.insert(position, name);
+        return true;
+    }
+    
+    int size() const { return static_cast<int>(sections.size()); }
+    const string& name(int index) const { return names[index]; }
+    AttendanceSystem& section(int index) { return *sections[index]; }
+    
+    // Index of the named section, or -1
+    int find(const string& name) const {
+        vector<string>::const_iterator position = lower_bound(names.begin(), names.end(), name);
+        if (position == names.end() || *position != name) return -1;
+        return static_cast<int>(position - names.begin());
+    }
+    
+    // task(section) for every section in parallel; results in section order
+    template <typename Result, typename Task>
+    vector<Result> fanOut(Task task) {
+        vector<Result> results(sections.size());
+        pool.forEachIndex(size(), [&](int i) { results[i] = task(*sections[i]); });
+        return results;
+    }
+    
+    int studentCount() const {
+        int total = 0;
+        for (const unique_ptr<AttendanceSystem>& section : sections) total += section->studentCount();
+        return total;
+    }
+    
+    // Average percentage over every student of every section, so larger
+    // sections weigh more
+    double averageAttendance() {
+        vector<double> sums = fanOut<double>([](AttendanceSystem& section) {
+            return section.averageAttendance() * section.studentCount();
+        });
+        double total = 0;
+        for (double sum : sums) total += sum;
+        int students = studentCount();
+        return students > 0 ? total / students : 0;
+    }
+    
+    // Highest and lowest attendance across sections; ties go to the first
+    // section by name. False if there are no students at all.
+    bool findExtremes(SectionStudent& highest, SectionStudent& lowest) {
+        vector<pair<SectionStudent, SectionStudent>> found =
+            fanOut<pair<SectionStudent, SectionStudent>>([](AttendanceSystem& section) {
+                SectionStudent high = {-1, -1, 0}, low = {-1, -1, 0};
+                section.findExtremes(high.slot, low.slot);
+                if (high.slot >= 0) {
+                    high.percentage = section.studentAt(high.slot).getAttendancePercentage(section.monthDays());
+                    low.percentage = section.studentAt(low.slot).getAttendancePercentage(section.monthDays());
                 }
-                break;
+                return make_pair(high, low);
+            });
+        highest.section = lowest.section = -1;
+        for (int i = 0; i < size(); i++) {
+            if (found[i].first.slot < 0) continue;
+            if (highest.section < 0 || found[i].first.percentage > highest.percentage) {
+                highest = found[i].first;
+                highest.section = i;
+            }
+            if (lowest.section < 0 || found[i].second.percentage < lowest.percentage) {
+                lowest = found[i].second;
+                lowest.section = i;
             }
         }
-        
-        if (!found) {
-            cout << "Student with roll number " << rollNumber << " not found.\n";
+        return highest.section >= 0;
+    }
+    
+    // Students whose percentage satisfies match, by section and then in
+    // roster order
+    template <typename Match>
+    vector<SectionStudent> studentsWithPercentage(Match match) {
+        vector<vector<int>> slots = fanOut<vector<int>>([&](AttendanceSystem& section) {
+            return section.studentsWithPercentage(match);
+        });
+        vector<SectionStudent> merged;
+        for (int i = 0; i < size(); i++) {
+            int days = sections[i]->monthDays();
+            for (int slot : slots[i]) {
+                merged.push_back({i, slot, sections[i]->studentAt(slot).getAttendancePercentage(days)});
+            }
         }
+        return merged;
     }
     
-    // Update student roll number
-    void updateStudentRollNumber() {
-        if (studentCount == 0) {
-            cout << "No students to update.\n";
-            return;
+    template <typename Match>
+    int countWithPercentage(Match match) {
+        vector<int> counts = fanOut<int>([&](AttendanceSystem& section) {
+            return section.countWithPercentage(match);
+        });
+        int total = 0;
+        for (int count : counts) total += count;
+        return total;
+    }
+    
+    // Present count on a 1-based day, over the sections whose selected
+    // month has that day
+    struct DayTotals {
+        int present;
+        int students;
+        int sections;
+    };
+    
+    DayTotals presentOnDay(int day) {
+        vector<DayTotals> parts = fanOut<DayTotals>([day](AttendanceSystem& section) {
+            if (day > section.monthDays()) return DayTotals{0, 0, 0};
+            return DayTotals{section.presentOnDay(day), section.studentCount(), 1};
+        });
+        DayTotals total = {0, 0, 0};
+        for (const DayTotals& part : parts) {
+            total.present += part.present;
+            total.students += part.students;
+            total.sections += part.sections;
         }
+        return total;
+    }
+    
+    // Select a month in every section; year 0 keeps each section's year.
+    // On failure error names the first section that failed.
+    bool selectMonth(int month, int year, string& error) {
+        vector<string> errors = fanOut<string>([month, year](AttendanceSystem& section) {
+            string sectionError;
+            section.selectMonth(month, year != 0 ? year : section.year(), sectionError);
+            return sectionError;
+        });
+        return firstError(errors, error);
+    }
+    
+    bool save(string& error) {
+        vector<string> errors = fanOut<string>([](AttendanceSystem& section) {
+            string sectionError;
+            section.save(sectionError);
+            return sectionError;
+        });
+        return firstError(errors, error);
+    }
+};
+
+// Command mode over a SectionSet. Section commands run on every section
+// and merge the answers; "in NAME COMMAND..." runs an ordinary command on
+// one section.
+class SectionRunner {
+private:
+    SectionSet& sections;
+    string out;
+    
+    void flushIfFull() {
+        if (out.size() >= (1 << 16)) flush();
+    }
+    
+    void fail(const string& message) {
+        out += "{\"ok\":false,\"error\":";
+        appendJsonString(out, message);
+        out += "}\n";
+    }
+    
+    void appendSectionStudent(const SectionStudent& entry) {
+        AttendanceSystem& section = sections.section(entry.section);
+        out += "{\"section\":";
+        appendJsonString(out, sections.name(entry.section));
+        out += ",\"student\":";
+        appendStudentJson(out, section.studentAt(entry.slot), section.monthDays());
+        out += '}';
+    }
+    
+    template <typename Match>
+    void listMatching(Match match) {
+        vector<SectionStudent> found = sections.studentsWithPercentage(match);
+        out += "{\"ok\":true,\"count\":" + to_string(found.size()) + ",\"students\":[";
+        for (size_t i = 0; i < found.size(); i++) {
+            if (i > 0) out += ',';
+            appendSectionStudent(found[i]);
+            flushIfFull();
+        }
+        out += "]}\n";
+    }
+    
+public:
+    explicit SectionRunner(SectionSet& sectionSet) : sections(sectionSet) {}
+    ~SectionRunner() { flush(); }
+    
+    void flush() {
+        if (!out.empty()) fwrite(out.data(), 1, out.size(), stdout);
+        out.clear();
+        fflush(stdout);
+    }
+    
+    // Run one command; returns false if it failed
+    bool run(const vector<string>& args) {
+        if (args.empty()) return true;
+        const string& command = args[0];
+        string error;
+        int a = 0, b = 0;
         
-        int oldRollNumber;
-        cout << "Enter the current roll number of the student: ";
-        cin >> oldRollNumber;
-        clearInputBuffer();
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getRollNumber() == oldRollNumber) {
-                int newRollNumber;
-                cout << "Enter new roll number for the student: ";
-                cin >> newRollNumber;
-                clearInputBuffer();
-                
-                // Check for duplicate roll number
-                bool duplicate = false;
-                for (int j = 0; j < studentCount; j++) {
-                    if (j != i && students[j].getRollNumber() == newRollNumber) {
-                        duplicate = true;
-                        break;
-                    }
-                }
-                
-                if (!duplicate) {
-                    students[i].setRollNumber(newRollNumber);
-                    cout << "Student roll number updated successfully.\n";
-                } else {
-                    cout << "Roll number already exists. Please try again.\n";
-                }
-                found = true;
-                break;
+        if (command == "in" && args.size() >= 3) {
+            int index = sections.find(args[1]);
+            if (index < 0) return fail("Unknown section: " + args[1]), false;
+            CommandRunner runner(sections.section(index), out);
+            bool ok = runner.run(vector<string>(args.begin() + 2, args.end()));
+            flushIfFull();
+            return ok;
+        } else if (command == "sections" && args.size() == 1) {
+            vector<double> averages = sections.fanOut<double>([](AttendanceSystem& section) {
+                return section.averageAttendance();
+            });
+            out += "{\"ok\":true,\"sections\":[";
+            for (int i = 0; i < sections.size(); i++) {
+                AttendanceSystem& section = sections.section(i);
+                if (i > 0) out += ',';
+                out += "{\"section\":";
+                appendJsonString(out, sections.name(i));
+                out += ",\"students\":" + to_string(section.studentCount()) +
+                       ",\"month\":" + to_string(section.month()) +
+                       ",\"year\":" + to_string(section.year()) + ",\"average\":";
+                appendNumber(out, averages[i]);
+                out += '}';
+            }
+            out += "]}\n";
+        } else if (command == "create" && args.size() == 2) {
+            if (!sections.create(args[1], error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "count" && args.size() == 1) {
+            out += "{\"ok\":true,\"count\":" + to_string(sections.studentCount()) + "}\n";
+        } else if (command == "count" && args.size() >= 3) {
+            double low, high = 0;
+            int count;
+            if (!parseDouble(args[2], low) || (args.size() == 4 && !parseDouble(args[3], high))) {
+                return fail("Invalid threshold."), false;
+            }
+            if (args[1] == "above" && args.size() == 3) {
+                count = sections.countWithPercentage([low](double p) { return p > low; });
+            } else if (args[1] == "below" && args.size() == 3) {
+                count = sections.countWithPercentage([low](double p) { return p < low; });
+            } else if (args[1] == "range" && args.size() == 4) {
+                count = sections.countWithPercentage([low, high](double p) { return p >= low && p <= high; });
+            } else {
+                return fail("Unknown command or wrong arguments: " + args[0] + " " + args[1]), false;
             }
+            out += "{\"ok\":true,\"count\":" + to_string(count) + "}\n";
+        } else if (command == "average" && args.size() == 1) {
+            out += "{\"ok\":true,\"students\":" + to_string(sections.studentCount()) + ",\"average\":";
+            appendNumber(out, sections.averageAttendance());
+            out += "}\n";
+        } else if (command == "extremes" && args.size() == 1) {
+            SectionStudent highest, lowest;
+            if (!sections.findExtremes(highest, lowest)) return fail("No students to evaluate."), false;
+            out += "{\"ok\":true,\"highest\":";
+            appendSectionStudent(highest);
+            out += ",\"lowest\":";
+            appendSectionStudent(lowest);
+            out += "}\n";
+        } else if ((command == "above" || command == "below") && args.size() == 2) {
+            double threshold;
+            if (!parseDouble(args[1], threshold)) return fail("Invalid threshold."), false;
+            if (command == "above") {
+                listMatching([threshold](double p) { return p > threshold; });
+            } else {
+                listMatching([threshold](double p) { return p < threshold; });
+            }
+        } else if (command == "range" && args.size() == 3) {
+            double low, high;
+            if (!parseDouble(args[1], low) || !parseDouble(args[2], high)) {
+                return fail("Invalid range."), false;
+            }
+            listMatching([low, high](double p) { return p >= low && p <= high; });
+        } else if (command == "day" && args.size() == 2 && parseInt(args[1], a)) {
+            if (a < 1 || a > MAX_DAYS) return fail("Invalid day."), false;
+            SectionSet::DayTotals day = sections.presentOnDay(a);
+            out += "{\"ok\":true,\"day\":" + to_string(a) + ",\"sections\":" + to_string(day.sections) +
+                   ",\"present\":" + to_string(day.present) +
+                   ",\"absent\":" + to_string(day.students - day.present) + ",\"presentPercentage\":";
+            appendNumber(out, day.students > 0 ? 100.0 * day.present / day.students : 0);
+            out += "}\n";
+        } else if (command == "month" && (args.size() == 2 || args.size() == 3) &&
+                   parseInt(args[1], a)) {
+            if (args.size() == 3 && !parseInt(args[2], b)) return fail("Invalid year."), false;
+            if (!sections.selectMonth(a, b, error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "save" && args.size() == 1) {
+            if (!sections.save(error)) return fail(error), false;
+            out += "{\"ok\":true}\n";
+        } else if (command == "stats" && args.size() <= 2) {
+            if (!appendStats(out, args, error)) return fail(error), false;
+        } else {
+            string joined;
+            for (const string& arg : args) joined += (joined.empty() ? "" : " ") + arg;
+            return fail("Unknown command or wrong arguments: " + joined), false;
         }
-        
-        if (!found) {
-            cout << "Student with roll number " << oldRollNumber << " not found.\n";
+        flushIfFull();
+        return true;
+    }
+};
+
+// Server mode: one AttendanceSystem serving attendance terminals over a
+// Unix domain socket. The protocol is the command mode one: a request is
+// one command line, the reply is its one JSON line, and replies come back
+// in request order, so clients may pipeline. A single epoll loop owns the
+// system, so requests need no locking. Every request read in one pass of
+// the loop is run, their journal records are written together, and only
+// then are the replies sent, so a reply to a mark means it was logged.
+volatile sig_atomic_t serverStopRequested = 0;
+
+void requestServerStop(int) { serverStopRequested = 1; }
+
+// Let a process use as many descriptors as its hard limit allows
+void raiseDescriptorLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+class AttendanceServer {
+private:
+    // A connection stops reading while this much reply is unsent
+    static const size_t OUTPUT_LIMIT = 1 << 20;
+    // Longest request line accepted
+    static const size_t LINE_LIMIT = 1 << 16;
+    
+    struct Connection {
+        int fd;
+        string in;
+        string out;
+        size_t sent;
+        bool closing;           // peer finished sending
+        bool writable;          // waiting for EPOLLOUT
+    };
+    
+    AttendanceSystem& system;
+    string path;
+    int listenFd;
+    int epollFd;
+    vector<unique_ptr<Connection>> connections;     // indexed by descriptor
+    vector<int> touched;                            // have new replies this pass
+    vector<string> args;
+    
+    void watch(Connection& connection, bool writable) {
+        if (connection.writable == writable) return;
+        connection.writable = writable;
+        struct epoll_event event;
+        event.events = writable ? EPOLLOUT : EPOLLIN;
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+    
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            if (fd >= static_cast<int>(connections.size())) connections.resize(fd + 1);
+            connections[fd].reset(new Connection{fd, string(), string(), 0, false, false});
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
         }
     }
     
-    // Update student remarks
-    void updateStudentRemarks() {
-        if (studentCount == 0) {
-            cout << "No students to update.\n";
-            return;
+    void drop(Connection& connection) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+        ::close(connection.fd);
+        connections[connection.fd].reset();
+    }
+    
+    // Run complete request lines until the reply backlog is full
+    void runRequests(Connection& connection) {
+        CommandRunner runner(system, connection.out);
+        size_t start = 0;
+        while (connection.out.size() - connection.sent < OUTPUT_LIMIT) {
+            size_t end = connection.in.find('\n', start);
+            if (end == string::npos) break;
+            splitCommandLine(connection.in.substr(start, end - start), args);
+            if (!args.empty()) runner.run(args);
+            start = end + 1;
         }
-        
-        int rollNumber;
-        cout << "Enter the roll number of the student to update remarks: ";
-        cin >> rollNumber;
-        clearInputBuffer();
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getRollNumber() == rollNumber) {
-                cout << "Enter remarks for the student (1: Poor, 2: Average, 3: Good, 4: Excellent): ";
-                int choice;
-                cin >> choice;
-                clearInputBuffer();
-                
-                switch (choice) {
-                    case 1:
-                        students[i].setRemarks("Poor");
-                        break;
-                    case 2:
-                        students[i].setRemarks("Average");
-                        break;
-                    case 3:
-                        students[i].setRemarks("Good");
-                        break;
-                    case 4:
-                        students[i].setRemarks("Excellent");
-                        break;
-                    default:
-                        cout << "Invalid choice. Remarks not updated.\n";
-                        return;
-                }
-                cout << "Student remarks updated successfully.\n";
-                found = true;
-                break;
+        connection.in.erase(0, start);
+    }
+    
+    void readFrom(Connection& connection) {
+        char chunk[1 << 16];
+        while (true) {
+            ssize_t n = ::read(connection.fd, chunk, sizeof(chunk));
+            if (n > 0) {
+                connection.in.append(chunk, n);
+                if (n < static_cast<ssize_t>(sizeof(chunk))) break;
+                continue;
             }
+            if (n == 0) connection.closing = true;
+            else if (errno == EINTR) continue;
+            else if (errno != EAGAIN) connection.closing = true;
+            break;
         }
-        
-        if (!found) {
-            cout << "Student with roll number " << rollNumber << " not found.\n";
+        size_t before = connection.out.size();
+        runRequests(connection);
+        if (connection.in.size() > LINE_LIMIT) {
+            connection.in.clear();
+            connection.out += "{\"ok\":false,\"error\":\"Request too long.\"}\n";
+            connection.closing = true;
         }
+        if (connection.out.size() != before || connection.closing) touched.push_back(connection.fd);
     }
     
-    // Delete a student
-    void deleteStudent() {
-        if (studentCount == 0) {
-            cout << "No students to delete.\n";
-            return;
+    // Send what is queued; returns false if the connection was dropped
+    bool writeTo(Connection& connection) {
+        while (connection.sent < connection.out.size()) {
+            ssize_t n = send(connection.fd, connection.out.data() + connection.sent,
+                             connection.out.size() - connection.sent, MSG_NOSIGNAL);
+            if (n > 0) {
+                connection.sent += n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EAGAIN) {
+                watch(connection, true);
+                return true;
+            }
+            drop(connection);
+            return false;
+        }
+        connection.out.clear();
+        connection.sent = 0;
+        if (connection.closing && connection.in.find('\n') == string::npos) {
+            drop(connection);
+            return false;
+        }
+        watch(connection, false);
+        return true;
+    }
+    
+public:
+    explicit AttendanceServer(AttendanceSystem& attendanceSystem)
+        : system(attendanceSystem), listenFd(-1), epollFd(-1) {}
+    
+    ~AttendanceServer() {
+        for (unique_ptr<Connection>& connection : connections) {
+            if (connection) ::close(connection->fd);
+        }
+        if (epollFd >= 0) ::close(epollFd);
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            unlink(path.c_str());
+        }
+    }
+    
+    AttendanceServer(const AttendanceServer&) = delete;
+    AttendanceServer& operator=(const AttendanceServer&) = delete;
+    
+    bool listen(const string& socketPath, string& error) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            error = "Socket path is too long: " + socketPath;
+            return false;
         }
+        memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
         
-        int rollNumber;
-        cout << "Enter the roll number of the student to delete: ";
-        cin >> rollNumber;
-        clearInputBuffer();
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            error = string("Cannot create socket: ") + strerror(errno);
+            return false;
+        }
+        unlink(socketPath.c_str());     // a socket left by an earlier run
+        if (::bind(listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, SOMAXCONN) != 0) {
+            error = "Cannot listen on " + socketPath + ": " + strerror(errno);
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        path = socketPath;
         
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getRollNumber() == rollNumber) {
-                // Shift students to the left to fill the gap
-                for (int j = i; j < studentCount - 1; j++) {
-                    students[j] = students[j + 1];
-                }
-                studentCount--;
-                cout << "Student with roll number " << rollNumber << " deleted successfully.\n";
-                found = true;
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+        return true;
+    }
+    
+    // Serve until SIGINT or SIGTERM, then save a snapshot
+    bool run(string& error) {
+        system.setJournalDeferred(true);
+        vector<struct epoll_event> events(1024);
+        while (!serverStopRequested) {
+            int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                error = string("epoll_wait failed: ") + strerror(errno);
                 break;
             }
+            for (int i = 0; i < ready; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    acceptAll();
+                    continue;
+                }
+                Connection* connection = connections[fd].get();
+                if (connection == nullptr) continue;
+                if (events[i].events & EPOLLOUT) {
+                    if (!writeTo(*connection)) continue;
+                    // Replies drained; pick up requests held back meanwhile
+                    if (!connection->in.empty()) {
+                        runRequests(*connection);
+                        touched.push_back(fd);
+                    }
+                } else {
+                    readFrom(*connection);
+                }
+            }
+            
+            // One journal write for everything this pass changed
+            system.flushJournal();
+            for (int fd : touched) {
+                if (connections[fd] && !connections[fd]->writable) writeTo(*connections[fd]);
+            }
+            touched.clear();
         }
-        
-        if (!found) {
-            cout << "Student with roll number " << rollNumber << " not found.\n";
+        system.setJournalDeferred(false);
+        string saveError;
+        if (!system.save(saveError)) {
+            error = saveError;
+            return false;
+        }
+        return error.empty();
+    }
+};
+
+void printUsage(const char* program) {
+    cout << "Usage:\n"
+         << "  " << program << "                               interactive menu\n"
+         << "  " << program << " [--data FILE] COMMAND [ARGS]  run one command\n"
+         << "  " << program << " [--data FILE] --batch [SCRIPT]\n"
+         << "        run commands from SCRIPT (or stdin), one per line\n"
+         << "\nCommands (each prints one JSON object per line):\n"
+         << "  add ROLL NAME...          mark ROLL DAY 0|1       show ROLL\n"
+         << "  markday DAY 0|1 [except ROLL...]                  copyday FROM TO\n"
+         << "  find NAME...   fuzzy NAME...   (up to 100 students, by name or close spelling)\n"
+         << "  rename ROLL NAME...       reroll OLD NEW          delete ROLL\n"
+         << "  remarks ROLL 1-4|Poor|Average|Good|Excellent\n"
+         << "  list [attendance|name|roll]   count   average   extremes   day DAY\n"
+         << "  above PCT   below PCT   range MIN MAX\n"
+         << "  count above PCT | below PCT | range MIN MAX\n"
+         << "  sort KEY[:asc|:desc]...   (KEY is attendance, name or roll)\n"
+         << "  month 1-12 [YEAR]         history ROLL      average MONTH YEAR\n"
+         << "  between YYYY-MM-DD YYYY-MM-DD [ROLL]\n"
+         << "  import FILE               save              stats [json|prometheus]\n"
+         << "\nSharded mode, one NAME.dat per section in DIR:\n"
+         << "  " << program << " --sections DIR COMMAND [ARGS] | --batch [SCRIPT]\n"
+         << "  sections   create NAME   in NAME COMMAND [ARGS]\n"
+         << "  count   average   extremes   day DAY   above PCT   below PCT   range MIN MAX\n"
+         << "  count above PCT | below PCT | range MIN MAX\n"
+         << "  month 1-12 [YEAR]         save              stats [json|prometheus]\n"
+         << "  (these run on every section in parallel and merge the results)\n"
+         << "\nServer mode, for attendance terminals:\n"
+         << "  " << program << " [--data FILE] --serve SOCKET\n"
+         << "        serve commands on a Unix domain socket, one per line, one JSON reply\n"
+         << "        each; requests may be pipelined. Stop with SIGINT or SIGTERM.\n"
+         << "  " << program << " --load SOCKET [CLIENTS [REQUESTS [PIPELINE]]]\n"
+         << "        drive a running server and report throughput and latency\n"
+         << "\nBenchmark on synthetic rosters:\n"
+         << "  " << program << " --bench [STUDENTS[,STUDENTS...] [DISTRIBUTION [NAME_LENGTH [SEED]]]]\n"
+         << "        time every operation on rosters of each size (default 1000,10000,\n"
+         << "        100000,1000000,10000000; the largest needs about 2 GB of memory);\n"
+         << "        DISTRIBUTION is uniform, high, low or bimodal.\n"
+         << "        Prints one JSON line per size and operation.\n"
+         << "  " << program << " --stress [STUDENTS [THREADS[,THREADS...] [MILLISECONDS [SEED]]]]\n"
+         << "        mark, add and delete from THREADS writers while as many readers look\n"
+         << "        students up (default 100000 students, 1,2,4,8 threads, 1000 ms each);\n"
+         << "        prints throughput per thread count and checks the roster afterwards.\n";
+}
+
+// Run a command, or a script with --batch, through runner
+template <typename Runner>
+int runCommands(Runner& runner, const vector<string>& args) {
+    if (args[0] == "--batch") {
+        int failures;
+        if (args.size() > 1) {
+            ifstream script(args[1]);
+            if (!script) {
+                cerr << "Cannot open script " << args[1] << "\n";
+                return 2;
+            }
+            failures = runCommandScript(runner, script);
+        } else {
+            failures = runCommandScript(runner, cin);
         }
+        return failures == 0 ? 0 : 1;
+    }
+    return runner.run(args) ? 0 : 1;
+}
+
+// Load generator for server mode: opens clients connections to socketPath,
+// each keeping pipeline requests in flight, until requests requests have
+// been answered. Requests are a mix of lookups, marks, day totals and
+// threshold counts over the roster's roll numbers. Prints one JSON line
+// with the throughput and latency percentiles.
+int runLoadTest(const string& socketPath, int clients, int requests, int pipeline) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path is too long: " << socketPath << "\n";
+        return 2;
     }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    raiseDescriptorLimit();
     
-    // Search student by roll number
-    void searchStudentByRollNumber() {
-        if (studentCount == 0) {
-            cout << "No students to search.\n";
-            return;
-        }
-        
-        int rollNumber;
-        cout << "Enter the roll number of the student to search: ";
-        cin >> rollNumber;
-        clearInputBuffer();
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            if (students[i].getRollNumber() == rollNumber) {
-                double attendancePercentage = students[i].getAttendancePercentage(daysInMonth);
-                
-                cout << "Student found:\n";
-                cout << "Roll Number: " << students[i].getRollNumber() << "\n";
-                cout << "Name: " << students[i].getName() << "\n";
-                cout << "Attendance Percentage: " << attendancePercentage << "%\n";
-                cout << "Remarks: " << students[i].getRemarks() << "\n";
-                found = true;
-                break;
-            }
+    struct Client {
+        int fd;
+        string in;
+        string out;
+        size_t sent;
+        vector<chrono::steady_clock::time_point> started;   // ring of pipeline
+        int inFlight;
+        int oldest;
+    };
+    vector<Client> pool(clients);
+    for (Client& client : pool) {
+        client.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (client.fd < 0 ||
+            connect(client.fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+            cerr << "Cannot connect to " << socketPath << ": " << strerror(errno) << "\n";
+            return 2;
         }
-        
-        if (!found) {
-            cout << "Student with roll number " << rollNumber << " not found.\n";
+        client.sent = 0;
+        client.started.resize(pipeline);
+        client.inFlight = 0;
+        client.oldest = 0;
+    }
+    
+    // Roll numbers to ask about: 1 .. the number of students
+    int students = 0;
+    {
+        const char query[] = "count\n";
+        char reply[256];
+        ssize_t n = write(pool[0].fd, query, sizeof(query) - 1) > 0 ? read(pool[0].fd, reply, sizeof(reply) - 1) : -1;
+        if (n <= 0) {
+            cerr << "No reply from " << socketPath << "\n";
+            return 2;
         }
+        reply[n] = '\0';
+        const char* count = strstr(reply, "\"count\":");
+        if (count != nullptr) students = atoi(count + 8);
     }
+    int rollLimit = max(students, 1);
     
-    // Sort students by attendance percentage
-    void sortStudentsByAttendance() {
-        if (studentCount == 0) {
-            cout << "No students to sort.\n";
-            return;
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (int i = 0; i < clients; i++) {
+        fcntl(pool[i].fd, F_SETFL, fcntl(pool[i].fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.u32 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, pool[i].fd, &event);
+    }
+    
+    vector<uint32_t> latencies;
+    latencies.reserve(requests);
+    int issued = 0, errors = 0;
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    char line[64];
+    
+    auto issue = [&](Client& client) {
+        while (client.inFlight < pipeline && issued < requests) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            int roll = 1 + static_cast<int>(state % rollLimit);
+            int kind = static_cast<int>((state >> 32) % 100);
+            if (kind < 70) snprintf(line, sizeof(line), "show %d\n", roll);
+            else if (kind < 90) snprintf(line, sizeof(line), "mark %d %d %d\n", roll,
+                                         1 + static_cast<int>((state >> 40) % 28), static_cast<int>((state >> 48) & 1));
+            else if (kind < 95) snprintf(line, sizeof(line), "day %d\n", 1 + static_cast<int>((state >> 40) % 28));
+            else snprintf(line, sizeof(line), "count above %d\n", static_cast<int>((state >> 40) % 100));
+            client.out += line;
+            client.started[(client.oldest + client.inFlight) % pipeline] = chrono::steady_clock::now();
+            client.inFlight++;
+            issued++;
         }
-        
-        // Simple bubble sort
-        for (int i = 0; i < studentCount - 1; i++) {
-            for (int j = 0; j < studentCount - i - 1; j++) {
-                double attendance1 = students[j].getAttendancePercentage(daysInMonth);
-                double attendance2 = students[j + 1].getAttendancePercentage(daysInMonth);
-                
-                if (attendance1 < attendance2) {
-                    Student temp = students[j];
-                    students[j] = students[j + 1];
-                    students[j + 1] = temp;
+    };
+    
+    auto begin = chrono::steady_clock::now();
+    for (Client& client : pool) issue(client);
+    vector<struct epoll_event> events(1024);
+    char chunk[1 << 16];
+    while (static_cast<int>(latencies.size()) < requests) {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 1000);
+        if (ready == 0) {
+            cerr << "Timed out waiting for replies\n";
+            break;
+        }
+        for (int e = 0; e < ready; e++) {
+            Client& client = pool[events[e].data.u32];
+            if (events[e].events & (EPOLLERR | EPOLLHUP)) {
+                cerr << "Server closed the connection\n";
+                return 1;
+            }
+            if (events[e].events & EPOLLIN) {
+                ssize_t n;
+                while ((n = read(client.fd, chunk, sizeof(chunk))) > 0) client.in.append(chunk, n);
+                size_t start = 0, end;
+                chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                while ((end = client.in.find('\n', start)) != string::npos) {
+                    if (client.in.compare(start, 11, "{\"ok\":false") == 0) errors++;
+                    latencies.push_back(static_cast<uint32_t>(
+                        chrono::duration_cast<chrono::microseconds>(now - client.started[client.oldest]).count()));
+                    client.oldest = (client.oldest + 1) % pipeline;
+                    client.inFlight--;
+                    start = end + 1;
                 }
+                client.in.erase(0, start);
+                issue(client);
+            }
+            while (client.sent < client.out.size()) {
+                ssize_t n = write(client.fd, client.out.data() + client.sent, client.out.size() - client.sent);
+                if (n <= 0) break;
+                client.sent += n;
+            }
+            if (client.sent == client.out.size()) {
+                client.out.clear();
+                client.sent = 0;
             }
         }
-        
-        cout << "Students sorted by attendance percentage.\n";
-        displayStudents(); // Display sorted students
     }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    for (Client& client : pool) ::close(client.fd);
+    ::close(epollFd);
     
-    // Sort students by name
-    void sortStudentsByName() {
-        if (studentCount == 0) {
-            cout << "No students to sort.\n";
-            return;
+    auto percentile = [&](double fraction) -> unsigned {
+        if (latencies.empty()) return 0;
+        size_t index = min(latencies.size() - 1, static_cast<size_t>(fraction * latencies.size()));
+        nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+        return latencies[index];
+    };
+    unsigned p50 = percentile(0.5), p99 = percentile(0.99), p999 = percentile(0.999);
+    unsigned slowest = latencies.empty() ? 0 : *max_element(latencies.begin(), latencies.end());
+    printf("{\"clients\":%d,\"pipeline\":%d,\"requests\":%zu,\"errors\":%d,\"seconds\":%.2f,"
+           "\"requestsPerSecond\":%.0f,\"p50Micros\":%u,\"p99Micros\":%u,\"p999Micros\":%u,"
+           "\"maxMicros\":%u}\n",
+           clients, pipeline, latencies.size(), errors, elapsed, latencies.size() / elapsed,
+           p50, p99, p999, slowest);
+    return static_cast<int>(latencies.size()) == requests ? 0 : 1;
+}
+
+// Synthetic rosters for the benchmark. Everything follows from the seed,
+// so two runs with the same arguments measure the same roster.
+enum AttendanceDistribution {
+    ATTENDANCE_UNIFORM,     // each student's rate anywhere from 0 to 100%
+    ATTENDANCE_HIGH,        // 75 to 100%, a typical class
+    ATTENDANCE_LOW,         // 0 to 50%
+    ATTENDANCE_BIMODAL      // half around 90%, half around 20%
+};
+
+bool parseDistribution(const string& text, AttendanceDistribution& distribution) {
+    static const char* const names[] = {"uniform", "high", "low", "bimodal"};
+    for (int i = 0; i < 4; i++) {
+        if (text == names[i]) {
+            distribution = static_cast<AttendanceDistribution>(i);
+            return true;
         }
-        
-        // Simple bubble sort
-        for (int i = 0; i < studentCount - 1; i++) {
-            for (int j = 0; j < studentCount - i - 1; j++) {
-                if (students[j].getName() > students[j + 1].getName()) {
-                    Student temp = students[j];
-                    students[j] = students[j + 1];
-                    students[j + 1] = temp;
-                }
-            }
+    }
+    return false;
+}
+
+class RosterGenerator {
+private:
+    uint64_t state;
+    AttendanceDistribution distribution;
+    int nameLength;
+    
+public:
+    RosterGenerator(uint64_t seed, AttendanceDistribution attendance, int length)
+        : state(seed), distribution(attendance), nameLength(length) {}
+    
+    // splitmix64
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+    
+    // A first and last name of nameLength letters in all, give or take a
+    // quarter
+    string name() {
+        int spread = max(1, nameLength / 4);
+        int letters = max(2, nameLength - spread + static_cast<int>(next() % (2 * spread + 1)));
+        int first = max(1, letters / 2 - 1 + static_cast<int>(next() % 3));
+        string result;
+        result.reserve(letters + 1);
+        for (int i = 0; i < letters; i++) {
+            if (i == first) result += ' ';
+            char c = static_cast<char>('a' + next() % 26);
+            result += i == 0 || i == first ? static_cast<char>(c - 'a' + 'A') : c;
         }
-        
-        cout << "Students sorted by name.\n";
-        displayStudents(); // Display sorted students
+        return result;
     }
     
-    // Sort students by roll number
-    void sortStudentsByRollNumber() {
-        if (studentCount == 0) {
-            cout << "No students to sort.\n";
-            return;
+    DayMask attendance(int days) {
+        double rate;
+        switch (distribution) {
+            case ATTENDANCE_HIGH: rate = 0.75 + 0.25 * unit(); break;
+            case ATTENDANCE_LOW: rate = 0.5 * unit(); break;
+            case ATTENDANCE_BIMODAL: rate = (next() & 1 ? 0.8 : 0.1) + 0.2 * unit(); break;
+            default: rate = unit(); break;
         }
-        
-        // Simple bubble sort
-        for (int i = 0; i < studentCount - 1; i++) {
-            for (int j = 0; j < studentCount - i - 1; j++) {
-                if (students[j].getRollNumber() > students[j + 1].getRollNumber()) {
-                    Student temp = students[j];
-                    students[j] = students[j + 1];
-                    students[j + 1] = temp;
-                }
-            }
+        uint64_t threshold = static_cast<uint64_t>(rate * 4294967296.0);
+        DayMask mask = 0;
+        for (int day = 0; day < days; day++) {
+            if ((next() >> 32) < threshold) mask |= DayMask(1) << day;
         }
+        return mask;
+    }
+    
+    // Write a roster of count students to path as a snapshot for May
+    // 2025, with roll numbers 1..count in shuffled order
+    bool writeRoster(const string& path, int count) {
+        vector<int32_t> rolls(count);
+        for (int i = 0; i < count; i++) rolls[i] = i + 1;
+        for (int i = count - 1; i > 0; i--) swap(rolls[i], rolls[next() % (i + 1)]);
         
-        cout << "Students sorted by roll number.\n";
-        displayStudents(); // Display sorted students
+        const int days = 31;
+        RosterColumns columns;
+        columns.reserve(count);
+        for (int i = 0; i < count; i++) {
+            string studentName = name();
+            columns.add(StudentView(rolls[i], studentName, next() % REMARK_CODE_COUNT,
+                                    attendance(days), string_view()));
+        }
+        RosterFileHeader header;
+        vector<char> payload;
+        columns.encode(5, days, 2025, header, payload);
+        return writeFileAtomically(path, &header, sizeof(header), payload.data(), payload.size());
     }
+};
+
+// Latencies of one benchmarked operation, printed as a JSON line
+class BenchmarkTimer {
+private:
+    vector<double> micros;
+    double total;
     
-    // Display total number of students
-    void displayTotalNumberOfStudents() {
-        cout << "Total number of students: " << studentCount << "\n";
+public:
+    BenchmarkTimer() : total(0) {}
+    
+    template <typename Operation>
+    void time(Operation operation) {
+        auto start = chrono::steady_clock::now();
+        operation();
+        double elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        micros.push_back(elapsed);
+        total += elapsed;
     }
     
-    // Display students with attendance above a certain threshold
-    void displayStudentsAboveThreshold() {
-        if (studentCount == 0) {
-            cout << "No students to display.\n";
-            return;
+    double percentile(double fraction) {
+        if (micros.empty()) return 0;
+        size_t index = min(micros.size() - 1, static_cast<size_t>(fraction * micros.size()));
+        nth_element(micros.begin(), micros.begin() + index, micros.end());
+        return micros[index];
+    }
+    
+    void report(int students, const char* distribution, int nameLength, const char* operation) {
+        double p50 = percentile(0.5), p99 = percentile(0.99);
+        printf("{\"students\":%d,\"distribution\":\"%s\",\"nameLength\":%d,\"operation\":\"%s\","
+               "\"count\":%zu,\"seconds\":%.6f,\"perSecond\":%.0f,\"p50Micros\":%.3f,"
+               "\"p99Micros\":%.3f}\n",
+               students, distribution, nameLength, operation, micros.size(), total / 1e6,
+               total > 0 ? micros.size() / (total / 1e6) : 0.0, p50, p99);
+        fflush(stdout);
+    }
+};
+
+// Benchmark of every AttendanceSystem operation on synthetic rosters of
+// each of the given sizes. Each roster is generated into a temporary data
+// file, then loaded and mapped, queried and edited through the same API as
+// command mode. Prints one JSON line per size and operation with the
+// throughput and p50/p99 latency, so runs can be compared. Per-student
+// operations run up to 100000 times each; whole-roster operations run a
+// 3 to 20 times, fewer for large rosters. Journal writes are deferred and
+// flushed between operations, so edits show their in-memory cost.
+int runBenchmark(const vector<int>& sizes, AttendanceDistribution distribution, int nameLength,
+                 uint64_t seed) {
+    static const char* const distributionNames[] = {"uniform", "high", "low", "bimodal"};
+    const char* distributionName = distributionNames[distribution];
+    const char* tmp = getenv("TMPDIR");
+    string directory = string(tmp && *tmp ? tmp : "/tmp") + "/sams-bench-XXXXXX";
+    if (!mkdtemp(&directory[0])) {
+        cerr << "Could not create a temporary directory.\n";
+        return 2;
+    }
+    string path = directory + "/students.dat";
+    int status = 0;
+    
+    for (int count : sizes) {
+        RosterGenerator generator(seed, distribution, nameLength);
+        if (!generator.writeRoster(path, count)) {
+            cerr << "Could not write the synthetic roster.\n";
+            status = 2;
+            break;
         }
+        unlink((path + ".journal").c_str());
+        auto report = [&](BenchmarkTimer& timer, const char* operation) {
+            timer.report(count, distributionName, nameLength, operation);
+        };
+        int operations = min(count, 100000);
+        int repeats = max(3, min(20, 1000000 / count));
         
-        double threshold;
-        cout << "Enter the attendance percentage threshold: ";
-        cin >> threshold;
-        clearInputBuffer();
-        
-        cout << "\nStudents with attendance percentage above " << threshold << "%:\n";
-        cout << "----------------------------\n";
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            double attendancePercentage = students[i].getAttendancePercentage(daysInMonth);
-            if (attendancePercentage > threshold) {
-                cout << "Roll Number: " << students[i].getRollNumber() 
-                        << ", Name: " << students[i].getName() 
-                        << ", Attendance: " << attendancePercentage << "%\n";
-                found = true;
-            }
+        // Status lines are unbuffered writes that would be timed with the
+        // operations
+        AttendanceSystem system;
+        system.setSilent(true);
+        system.setDataFile(path);
+        BenchmarkTimer load, map;
+        for (int r = 0; r < repeats; r++) {
+            map.time([&] { system.mapFromFile(); });
+            load.time([&] { system.loadFromFile(); });
         }
+        report(load, "load");
+        report(map, "map");
+        if (system.studentCount() != count) {
+            cerr << "Synthetic roster did not load.\n";
+            status = 1;
+            break;
+        }
+        system.setJournalDeferred(true);
+        string error;
+        auto randomRoll = [&] { return static_cast<int>(generator.next() % count) + 1; };
         
-        if (!found) {
-            cout << "No students found with attendance above " << threshold << "%.\n";
+        BenchmarkTimer lookup;
+        volatile int sink = 0;
+        for (int i = 0; i < operations; i++) {
+            int roll = randomRoll();
+            lookup.time([&] { sink += system.studentAt(system.lookupStudent(roll)).getRollNumber(); });
         }
+        report(lookup, "lookup");
         
-        cout << "----------------------------\n";
-    }
-    
-    // Display students with attendance below a certain threshold
-    void displayStudentsBelowThreshold() {
-        if (studentCount == 0) {
-            cout << "No students to display.\n";
-            return;
+        BenchmarkTimer mark;
+        for (int i = 0; i < operations; i++) {
+            int roll = randomRoll();
+            int day = static_cast<int>(generator.next() % system.monthDays()) + 1;
+            int present = static_cast<int>(generator.next() & 1);
+            mark.time([&] { system.markStudent(roll, day, present, error); });
         }
+        system.flushJournal();
+        report(mark, "mark");
         
-        double threshold;
-        cout << "Enter the attendance percentage threshold: ";
-        cin >> threshold;
-        clearInputBuffer();
+        BenchmarkTimer add, remove;
+        vector<string> names(operations);
+        for (string& name : names) name = generator.name();
+        for (int i = 0; i < operations; i++) {
+            add.time([&] { system.addStudentRecord(count + 1 + i, names[i], error); });
+        }
+        system.flushJournal();
+        report(add, "add");
+        for (int i = 0; i < operations; i++) {
+            remove.time([&] { system.deleteStudentRecord(count + 1 + i, error); });
+        }
+        system.flushJournal();
+        report(remove, "delete");
         
-        cout << "\nStudents with attendance percentage below " << threshold << "%:\n";
-        cout << "----------------------------\n";
+        BenchmarkTimer day;
+        for (int i = 0; i < operations; i++) {
+            int d = static_cast<int>(generator.next() % system.monthDays()) + 1;
+            day.time([&] { sink += system.presentOnDay(d); });
+        }
+        report(day, "day");
         
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            double attendancePercentage = students[i].getAttendancePercentage(daysInMonth);
-            if (attendancePercentage < threshold) {
-                cout << "Roll Number: " << students[i].getRollNumber() 
-                        << ", Name: " << students[i].getName() 
-                        << ", Attendance: " << attendancePercentage << "%\n";
-                found = true;
-            }
+        BenchmarkTimer average, extremes, above, below, range;
+        for (int r = 0; r < repeats; r++) {
+            double low = 100 * generator.unit(), high = low + (100 - low) * generator.unit();
+            average.time([&] { sink += static_cast<int>(system.averageAttendance()); });
+            extremes.time([&] {
+                int highest, lowest;
+                system.findExtremes(highest, lowest);
+                sink += highest;
+            });
+            above.time([&] {
+                sink += system.studentsWithPercentage([low](double p) { return p > low; }).size();
+            });
+            below.time([&] {
+                sink += system.studentsWithPercentage([low](double p) { return p < low; }).size();
+            });
+            range.time([&] {
+                sink += system.studentsWithPercentage([low, high](double p) {
+                    return p >= low && p <= high;
+                }).size();
+            });
         }
+        report(average, "average");
+        report(extremes, "extremes");
+        report(above, "above");
+        report(below, "below");
+        report(range, "range");
         
-        if (!found) {
-            cout << "No students found with attendance below " << threshold << "%.\n";
+        BenchmarkTimer byAttendance, byName, byRoll;
+        for (int r = 0; r < repeats; r++) {
+            byAttendance.time([&] {
+                system.sortStudents({{SORT_BY_ATTENDANCE, true}, {SORT_BY_NAME, false}});
+            });
+            byName.time([&] { system.sortStudents({{SORT_BY_NAME, false}}); });
+            byRoll.time([&] { system.sortStudents({{SORT_BY_ROLL_NUMBER, false}}); });
         }
+        report(byAttendance, "sortAttendance");
+        report(byName, "sortName");
+        report(byRoll, "sortRoll");
         
-        cout << "----------------------------\n";
+        BenchmarkTimer save;
+        for (int r = 0; r < repeats; r++) {
+            save.time([&] {
+                if (!system.save(error)) status = 1;
+            });
+        }
+        report(save, "save");
+        if (status != 0) {
+            cerr << error << "\n";
+            break;
+        }
     }
     
-    // Display students with attendance in a specific range
-    void displayStudentsInAttendanceRange() {
-        if (studentCount == 0) {
-            cout << "No students to display.\n";
-            return;
+    unlink(path.c_str());
+    unlink((path + ".journal").c_str());
+    unlink((path + ".tmp").c_str());
+    rmdir(directory.c_str());
+    return status;
+}
+
+// One student as the stress test compares rosters
+struct StressStudent {
+    int rollNumber;
+    string name;
+    DayMask attendance;
+    
+    bool operator<(const StressStudent& other) const { return rollNumber < other.rollNumber; }
+    bool operator==(const StressStudent& other) const {
+        return rollNumber == other.rollNumber && name == other.name && attendance == other.attendance;
+    }
+};
+
+vector<StressStudent> stressRoster(AttendanceSystem& system) {
+    vector<StressStudent> roster;
+    system.forEachStudent([&](int, const StudentView& student) {
+        roster.push_back({student.getRollNumber(), string(student.getName()), student.getAttendanceMask()});
+    });
+    sort(roster.begin(), roster.end());
+    return roster;
+}
+
+// Stress test of concurrent use on a synthetic roster of count students.
+// For each thread count, that many writers mark random students, each
+// adding or deleting one of its own students every 256 operations, while
+// as many readers look students up and read the day totals through
+// AttendanceSystem::Reader, for millis milliseconds. Prints one JSON line
+// per thread count with the throughput of each side and whether the
+// readers only ever saw consistent rosters, the totals match a recount
+// and the data file reopens, journal replayed, to the same roster.
+int runStressTest(int count, const vector<int>& threadCounts, int millis, uint64_t seed) {
+    const char* tmp = getenv("TMPDIR");
+    string directory = string(tmp && *tmp ? tmp : "/tmp") + "/sams-stress-XXXXXX";
+    if (!mkdtemp(&directory[0])) {
+        cerr << "Could not create a temporary directory.\n";
+        return 2;
+    }
+    string path = directory + "/students.dat";
+    int status = 0;
+    
+    for (int threads : threadCounts) {
+        RosterGenerator generator(seed, ATTENDANCE_UNIFORM, 12);
+        unlink((path + ".journal").c_str());
+        if (!generator.writeRoster(path, count)) {
+            cerr << "Could not write the synthetic roster.\n";
+            status = 2;
+            break;
         }
         
-        double minAttendance, maxAttendance;
-        cout << "Enter the minimum attendance percentage: ";
-        cin >> minAttendance;
-        cout << "Enter the maximum attendance percentage: ";
-        cin >> maxAttendance;
-        clearInputBuffer();
-        
-        cout << "\nStudents with attendance percentage between " 
-                << minAttendance << "% and " << maxAttendance << "%:\n";
-        cout << "----------------------------\n";
-        
-        bool found = false;
-        for (int i = 0; i < studentCount; i++) {
-            double attendancePercentage = students[i].getAttendancePercentage(daysInMonth);
-            if (attendancePercentage >= minAttendance && attendancePercentage <= maxAttendance) {
-                cout << "Roll Number: " << students[i].getRollNumber() 
-                        << ", Name: " << students[i].getName() 
-                        << ", Attendance: " << attendancePercentage << "%\n";
-                found = true;
+        atomic<bool> stop(false);
+        atomic<int64_t> marks(0), edits(0), reads(0), readErrors(0);
+        bool totalsMatch = true;
+        vector<StressStudent> expected;
+        double seconds;
+        {
+            AttendanceSystem system;
+            system.setSilent(true);
+            system.setDataFile(path);
+            system.loadFromFile();
+            system.setJournalDeferred(true);
+            system.setConcurrent(true);
+            int days = system.monthDays();
+            
+            vector<thread> workers;
+            for (int w = 0; w < threads; w++) {
+                workers.emplace_back([&, w] {
+                    RosterGenerator random(seed + 1 + w, ATTENDANCE_UNIFORM, 12);
+                    string error;
+                    vector<int> added;
+                    int nextRollNumber = count + 1 + w;     // writers add disjoint roll numbers
+                    int64_t done = 0, changed = 0;
+                    while (!stop.load(memory_order_relaxed)) {
+                        done++;
+                        if (w == 0 && done % 4096 == 0) system.flushJournal();
+                        if (done % 256 == 0) {
+                            if (added.size() < 16 || (random.next() & 1)) {
+                                if (system.addStudentRecord(nextRollNumber, random.name(), error)) {
+                                    added.push_back(nextRollNumber);
+                                }
+                                nextRollNumber += threads;
+                            } else {
+                                system.deleteStudentRecord(added.back(), error);
+                                added.pop_back();
+                            }
+                            changed++;
+                            continue;
+                        }
+                        int rollNumber = static_cast<int>(random.next() % count) + 1;
+                        int day = static_cast<int>(random.next() % days) + 1;
+                        system.markStudent(rollNumber, day, static_cast<int>(random.next() & 1), error);
+                    }
+                    marks += done - changed;
+                    edits += changed;
+                });
+            }
+            for (int r = 0; r < threads; r++) {
+                workers.emplace_back([&, r] {
+                    RosterGenerator random(seed + 1 + threads + r, ATTENDANCE_UNIFORM, 12);
+                    int64_t done = 0, errors = 0;
+                    while (!stop.load(memory_order_relaxed)) {
+                        // The students of the synthetic roster are never deleted
+                        int rollNumber = static_cast<int>(random.next() % count) + 1;
+                        AttendanceSystem::Reader reader(system);
+                        int slot = reader.find(rollNumber);
+                        if (slot < 0 || reader.student(slot).getRollNumber() != rollNumber) errors++;
+                        int present = reader.presentOnDay(static_cast<int>(random.next() % days) + 1);
+                        if (present < 0 || present > reader.studentCount()) errors++;
+                        done++;
+                    }
+                    reads += done;
+                    readErrors += errors;
+                });
             }
+            auto start = chrono::steady_clock::now();
+            this_thread::sleep_for(chrono::milliseconds(millis));
+            stop = true;
+            for (thread& worker : workers) worker.join();
+            seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            
+            system.setConcurrent(false);
+            system.flushJournal();
+            expected = stressRoster(system);
+            AttendanceTotals recount;
+            recount.reset(days);
+            for (const StressStudent& student : expected) recount.add(student.attendance);
+            for (int day = 1; day <= days; day++) {
+                if (system.presentOnDay(day) != recount.presentOn(day - 1)) totalsMatch = false;
+            }
+            if (fabs(system.averageAttendance() - recount.averagePercentage()) > 1e-9) totalsMatch = false;
         }
         
-        if (!found) {
-            cout << "No students found with attendance between " 
-                    << minAttendance << "% and " << maxAttendance << "%.\n";
-        }
+        AttendanceSystem reopened;
+        reopened.setSilent(true);
+        reopened.setDataFile(path);
+        reopened.loadFromFile();
+        bool replayMatches = stressRoster(reopened) == expected;
         
-        cout << "----------------------------\n";
+        printf("{\"students\":%d,\"writers\":%d,\"readers\":%d,\"cores\":%u,\"seconds\":%.3f,"
+               "\"marks\":%lld,\"marksPerSecond\":%.0f,\"edits\":%lld,\"reads\":%lld,"
+               "\"readsPerSecond\":%.0f,\"readErrors\":%lld,\"totalsMatch\":%s,\"replayMatches\":%s}\n",
+               count, threads, threads, thread::hardware_concurrency(), seconds,
+               static_cast<long long>(marks.load()), marks.load() / seconds,
+               static_cast<long long>(edits.load()), static_cast<long long>(reads.load()),
+               reads.load() / seconds, static_cast<long long>(readErrors.load()),
+               totalsMatch ? "true" : "false", replayMatches ? "true" : "false");
+        fflush(stdout);
+        if (readErrors.load() != 0 || !totalsMatch || !replayMatches) status = 1;
     }
     
-    // Update month and days in month
-    void setMonth() {
-        int month;
-        cout << "Enter month number (1-12): ";
-        cin >> month;
-        clearInputBuffer();
-        
-        if (month < 1 || month > 12) {
-            cout << "Invalid month number. Please enter a number between 1 and 12.\n";
-            return;
+    unlink(path.c_str());
+    unlink((path + ".journal").c_str());
+    unlink((path + ".tmp").c_str());
+    rmdir(directory.c_str());
+    return status;
+}
+
+// Comma-separated positive numbers
+bool parseCounts(const string& text, vector<int>& counts) {
+    counts.clear();
+    for (size_t start = 0; start <= text.size(); ) {
+        size_t end = min(text.find(',', start), text.size());
+        int count;
+        if (!parseInt(text.substr(start, end - start), count) || count < 1) return false;
+        counts.push_back(count);
+        start = end + 1;
+    }
+    return !counts.empty();
+}
+
+int main(int argc, char* argv[]) {
+    // Command mode if any arguments are given
+    if (argc > 1) {
+        vector<string> args(argv + 1, argv + argc);
+        if (args[0] == "--help" || args[0] == "-h") {
+            printUsage(argv[0]);
+            return 0;
         }
         
-        currentMonth = month;
+        if (args[0] == "--sections") {
+            if (args.size() < 3) {
+                printUsage(argv[0]);
+                return 2;
+            }
+            SectionSet sections(max(1u, thread::hardware_concurrency()));
+            string error;
+            if (!sections.open(args[1], error)) {
+                cerr << error << "\n";
+                return 2;
+            }
+            SectionRunner runner(sections);
+            return runCommands(runner, vector<string>(args.begin() + 2, args.end()));
+        }
         
-        // Set days in month based on month number
-        switch (month) {
-            case 2:
-                daysInMonth = 28; // Simplified, not accounting for leap years
-                break;
-            case 4:
-            case 6:
-            case 9:
-            case 11:
-                daysInMonth = 30;
-                break;
-            default:
-                daysInMonth = 31;
+        if (args[0] == "--load") {
+            int clients = 100, requests = 1000000, pipeline = 16;
+            if (args.size() < 2 || args.size() > 5 ||
+                (args.size() > 2 && (!parseInt(args[2], clients) || clients < 1)) ||
+                (args.size() > 3 && (!parseInt(args[3], requests) || requests < 1)) ||
+                (args.size() > 4 && (!parseInt(args[4], pipeline) || pipeline < 1))) {
+                printUsage(argv[0]);
+                return 2;
+            }
+            return runLoadTest(args[1], clients, requests, pipeline);
         }
         
-        cout << "Month set to " << month << " with " << daysInMonth << " days.\n";
-    }
-    
-    // Save data to file
-    void saveToFile() {
-        ofstream file("students.dat", std::ios::binary);
-        if (!file) {
-            cout << "Error opening file for writing.\n";
-            return;
+        if (args[0] == "--bench") {
+            vector<int> sizes = {1000, 10000, 100000, 1000000, 10000000};
+            AttendanceDistribution distribution = ATTENDANCE_UNIFORM;
+            int nameLength = 12, seed = 1;
+            if ((args.size() > 1 && !parseCounts(args[1], sizes)) || args.size() > 5 ||
+                (args.size() > 2 && !parseDistribution(args[2], distribution)) ||
+                (args.size() > 3 && (!parseInt(args[3], nameLength) || nameLength < 2)) ||
+                (args.size() > 4 && !parseInt(args[4], seed))) {
+                printUsage(argv[0]);
+                return 2;
+            }
+            return runBenchmark(sizes, distribution, nameLength, static_cast<uint64_t>(seed));
         }
         
-        file.write(reinterpret_cast<char*>(&studentCount), sizeof(studentCount));
-        file.write(reinterpret_cast<char*>(&currentMonth), sizeof(currentMonth));
-        file.write(reinterpret_cast<char*>(&daysInMonth), sizeof(daysInMonth));
-        file.write(reinterpret_cast<char*>(students), sizeof(Student) * studentCount);
+        if (args[0] == "--stress") {
+            int students = 100000, millis = 1000, seed = 1;
+            vector<int> threadCounts = {1, 2, 4, 8};
+            if (args.size() > 5 || (args.size() > 1 && (!parseInt(args[1], students) || students < 1)) ||
+                (args.size() > 2 && !parseCounts(args[2], threadCounts)) ||
+                (args.size() > 3 && (!parseInt(args[3], millis) || millis < 1)) ||
+                (args.size() > 4 && !parseInt(args[4], seed))) {
+                printUsage(argv[0]);
+                return 2;
+            }
+            return runStressTest(students, threadCounts, millis, static_cast<uint64_t>(seed));
+        }
         
-        file.close();
-        cout << "Student data saved to file.\n";
-    }
-    
-    // Load data from file
-    void loadFromFile() {
-        ifstream file("students.dat", std::ios::binary);
-        if (!file) {
-            cout << "No saved data found or error opening file.\n";
-            return;
+        AttendanceSystem system;
+        system.setQuiet(true);
+        if (args[0] == "--data") {
+            if (args.size() < 2) {
+                printUsage(argv[0]);
+                return 2;
+            }
+            system.setDataFile(args[1]);
+            args.erase(args.begin(), args.begin() + 2);
         }
+        if (args.empty()) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        system.mapFromFile();
         
-        file.read(reinterpret_cast<char*>(&studentCount), sizeof(studentCount));
-        file.read(reinterpret_cast<char*>(&currentMonth), sizeof(currentMonth));
-        file.read(reinterpret_cast<char*>(&daysInMonth), sizeof(daysInMonth));
-        file.read(reinterpret_cast<char*>(students), sizeof(Student) * studentCount);
+        if (args[0] == "--serve") {
+            if (args.size() != 2) {
+                printUsage(argv[0]);
+                return 2;
+            }
+            raiseDescriptorLimit();
+            signal(SIGINT, requestServerStop);
+            signal(SIGTERM, requestServerStop);
+            AttendanceServer server(system);
+            string error;
+            if (!server.listen(args[1], error)) {
+                cerr << error << "\n";
+                return 2;
+            }
+            cerr << "Serving on " << args[1] << "\n";
+            if (!server.run(error)) {
+                cerr << error << "\n";
+                return 1;
+            }
+            return 0;
+        }
         
-        file.close();
-        cout << "Student data loaded from file.\n";
+        CommandRunner runner(system);
+        return runCommands(runner, args);
     }
     
-    // Display additional information about the project
-    void displayAdditionalInfo() {
-        cout << "\n";
-        cout << "Project Team Contributions\n";
-        cout << "----------------------------\n";
-        cout << "Md Anis Mondal: Coding and Report\n";
-        cout << "Md Reag Rahaman: PowerPoint Presentation\n";
-        cout << "Harsh: PowerPoint Presentation\n";
-        cout << "----------------------------\n";
-        cout << "If you encounter any issues or bugs, kindly report them to Md Anis Mondal (BCA)\n";
-    }
-};
-
-// Enhanced menu display
-void displayMenu() {
-    clearScreen();
-    setConsoleColor(11); // Light cyan
-    cout << "\n+==============================================================+\n";
-    cout << "|           STUDENT ATTENDANCE MANAGEMENT SYSTEM              |\n";
-    cout << "+==============================================================+\n";
-    setConsoleColor(14); // Yellow
-    cout << "|  1. Add Student                    13. Sort by Attendance    |\n";
-    cout << "|  2. Display Students               14. Sort by Name          |\n";
-    cout << "|  3. Mark Attendance                15. Sort by Roll Number   |\n";
-    cout << "|  4. View Student Attendance        16. Display Total Students|\n";
-    cout << "|  5. View Day Attendance            17. Students Above %      |\n";
-    cout << "|  6. Calculate Average Attendance   18. Students Below %      |\n";
-    cout << "|  7. Highest/Lowest Attendance      19. Students in Range     |\n";
-    cout << "|  8. Update Student Name            20. Set Month             |\n";
-    cout << "|  9. Update Roll Number             21. Save to File          |\n";
-    cout << "| 10. Update Remarks                 22. Additional Info       |\n";
-    cout << "| 11. Delete Student                 23. Exit                  |\n";
-    cout << "| 12. Search Student                                           |\n";
-    setConsoleColor(11);
-    cout << "+==============================================================+\n";
-    setConsoleColor(7);
-    cout << "\nEnter your choice (1-23): ";
-}
-
-int main() {
+    // Interactive screens are composed in memory and flushed in one write
+    streambuf* console = cout.rdbuf(&screen);
     showWelcomeScreen();
     
     AttendanceSystem system;
-    system.loadFromFile();
+    system.mapFromFile();
     
     int choice;
     while (true) {
+        system.pollBackgroundSave();
         displayMenu();
         cin >> choice;
         system.clearInputBuffer();
@@ -1002,7 +8642,7 @@ int main() {
                 pauseScreen();
                 break;
             case 21:
-                system.saveToFile();
+                system.saveInBackground();
                 pauseScreen();
                 break;
             case 22:
@@ -1017,7 +8657,37 @@ int main() {
                 cout << "     Have a great day! 👋\n\n";
                 setConsoleColor(7);
                 system.saveToFile();
+                cout.flush();
+                cout.rdbuf(console);
                 return 0;
+            case 24:
+                system.importAttendance();
+                pauseScreen();
+                break;
+            case 25:
+                system.viewAttendanceHistory();
+                pauseScreen();
+                break;
+            case 26:
+                system.viewAttendanceBetweenDates();
+                pauseScreen();
+                break;
+            case 27:
+                system.markWholeDayAttendance();
+                pauseScreen();
+                break;
+            case 28:
+                system.copyDayAttendance();
+                pauseScreen();
+                break;
+            case 29:
+                system.searchStudentByName();
+                pauseScreen();
+                break;
+            case 30:
+                system.displayPerformanceStats();
+                pauseScreen();
+                break;
             default:
                 setConsoleColor(12);
                 cout << "\n❌ Invalid choice. Please try again.\n";
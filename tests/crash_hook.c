@@ -0,0 +1,22 @@
+// Preloaded by test_crash_recovery.py to kill sams in the middle of a
+// checkpoint. CRASH_AT=before exits at the rename of a new data file over
+// the old one, CRASH_AT=after at the rename of the rewritten journal, which
+// comes once the checkpoint is committed.
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+int rename(const char* from, const char* to) {
+    int (*real)(const char*, const char*) = (int (*)(const char*, const char*))dlsym(RTLD_NEXT, "rename");
+    const char* mode = getenv("CRASH_AT");
+    size_t length = strlen(to);
+    if (mode) {
+        int journal = length > 8 && strcmp(to + length - 8, ".journal") == 0;
+        if ((strcmp(mode, "before") == 0 && !journal) || (strcmp(mode, "after") == 0 && journal)) {
+            _exit(9);
+        }
+    }
+    return real(from, to);
+}
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Builds sams and the crash hook into tests/build, then runs every
+# tests/test_*.py against them. Exits with the number of failed tests.
+cd "$(dirname "$0")" || exit 1
+mkdir -p build
+${CXX:-g++} -std=c++17 ${CXXFLAGS:--O2 -Wall -Wextra} -pthread ../sams.cpp -o build/sams || exit 1
+${CC:-cc} -shared -fPIC crash_hook.c -o build/crash_hook.so -ldl || exit 1
+
+failed=0
+for test in test_*.py; do
+    if SAMS="$PWD/build/sams" CRASH_HOOK="$PWD/build/crash_hook.so" ${PYTHON:-python3} "$test"; then
+        echo "PASS $test"
+    else
+        echo "FAIL $test"
+        failed=$((failed + 1))
+    fi
+done
+exit $failed
@@ -0,0 +1,131 @@
+"""Helpers shared by the tests: running sams on a scratch data file, and a
+model of what the roster should hold after a series of commands."""
+
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+SAMS = os.environ.get("SAMS", os.path.join(os.path.dirname(os.path.abspath(__file__)), "build", "sams"))
+CRASH_HOOK = os.environ.get("CRASH_HOOK", os.path.join(os.path.dirname(SAMS), "crash_hook.so"))
+
+
+def fail(message):
+    print(message, file=sys.stderr)
+    sys.exit(1)
+
+
+def check(condition, message):
+    if not condition:
+        fail(message)
+
+
+class DataFile:
+    """A data file in a directory of its own, removed by cleanup()."""
+
+    def __init__(self):
+        self.directory = tempfile.mkdtemp(prefix="sams-test-")
+        self.path = os.path.join(self.directory, "students.dat")
+        self.journal = self.path + ".journal"
+
+    def run(self, commands, env=None):
+        """Run commands in one process; returns (exit status, replies, stderr)."""
+        script = os.path.join(self.directory, "commands.txt")
+        with open(script, "w") as f:
+            f.write("\n".join(commands) + "\n")
+        result = subprocess.run([SAMS, "--data", self.path, "--batch", script],
+                                capture_output=True, text=True, env=env)
+        replies = [json.loads(line) for line in result.stdout.splitlines()]
+        return result.returncode, replies, result.stderr
+
+    def contents(self, path):
+        if not os.path.exists(path):
+            return None
+        with open(path, "rb") as f:
+            return f.read()
+
+    def cleanup(self):
+        shutil.rmtree(self.directory, ignore_errors=True)
+
+
+class Roster:
+    """The students of a data file created by these commands, in May (31
+    days), the month a new data file starts in."""
+
+    DAYS = 31
+    REMARKS = ["", "Poor", "Average", "Good", "Excellent"]
+
+    def __init__(self):
+        self.students = {}      # roll number -> [name, remark code, set of days]
+
+    def apply(self, command):
+        """Follow an edit that sams is expected to accept."""
+        words = command.split()
+        op, args = words[0], words[1:]
+        if op == "add":
+            self.students[int(args[0])] = [" ".join(args[1:]), 0, set()]
+        elif op == "delete":
+            del self.students[int(args[0])]
+        elif op == "rename":
+            self.students[int(args[0])][0] = " ".join(args[1:])
+        elif op == "reroll":
+            self.students[int(args[1])] = self.students.pop(int(args[0]))
+        elif op == "remarks":
+            self.students[int(args[0])][1] = int(args[1])
+        elif op == "mark":
+            days = self.students[int(args[0])][2]
+            (days.add if args[2] == "1" else days.discard)(int(args[1]))
+        elif op == "markday":
+            day, present = int(args[0]), args[1] == "1"
+            others = set(int(roll) for roll in args[3:])
+            for roll, student in self.students.items():
+                if present != (roll in others):
+                    student[2].add(day)
+                else:
+                    student[2].discard(day)
+        elif op == "copyday":
+            source, target = int(args[0]), int(args[1])
+            for student in self.students.values():
+                if source in student[2]:
+                    student[2].add(target)
+                else:
+                    student[2].discard(target)
+        elif op != "save":
+            raise ValueError("not an edit: " + command)
+
+    def percentage(self, days):
+        return round(100.0 * len(days) / self.DAYS, 2)
+
+    def queries(self):
+        """Commands that read back the whole roster, with their replies."""
+        expected = []
+        rows = [{"roll": roll, "name": s[0], "percentage": self.percentage(s[2]),
+                 "remarks": self.REMARKS[s[1]]} for roll, s in sorted(self.students.items())]
+        expected.append(("list roll", {"ok": True, "students": rows}))
+        expected.append(("count", {"ok": True, "count": len(self.students)}))
+        present = sum(len(s[2]) for s in self.students.values())
+        average = 100.0 * present / (len(self.students) * self.DAYS) if self.students else 0.0
+        expected.append(("average", {"ok": True, "average": round(average, 2)}))
+        for row, (roll, s) in zip(rows, sorted(self.students.items())):
+            days = "".join("1" if day in s[2] else "0" for day in range(1, self.DAYS + 1))
+            expected.append(("show %d" % roll, {"ok": True, "student": row, "days": days}))
+        return expected
+
+
+def compare(replies, expected, what):
+    """Check the replies to Roster.queries() commands against the model."""
+    check(len(replies) == len(expected), "%s: %d replies to %d queries" % (what, len(replies), len(expected)))
+    for reply, (command, wanted) in zip(replies, expected):
+        if reply == wanted:
+            continue
+        rows, wanted_rows = reply.get("students", []), wanted.get("students", [])
+        for row, wanted_row in zip(rows, wanted_rows):
+            if row != wanted_row:
+                reply, wanted = row, wanted_row
+                break
+        else:
+            if len(rows) != len(wanted_rows):
+                reply, wanted = "%d students" % len(rows), "%d students" % len(wanted_rows)
+        fail("%s: %s gave\n  %s\nexpected\n  %s" % (what, command, reply, wanted))
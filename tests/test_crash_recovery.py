@@ -0,0 +1,80 @@
+"""Kill sams in the middle of a checkpoint (see crash_hook.c) and check that
+reopening the data file, twice, gives back every edit made before the
+crash: once while writing a new data file, once between committing a
+checkpoint and rewriting the journal, and once while the journal is
+folded in the background with edits going on."""
+
+import os
+import random
+
+from samstest import CRASH_HOOK, DataFile, Roster, check, compare
+from test_roundtrip import JOURNAL_COMPACT_RECORDS, edits
+
+
+def crash_env(mode):
+    return dict(os.environ, LD_PRELOAD=CRASH_HOOK, CRASH_AT=mode)
+
+
+def reopen_twice(data, roster, what):
+    expected = roster.queries()
+    for attempt in ("reopened", "reopened again"):
+        status, replies, stderr = data.run([command for command, _ in expected])
+        check(status == 0, "%s, %s: exit status %d: %s" % (what, attempt, status, stderr))
+        compare(replies, expected, "%s, %s" % (what, attempt))
+
+
+def crash_in_save(mode, saved_first):
+    rng = random.Random(17)
+    data = DataFile()
+    roster = Roster()
+    try:
+        commands, next_roll = edits(rng, roster, 2000, 1)
+        if saved_first:
+            commands.append("save")
+        status, _, stderr = data.run(commands)
+        check(status == 0, "first run exited with %d: %s" % (status, stderr))
+
+        commands, _ = edits(rng, roster, 2000, next_roll, saves=False)
+        status, _, stderr = data.run(commands + ["save"], crash_env(mode))
+        check(status == 9, "the save did not reach the crash (exit status %d): %s" % (status, stderr))
+        reopen_twice(data, roster, "crash %s the checkpoint" % mode)
+    finally:
+        data.cleanup()
+
+
+def crash_in_background_fold():
+    # Each mark sets a day no earlier mark set, in a known order, so the
+    # roster after the crash tells how many marks were made
+    students = 4000
+    rng = random.Random(19)
+    data = DataFile()
+    try:
+        commands = ["add %d Student" % roll for roll in range(1, students + 1)] + ["save"]
+        status, _, stderr = data.run(commands)
+        check(status == 0, "first run exited with %d: %s" % (status, stderr))
+
+        marks = [(roll, day) for roll in range(1, students + 1) for day in range(1, Roster.DAYS + 1)]
+        rng.shuffle(marks)
+        marks = marks[:JOURNAL_COMPACT_RECORDS + 15000]
+        status, replied, stderr = data.run(["mark %d %d 1" % mark for mark in marks], crash_env("after"))
+        check(status == 9, "the fold did not reach the crash (exit status %d): %s" % (status, stderr))
+
+        status, replies, stderr = data.run(["show %d" % roll for roll in range(1, students + 1)])
+        check(status == 0, "reopening exited with %d: %s" % (status, stderr))
+        present = set()
+        for roll, reply in enumerate(replies, 1):
+            check(reply.get("ok") and reply["student"]["name"] == "Student", "student %d: %s" % (roll, reply))
+            present.update((roll, day) for day, mark in enumerate(reply["days"], 1) if mark == "1")
+        made = len(present)
+        check(made >= JOURNAL_COMPACT_RECORDS, "only %d marks survived the crash" % made)
+        check(made >= len(replied), "%d marks were answered but only %d survived" % (len(replied), made))
+        check(present == set(marks[:made]),
+              "the %d marks that survived are not the first %d made" % (made, made))
+    finally:
+        data.cleanup()
+
+
+check(os.path.exists(CRASH_HOOK), "crash hook %s is not built" % CRASH_HOOK)
+crash_in_save("before", False)
+crash_in_save("after", True)
+crash_in_background_fold()
@@ -0,0 +1,36 @@
+"""A roster saved with no students in it must open again, and take new
+students: once for a data file that never held any, once for one whose
+students were all deleted."""
+
+from samstest import DataFile, Roster, check, compare
+
+
+def run(data, roster, commands, what):
+    for command in commands:
+        roster.apply(command)
+    expected = roster.queries()
+    status, replies, stderr = data.run(commands + [command for command, _ in expected])
+    check(status == 0, "%s: exit status %d: %s" % (what, status, stderr))
+    for command, reply in zip(commands, replies):
+        check(reply == {"ok": True}, "%s: %s gave %s" % (what, command, reply))
+    compare(replies[len(commands):], expected, what)
+
+
+def save_reopen_add_reopen(first, what):
+    data = DataFile()
+    roster = Roster()
+    try:
+        run(data, roster, first + ["save"], what + ", saved")
+        check(not roster.students, "%s: the roster should be empty once saved" % what)
+        run(data, roster, [], what + ", reopened")
+        run(data, roster, ["add 7 New Student", "mark 7 3 1"], what + ", added to")
+        run(data, roster, [], what + ", reopened after adding")
+        run(data, roster, ["save"], what + ", saved again")
+        run(data, roster, [], what + ", reopened after saving again")
+    finally:
+        data.cleanup()
+
+
+save_reopen_add_reopen([], "new data file")
+save_reopen_add_reopen(["add 1 Ada", "add 2 Grace", "mark 1 1 1", "save", "delete 1", "delete 2"],
+                       "all students deleted")
@@ -0,0 +1,80 @@
+"""Random edits in several runs on one data file, some saved and some left
+in the journal, checked against the model at the end of every run and
+again after reopening. The third run is long enough to fold the journal
+into the data file in the background while edits go on."""
+
+import random
+
+from samstest import DataFile, Roster, check, compare
+
+JOURNAL_COMPACT_RECORDS = 100000
+
+
+def name(rng):
+    return " ".join("".join(rng.choice("abcdefghij") for _ in range(rng.randint(3, 12))).capitalize()
+                    for _ in range(rng.randint(1, 3)))
+
+
+def edits(rng, roster, count, next_roll, marks_only=False, saves=True):
+    """count random edits that sams must accept, applied to roster"""
+    commands = []
+    for _ in range(count):
+        rolls = list(roster.students)
+        r = 0.6 if marks_only and len(rolls) >= 10 else rng.random()
+        if r < 0.08 or len(rolls) < 10:
+            command = "add %d %s" % (next_roll, name(rng))
+            next_roll += 1
+        elif r < 0.1:
+            command = "delete %d" % rng.choice(rolls)
+        elif r < 0.3:
+            command = "rename %d %s" % (rng.choice(rolls), name(rng))
+        elif r < 0.85:
+            command = "mark %d %d %d" % (rng.choice(rolls), rng.randint(1, Roster.DAYS), rng.randint(0, 1))
+        elif r < 0.93:
+            command = "remarks %d %d" % (rng.choice(rolls), rng.randint(1, 4))
+        elif r < 0.95:
+            command = "reroll %d %d" % (rng.choice(rolls), next_roll)
+            next_roll += 1
+        elif r < 0.96:
+            others = rng.sample(rolls, min(3, len(rolls)))
+            command = "markday %d %d except %s" % (rng.randint(1, Roster.DAYS), rng.randint(0, 1),
+                                                   " ".join(map(str, others)))
+        elif r < 0.97:
+            command = "copyday %d %d" % (rng.randint(1, Roster.DAYS), rng.randint(1, Roster.DAYS))
+        elif r < 0.975 and saves:
+            command = "save"
+        else:
+            command = "mark %d %d 1" % (rng.choice(rolls), rng.randint(1, Roster.DAYS))
+        roster.apply(command)
+        commands.append(command)
+    return commands, next_roll
+
+
+def main():
+    rng = random.Random(13)
+    data = DataFile()
+    roster = Roster()
+    next_roll = 1
+    try:
+        runs = [(3000, False, False), (3000, False, True), (JOURNAL_COMPACT_RECORDS + 20000, True, False),
+                (2000, False, True)]
+        for number, (count, marks_only, save) in enumerate(runs, 1):
+            commands, next_roll = edits(rng, roster, count, next_roll, marks_only)
+            if save:
+                commands.append("save")
+            expected = roster.queries()
+            status, replies, stderr = data.run(commands + [command for command, _ in expected])
+            check(status == 0, "run %d exited with %d: %s" % (number, status, stderr))
+            for command, reply in zip(commands, replies):
+                check(reply == {"ok": True}, "run %d: %s gave %s" % (number, command, reply))
+            compare(replies[len(commands):], expected, "run %d" % number)
+
+            status, replies, stderr = data.run([command for command, _ in expected])
+            check(status == 0, "reopening after run %d exited with %d: %s" % (number, status, stderr))
+            compare(replies, expected, "reopened after run %d" % number)
+    finally:
+        data.cleanup()
+
+
+if __name__ == "__main__":
+    main()
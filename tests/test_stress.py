@@ -0,0 +1,15 @@
+"""A short --stress run: concurrent marks and readers must leave the totals
+and the journal consistent with the roster."""
+
+import json
+import subprocess
+
+from samstest import SAMS, check
+
+result = subprocess.run([SAMS, "--stress", "20000", "1,2,4", "300"], capture_output=True, text=True)
+check(result.returncode == 0, "--stress exited with %d: %s" % (result.returncode, result.stderr))
+lines = [json.loads(line) for line in result.stdout.splitlines()]
+check(len(lines) == 3, "--stress printed %d results, expected 3" % len(lines))
+for line in lines:
+    check(line["marks"] > 0 and line["reads"] > 0, "no work done: %s" % line)
+    check(line["readErrors"] == 0 and line["totalsMatch"] and line["replayMatches"], "inconsistent: %s" % line)
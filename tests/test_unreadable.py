@@ -0,0 +1,38 @@
+"""A data file that cannot be read must be left alone: edits and saves are
+refused, and neither the data file nor its journal changes."""
+
+import os
+
+from samstest import DataFile, check
+
+
+def refuses_edits(damage, what):
+    data = DataFile()
+    try:
+        status, _, stderr = data.run(["add 1 Ada", "add 2 Grace", "mark 1 1 1", "save", "add 3 Alan"])
+        check(status == 0, "%s: writing the data file exited with %d: %s" % (what, status, stderr))
+        damage(data)
+        before = data.contents(data.path), data.contents(data.journal)
+
+        for command in ("add 4 Edsger", "mark 1 2 1", "save"):
+            status, replies, stderr = data.run(["count", command])
+            check(status == 1, "%s: %s exited with %d: %s" % (what, command, status, stderr))
+            check(len(replies) == 2 and not replies[1]["ok"], "%s: %s gave %s" % (what, command, replies))
+            check((data.contents(data.path), data.contents(data.journal)) == before,
+                  "%s: %s changed the data file or its journal" % (what, command))
+    finally:
+        data.cleanup()
+
+
+def truncate(data):
+    with open(data.path, "r+b") as f:
+        f.truncate(300)
+
+
+def garbage(data):
+    with open(data.path, "wb") as f:
+        f.write(os.urandom(5000))
+
+
+refuses_edits(truncate, "truncated data file")
+refuses_edits(garbage, "data file of random bytes")